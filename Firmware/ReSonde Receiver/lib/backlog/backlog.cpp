@@ -0,0 +1,162 @@
+#include "backlog.h"
+#include <LittleFS.h>
+
+#define BACKLOG_DIR "/backlog"
+#define BACKLOG_POSITION "/backlog.pos" // read offset in the first segment, so a restart does not upload it twice
+#define BACKLOG_SEGMENT_RECORDS 256 // records per file, about 10 kB
+#define BACKLOG_MAX_SEGMENTS 64     // ~16000 records, more than four hours of one sonde at 1 Hz
+
+static bool mounted = false;
+static uint32_t firstSegment = 0; // oldest file, read from here
+static uint32_t lastSegment = 0;  // newest file, appended to
+static uint16_t readOffset = 0;   // records already uploaded from the first segment
+static uint16_t lastRecords = 0;  // records in the last segment
+static uint32_t count = 0;
+
+static void segmentPath(uint32_t segment, char *path) {
+  snprintf(path, 32, BACKLOG_DIR "/%08lu.bin", (unsigned long)segment);
+}
+
+static uint16_t segmentRecords(uint32_t segment) {
+  char path[32];
+  segmentPath(segment, path);
+  File file = LittleFS.open(path, FILE_READ);
+  if (!file) {
+    return 0;
+  }
+  uint16_t records = file.size() / sizeof(TelemetryRecord); // a torn last record is ignored
+  file.close();
+  return records;
+}
+
+static void savePosition() {
+  File file = LittleFS.open(BACKLOG_POSITION, FILE_WRITE);
+  if (file) {
+    file.write((const uint8_t *)&readOffset, sizeof(readOffset));
+    file.close();
+  }
+}
+
+static uint16_t loadPosition() {
+  uint16_t offset = 0;
+  File file = LittleFS.open(BACKLOG_POSITION, FILE_READ);
+  if (file) {
+    file.read((uint8_t *)&offset, sizeof(offset));
+    file.close();
+  }
+  return offset;
+}
+
+bool SetupBacklog() {
+  mounted = LittleFS.begin(true); // formats the partition on first use
+  if (!mounted) {
+    return false;
+  }
+  LittleFS.mkdir(BACKLOG_DIR);
+
+  // segments left from before a restart. Their received times are relative to the old millis(), so the
+  // server stamps them wrong, but the packets themselves are kept
+  bool found = false;
+  File dir = LittleFS.open(BACKLOG_DIR);
+  for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+    uint32_t segment = strtoul(file.name(), nullptr, 10);
+    if (!found || segment < firstSegment) {
+      firstSegment = segment;
+    }
+    if (!found || segment > lastSegment) {
+      lastSegment = segment;
+    }
+    found = true;
+    file.close();
+  }
+  dir.close();
+
+  count = 0;
+  for (uint32_t segment = firstSegment; found && segment <= lastSegment; segment++) {
+    count += segmentRecords(segment);
+  }
+  lastRecords = found ? segmentRecords(lastSegment) : 0;
+  readOffset = found ? loadPosition() : 0;
+  uint16_t firstRecords = found ? segmentRecords(firstSegment) : 0;
+  if (readOffset > firstRecords) {
+    readOffset = firstRecords;
+  }
+  count -= readOffset;
+  return true;
+}
+
+bool storeBacklog(const TelemetryRecord *records, uint8_t length) {
+  if (!mounted) {
+    return false;
+  }
+  if (lastRecords + length > BACKLOG_SEGMENT_RECORDS) {
+    if (lastSegment - firstSegment + 1 >= BACKLOG_MAX_SEGMENTS) {
+      return false; // full, keep the oldest data rather than rewriting flash in a loop
+    }
+    lastSegment++;
+    lastRecords = 0;
+  }
+
+  char path[32];
+  segmentPath(lastSegment, path);
+  File file = LittleFS.open(path, FILE_APPEND);
+  if (!file) {
+    return false;
+  }
+  size_t written = file.write((const uint8_t *)records, length * sizeof(TelemetryRecord));
+  file.close();
+
+  uint8_t stored = written / sizeof(TelemetryRecord);
+  lastRecords += stored;
+  count += stored;
+  return stored == length;
+}
+
+uint8_t peekBacklog(TelemetryRecord *records, uint8_t max) {
+  if (!mounted || count == 0) {
+    return 0;
+  }
+  char path[32];
+  segmentPath(firstSegment, path);
+  File file = LittleFS.open(path, FILE_READ);
+  while (!file && firstSegment < lastSegment) { // lost to a power cut while it was written, skip it
+    firstSegment++;
+    readOffset = 0;
+    segmentPath(firstSegment, path);
+    file = LittleFS.open(path, FILE_READ);
+  }
+  if (!file) {
+    return 0;
+  }
+  file.seek(readOffset * sizeof(TelemetryRecord));
+  uint8_t read = file.read((uint8_t *)records, max * sizeof(TelemetryRecord)) / sizeof(TelemetryRecord);
+  file.close();
+  return read;
+}
+
+void dropBacklog(uint8_t length) {
+  if (!mounted || count == 0) {
+    return;
+  }
+  count -= length < count ? length : count;
+  readOffset += length;
+
+  bool current = firstSegment == lastSegment;
+  if (readOffset >= (current ? lastRecords : segmentRecords(firstSegment))) {
+    char path[32];
+    segmentPath(firstSegment, path);
+    LittleFS.remove(path);
+    readOffset = 0;
+    if (current) {
+      lastRecords = 0; // empty again, keep appending to the same segment number
+      count = 0;
+    } else {
+      firstSegment++;
+    }
+  }
+  savePosition();
+}
+
+uint32_t backlogCount() {
+  return count;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <Arduino.h>
+#include "uploader.h"
+
+// Records that could not be uploaded, kept in LittleFS until the server is reachable again. The TTGO has
+// no PSRAM, so the backlog lives in the flash filesystem as numbered segment files, oldest first.
+// Only the upload task may call these.
+
+bool SetupBacklog();                                               // mounts the filesystem and finds segments left from before a restart
+bool storeBacklog(const TelemetryRecord *records, uint8_t count);  // false if the backlog is full
+uint8_t peekBacklog(TelemetryRecord *records, uint8_t max);        // oldest records, stay queued until dropBacklog()
+void dropBacklog(uint8_t count);                                   // removes the records the last peekBacklog() returned
+uint32_t backlogCount();
@@ -0,0 +1,194 @@
+#include "benchmark.h"
+
+#if defined(PIPELINE_BENCHMARK) || !defined(ARDUINO)
+#include "packet.h"
+#include "frame.h"
+#include "upload_format.h"
+#include "display_text.h"
+
+#define BENCHMARK_KEY_INTERVAL 10 // same as the tracker's KEYFRAME_INTERVAL
+
+static uint32_t noiseState = 12345;
+
+static int32_t noise(int32_t amplitude) { // GNSS like jitter, deterministic so runs compare
+  noiseState = noiseState * 1103515245 + 12345;
+  return (int32_t)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+void syntheticFlight(Packet *packets, uint16_t count) {
+  // 5 m/s ascent drifting north east, roughly what the tracker sends
+  noiseState = 12345;
+  for (uint16_t i = 0; i < count; i++) {
+    Packet &packet = packets[i];
+    packet.SN = 1234;
+    packet.counter = i;
+    packet.time = 1760000000 + i;
+    packet.lat = 515000000 + i * 270 + noise(20);
+    packet.lon = 100000000 + i * 420 + noise(30);
+    packet.alt = 120000 + i * 5000 + noise(1500);
+    packet.vSpeed = 500 + noise(40);
+    packet.eSpeed = 300 + noise(30);
+    packet.nSpeed = 300 + noise(30);
+    packet.sats = 12 + noise(1);
+    packet.temp = packetTempRaw(15) - i * 10 + noise(3);
+    packet.rh = packetRhRaw(60) + noise(2);
+    packet.battery = 180;
+  }
+}
+
+struct BenchmarkReceiver { // what the receiver keeps between frames
+  Packet key;
+  bool haveKey;
+  uint8_t uploadBody[UPLOAD_BINARY_SIZE(1)];
+  char jsonBody[UPLOAD_JSON_SIZE(1)];
+  char lines[DISPLAY_LINES][DISPLAY_COLUMNS];
+};
+
+static const UploadHeader benchmarkHeader = {UPLOAD_MAGIC, PACKET_SCHEMA_VERSION, {}, 0};
+
+// decode the way loop() does, with the last keyframe as reference, and check the round trip
+static bool receiveStep(BenchmarkReceiver &rx, const uint8_t *frame, size_t length, const Packet &sent, Packet &decoded) {
+  bool isKey;
+  if (decodeFrame(frame, length, rx.haveKey ? &rx.key : nullptr, decoded, isKey) != FRAME_OK ||
+      memcmp(&decoded, &sent, sizeof(Packet)) != 0) {
+    return false;
+  }
+  if (isKey) {
+    rx.key = decoded;
+    rx.haveKey = true;
+  }
+  return true;
+}
+
+static TelemetryRecord uploadStep(BenchmarkReceiver &rx, const Packet &decoded) { // queueTelemetry() and uploadRecords()
+  TelemetryRecord record = {decoded, PHASE_ASCENT, -1100, 75, decoded.counter * 1000u};
+  writeUploadBinary(rx.uploadBody, benchmarkHeader, &record, 1);
+  return record;
+}
+
+static void jsonStep(BenchmarkReceiver &rx, const TelemetryRecord &record) {
+  writeUploadJson(rx.jsonBody, &record, 1);
+}
+
+static void displayStep(BenchmarkReceiver &rx, const Packet &decoded) { // what the display task draws for it
+  DisplayInfo info = {true, decoded, -110.0f, 0, PHASE_ASCENT, 1, true};
+  renderDisplayLines(rx.lines, info);
+}
+
+static size_t encodeStep(FrameEncoder &encoder, const Packet *packets, uint16_t i, uint8_t *frame) {
+  return encodeFrame(encoder, packets[i], (packets[i].time - packets[0].time) * 1000, BENCHMARK_KEY_INTERVAL, frame);
+}
+
+PipelineResult measurePipeline(const Packet *packets, uint16_t count, uint32_t (*clock)()) {
+  FrameEncoder encoder = {};
+  BenchmarkReceiver rx = {};
+  PipelineResult result = {count, 0, 0, 0, 0, 0, 0, 0, 0};
+  uint8_t frame[FRAME_MAX_LENGTH];
+  Packet decoded;
+
+  // every packet goes the whole way before the next one, like a frame from the radio to the upload ring
+  for (uint16_t i = 0; i < count; i++) {
+    uint32_t start = clock();
+    size_t length = encodeStep(encoder, packets, i, frame);
+    uint32_t encoded = clock();
+    bool ok = receiveStep(rx, frame, length, packets[i], decoded);
+    uint32_t decodedAt = clock();
+    result.bytes += length;
+    result.encodeTicks += encoded - start;
+    result.decodeTicks += decodedAt - encoded;
+    if (!ok) {
+      result.mismatches++;
+      continue;
+    }
+    TelemetryRecord record = uploadStep(rx, decoded);
+    uint32_t uploaded = clock();
+    jsonStep(rx, record);
+    uint32_t written = clock();
+    displayStep(rx, decoded);
+    uint32_t end = clock();
+    result.uploadTicks += uploaded - decodedAt;
+    result.jsonTicks += written - uploaded;
+    result.displayTicks += end - written;
+    if (end - start > result.maxLatencyTicks) {
+      result.maxLatencyTicks = end - start;
+    }
+  }
+  return result;
+}
+
+HeapResult measureHeap(const Packet *packets, uint16_t count, HeapCounter allocations, HeapCounter bytes) {
+  FrameEncoder encoder = {};
+  BenchmarkReceiver rx = {};
+  HeapResult result = {count, 0, 0, 0, 0};
+  uint8_t frame[FRAME_MAX_LENGTH];
+  Packet decoded;
+
+  // same steps as measurePipeline(), without the clock so reading the counters costs nothing that is timed
+  for (uint16_t i = 0; i < count; i++) {
+    size_t length = encodeStep(encoder, packets, i, frame); // runs on the tracker, not counted
+    uint32_t allocationsBefore = allocations(), bytesBefore = bytes();
+    bool ok = receiveStep(rx, frame, length, packets[i], decoded);
+    if (ok) {
+      TelemetryRecord record = uploadStep(rx, decoded);
+      jsonStep(rx, record);
+    }
+    uint32_t allocationsUploaded = allocations(), bytesUploaded = bytes();
+    if (ok) {
+      displayStep(rx, decoded);
+    }
+    result.uploadAllocations += allocationsUploaded - allocationsBefore;
+    result.uploadBytes += bytesUploaded - bytesBefore;
+    result.displayAllocations += allocations() - allocationsUploaded;
+    result.displayBytes += bytes() - bytesUploaded;
+  }
+  return result;
+}
+#endif
+
+#ifdef PIPELINE_BENCHMARK
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "serial_out.h"
+
+#define BENCHMARK_FRAMES 600 // ten minutes of ascent at 1 Hz
+
+static uint32_t cycleCount() {
+  return ESP.getCycleCount();
+}
+
+// the IDF heap only keeps totals, so on the device an allocation shows up only if it is still held after the
+// step. The host run in test/test_pipeline counts every single one.
+static uint32_t heapBlocks() {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+  return info.allocated_blocks;
+}
+
+static uint32_t heapBytes() {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+  return info.total_allocated_bytes;
+}
+
+void runPipelineBenchmark() {
+  static Packet flight[BENCHMARK_FRAMES]; // kept off the stack of the setup task
+  syntheticFlight(flight, BENCHMARK_FRAMES);
+  uint32_t heapBefore = ESP.getFreeHeap();
+  PipelineResult result = measurePipeline(flight, BENCHMARK_FRAMES, cycleCount);
+  HeapResult heap = measureHeap(flight, BENCHMARK_FRAMES, heapBlocks, heapBytes);
+
+  Print &out = serialLog();
+  out.print(F("[benchmark] frames: ")); out.print(result.frames);
+  out.print(F(", avg bytes: ")); out.print((float)result.bytes / result.frames);
+  out.print(F(", round trip errors: ")); out.println(result.mismatches);
+  out.print(F("[benchmark] cycles per frame, encode: ")); out.print(result.encodeTicks / result.frames);
+  out.print(F(", decode: ")); out.print(result.decodeTicks / result.frames);
+  out.print(F(", upload: ")); out.print(result.uploadTicks / result.frames);
+  out.print(F(", JSON: ")); out.print(result.jsonTicks / result.frames);
+  out.print(F(", display: ")); out.print(result.displayTicks / result.frames);
+  out.print(F(", slowest end to end: ")); out.println(result.maxLatencyTicks);
+  out.print(F("[benchmark] heap blocks held per frame, upload: ")); out.print((float)heap.uploadAllocations / heap.frames);
+  out.print(F(", display: ")); out.print((float)heap.displayAllocations / heap.frames);
+  out.print(F(", heap change: ")); out.println((int32_t)(ESP.getFreeHeap() - heapBefore));
+}
+#endif
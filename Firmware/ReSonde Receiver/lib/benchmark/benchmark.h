@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+
+// Replays a flight through the frame codec, the upload payload writers and the OLED text, checks the round
+// trip and times each step. Build with -D PIPELINE_BENCHMARK to run it on a synthetic flight on boot and print
+// cycles per frame, average frame size and heap use, nothing of it is compiled into the firmware otherwise.
+// On the host it runs in [env:native] as test/test_pipeline, which also replays flight CSVs exported by the
+// server and counts every allocation the receiver makes per packet.
+
+#if defined(PIPELINE_BENCHMARK) || !defined(ARDUINO)
+#include "packet.h"
+
+struct PipelineResult {
+  uint32_t frames;
+  uint32_t bytes;
+  uint32_t mismatches; // frames that failed to decode or did not decode to the packet they were made from
+  uint32_t encodeTicks; // summed over all frames, in units of the clock passed to measurePipeline()
+  uint32_t decodeTicks;
+  uint32_t uploadTicks;  // TelemetryRecord and its binary upload body, what a received packet costs the upload task
+  uint32_t jsonTicks;    // the same record as JSON body, for servers without the binary endpoint
+  uint32_t displayTicks; // OLED text of the packet
+  uint32_t maxLatencyTicks; // slowest frame from packet to display, sum of all steps
+};
+
+struct HeapResult { // allocations while the receiver handles a frame, summed over all frames
+  uint32_t frames;
+  uint32_t uploadAllocations; // decode, TelemetryRecord and both upload bodies
+  uint32_t uploadBytes;
+  uint32_t displayAllocations; // OLED text
+  uint32_t displayBytes;
+};
+
+typedef uint32_t (*HeapCounter)(); // allocator statistic, read before and after every step
+
+void syntheticFlight(Packet *packets, uint16_t count); // 5 m/s ascent with GNSS like jitter, the same on every call
+PipelineResult measurePipeline(const Packet *packets, uint16_t count, uint32_t (*clock)());
+HeapResult measureHeap(const Packet *packets, uint16_t count, HeapCounter allocations, HeapCounter bytes);
+#endif
+
+#ifdef PIPELINE_BENCHMARK
+void runPipelineBenchmark();
+#endif
@@ -0,0 +1,48 @@
+#include "display_text.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+static void formatFixed(char *out, size_t size, int32_t value, uint8_t decimals) {
+  // fixed point value with 10^decimals scale, keeps float formatting out of the display task
+  int32_t scale = decimals == 1 ? 10 : (decimals == 2 ? 100 : 1000000);
+  const char *sign = value < 0 ? "-" : "";
+  uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : value;
+  snprintf(out, size, "%s%lu.%0*lu", sign, (unsigned long)(magnitude / scale), decimals, (unsigned long)(magnitude % scale));
+}
+
+void renderDisplayLines(char lines[DISPLAY_LINES][DISPLAY_COLUMNS], const DisplayInfo &info) {
+  memset(lines, 0, DISPLAY_LINES * DISPLAY_COLUMNS);
+
+  if (info.haveSonde) {
+    const Packet &packet = info.packet;
+    char a[12], b[12];
+
+    if (info.sondes > 1) { // number of sondes being tracked
+      snprintf(lines[0], DISPLAY_COLUMNS, "SN:%u | %u (%u)", packet.SN, packet.counter, info.sondes);
+    } else {
+      snprintf(lines[0], DISPLAY_COLUMNS, "SN:%u | %u", packet.SN, packet.counter);
+    }
+
+    unsigned long secondsInDay = packet.time % 86400UL;
+    snprintf(lines[1], DISPLAY_COLUMNS, "Time: %02lu:%02lu:%02lu", secondsInDay / 3600, (secondsInDay % 3600) / 60, secondsInDay % 60);
+
+    formatFixed(a, sizeof(a), packet.lat / 10, 6); // e-7 degrees to 6 decimals
+    formatFixed(b, sizeof(b), packet.lon / 10, 6);
+    snprintf(lines[2], DISPLAY_COLUMNS, "%s  %s", a, b);
+
+    snprintf(lines[3], DISPLAY_COLUMNS, "Alt: %ldm S: %u", (long)((packet.alt + (packet.alt < 0 ? -500 : 500)) / 1000), packet.sats);
+
+    formatFixed(a, sizeof(a), (packet.temp * 100L) / PACKET_TEMP_SCALE, 2);
+    formatFixed(b, sizeof(b), packet.rh * (10L / PACKET_RH_SCALE), 1);
+    snprintf(lines[4], DISPLAY_COLUMNS, "Env: %sC | %s%%", a, b);
+
+    formatFixed(a, sizeof(a), packetBatteryMillivolts(packet.battery) / 10, 2);
+    snprintf(lines[5], DISPLAY_COLUMNS, "Batt: %s V L:%lu", a, (unsigned long)info.lost);
+
+    static const char *const phaseNames[] = {"", " DESCENT", " LANDED"}; // nothing during the ascent
+    snprintf(lines[6], DISPLAY_COLUMNS, "RSSI: %ddBm%s", (int)lroundf(info.rssi), phaseNames[info.phase]);
+  }
+
+  strncpy(lines[7], info.wifiConnected ? "WiFi connected!" : "WiFi NOT connected!", DISPLAY_COLUMNS - 1);
+}
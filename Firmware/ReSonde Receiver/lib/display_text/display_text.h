@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "packet.h"
+#include "frame.h"
+
+// Text of the OLED, one line per SSD1306 page. Kept apart from the drawing so it can be checked on the host,
+// oled.cpp fills a DisplayInfo from the sonde table and WiFi and only redraws the lines that changed.
+
+#define DISPLAY_LINES 8     // 64 px panel, text size 1 is 8 px high
+#define DISPLAY_COLUMNS 22  // 21 characters of 6 px on 128 px plus terminator
+
+struct DisplayInfo { // everything one redraw shows
+  bool haveSonde;     // false leaves the sonde lines empty
+  Packet packet;      // last packet of the shown sonde
+  float rssi;         // dBm
+  uint32_t lost;      // packets missing according to counter gaps
+  FlightPhase phase;  // reported with the last packet
+  uint8_t sondes;     // sondes being tracked
+  bool wifiConnected;
+};
+
+void renderDisplayLines(char lines[DISPLAY_LINES][DISPLAY_COLUMNS], const DisplayInfo &info); // formats on the stack, allocates nothing
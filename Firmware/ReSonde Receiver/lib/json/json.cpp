@@ -0,0 +1,71 @@
+#include "json.h"
+
+static char *writeUnsigned(char *out, uint32_t value) {
+  char digits[10];
+  uint8_t n = 0;
+  do { // digits come out backwards, so collect them first
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+
+  while (n > 0) {
+    *out++ = digits[--n];
+  }
+  return out;
+}
+
+static char *writeSigned(char *out, int32_t value) {
+  if (value < 0) {
+    *out++ = '-';
+    return writeUnsigned(out, 0u - (uint32_t)value);
+  }
+  return writeUnsigned(out, value);
+}
+
+static char *writeFixed2(char *out, float value) { // two decimals, same output as String(float)
+  int32_t hundredths = lroundf(value * 100.0f);
+  if (hundredths < 0) {
+    *out++ = '-';
+    hundredths = -hundredths;
+  }
+  out = writeUnsigned(out, hundredths / 100);
+  *out++ = '.';
+  *out++ = '0' + (hundredths / 10) % 10;
+  *out++ = '0' + hundredths % 10;
+  return out;
+}
+
+static char *writeField(char *out, const uint8_t *raw, const PacketField &field) {
+  memcpy(out, field.jsonKey, field.jsonKeyLength);
+  out += field.jsonKeyLength;
+
+  const uint8_t *src = raw + field.offset; // packed struct, fields may be unaligned
+  switch (field.type) {
+    case FIELD_U8:  { return writeUnsigned(out, *src); }
+    case FIELD_U16: { uint16_t v; memcpy(&v, src, sizeof(v)); return writeUnsigned(out, v); }
+    case FIELD_U32: { uint32_t v; memcpy(&v, src, sizeof(v)); return writeUnsigned(out, v); }
+    case FIELD_I16: { int16_t v;  memcpy(&v, src, sizeof(v)); return writeSigned(out, v); }
+    case FIELD_I32: { int32_t v;  memcpy(&v, src, sizeof(v)); return writeSigned(out, v); }
+  }
+  return out;
+}
+
+size_t writeRecordJson(char *out, const Packet &packet, float rssi, float snr, uint8_t phase) {
+  char *start = out;
+  const uint8_t *raw = (const uint8_t*)&packet;
+
+  *out++ = '{';
+  for (size_t i = 0; i < packetFieldCount; i++) {
+    out = writeField(out, raw, packetFields[i]);
+    *out++ = ',';
+  }
+  memcpy(out, "\"rssi\":", 7);
+  out = writeFixed2(out + 7, rssi);
+  memcpy(out, ",\"snr\":", 7);
+  out = writeFixed2(out + 7, snr);
+  memcpy(out, ",\"phase\":", 9);
+  out = writeUnsigned(out + 9, phase);
+  *out++ = '}';
+
+  return out - start;
+}
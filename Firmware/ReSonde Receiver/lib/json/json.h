@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "packet.h"
+
+// Allocation free JSON writer for upload records. Every value is formatted straight into the
+// caller's buffer, so no String temporaries are created on the upload path.
+
+// worst case size of one record written by writeRecordJson(), computed from the Packet layout
+constexpr size_t JSON_INT_MAX = 11;  // "-2147483648"
+constexpr size_t JSON_RSSI_MAX = 12; // "-2147483.64", more than any real RSSI needs
+constexpr size_t JSON_RECORD_MAX = 2 // braces
+#define JSON_FIELD_MAX(type, name, key) + sizeof("\"" key "\":") - 1 + JSON_INT_MAX + 1
+  PACKET_FIELDS(JSON_FIELD_MAX)
+#undef JSON_FIELD_MAX
+  + sizeof("\"rssi\":") - 1 + JSON_RSSI_MAX + 1
+  + sizeof("\"snr\":") - 1 + JSON_RSSI_MAX + 1
+  + sizeof("\"phase\":") - 1 + 3;
+
+size_t writeRecordJson(char *out, const Packet &packet, float rssi, float snr, uint8_t phase); // out must hold JSON_RECORD_MAX bytes, returns bytes written
@@ -0,0 +1,115 @@
+#include "oled.h"
+#include <Wire.h>
+#include <WiFi.h>
+#include "sonde_table.h"
+#include "serial_out.h"
+#include "display_text.h"
+
+// OLED display definitions
+#define SCREEN_WIDTH 128
+#define SCREEN_HEIGHT 64
+#define OLED_RESET -1
+#define OLED_ADDRESS 0x3C
+#define OLED_I2C_CLOCK 400000 // Hz, the SSD1306 maximum. Also kept between transfers, the library default drops back to 100 kHz
+
+static_assert(DISPLAY_LINES == SCREEN_HEIGHT / 8 && DISPLAY_COLUMNS == SCREEN_WIDTH / 6 + 1, "one text line per SSD1306 page");
+
+#define DISPLAY_MIN_INTERVAL 250   // ms between redraws, caps the refresh rate at 4 Hz
+#define DISPLAY_IDLE_INTERVAL 1000 // ms, redraw at least this often so the WiFi line stays current
+#define DISPLAY_TASK_CORE 0
+#define DISPLAY_TASK_STACK 4096
+#define DISPLAY_TASK_PRIORITY 1
+
+Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET, OLED_I2C_CLOCK, OLED_I2C_CLOCK);
+
+static TaskHandle_t displayTaskHandle = nullptr;
+static volatile uint16_t shownSN = 0;
+static volatile bool haveSonde = false;
+
+static char shownLines[DISPLAY_LINES][DISPLAY_COLUMNS]; // what is currently on the panel
+
+void SetupDisplay() {
+  Wire.begin(21,22);
+  if(!display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDRESS)) {
+    serialLog().println(F("SSD1306 allocation failed"));
+    while(true){ delay(100); };
+  }
+  display.clearDisplay();
+  display.setTextSize(1);
+  display.setTextColor(SSD1306_WHITE);
+  display.setTextWrap(false); // every line is a separate page, never spill into the next one
+  display.setCursor(0,0);
+  display.println("ReSonde Receiver");
+  display.display();
+}
+
+static void pushPage(uint8_t page) {
+  // write a single 128 byte page of the frame buffer instead of the whole 1 KB
+  display.ssd1306_command(SSD1306_COLUMNADDR);
+  display.ssd1306_command(0);
+  display.ssd1306_command(SCREEN_WIDTH - 1);
+  display.ssd1306_command(SSD1306_PAGEADDR);
+  display.ssd1306_command(page);
+  display.ssd1306_command(page);
+
+  const uint8_t *data = display.getBuffer() + page * SCREEN_WIDTH;
+  const uint8_t chunk = 31; // Wire buffer minus the control byte, same as the library uses on small buffers
+  for (uint8_t sent = 0; sent < SCREEN_WIDTH; sent += chunk) {
+    uint8_t length = min(chunk, (uint8_t)(SCREEN_WIDTH - sent));
+    Wire.beginTransmission(OLED_ADDRESS);
+    Wire.write((uint8_t)0x40); // following bytes are display data
+    Wire.write(data + sent, length);
+    Wire.endTransmission();
+  }
+}
+
+static void displayTask(void *parameter) {
+  char lines[DISPLAY_LINES][DISPLAY_COLUMNS];
+  SondeState sonde = {};
+  DisplayInfo info;
+
+  memset(shownLines, 0xFF, sizeof(shownLines)); // the boot text is on the panel, so every line counts as changed
+  display.clearDisplay();
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DISPLAY_IDLE_INTERVAL)); // wait for a new packet or the idle refresh
+    unsigned long started = millis();
+
+    info.haveSonde = haveSonde && copySonde(shownSN, sonde); // snapshot, loop() may update the table meanwhile
+    info.packet = sonde.packet;
+    info.rssi = sonde.rssi;
+    info.lost = sonde.lost;
+    info.phase = sonde.phase;
+    info.sondes = sondeCount();
+    info.wifiConnected = WiFi.status() == WL_CONNECTED;
+    renderDisplayLines(lines, info);
+
+    for (uint8_t line = 0; line < DISPLAY_LINES; line++) {
+      if (strcmp(lines[line], shownLines[line]) == 0) {
+        continue; // unchanged, skip the I2C transfer
+      }
+      display.fillRect(0, line * 8, SCREEN_WIDTH, 8, SSD1306_BLACK);
+      display.setCursor(0, line * 8);
+      display.print(lines[line]);
+      pushPage(line);
+      memcpy(shownLines[line], lines[line], DISPLAY_COLUMNS);
+    }
+
+    unsigned long elapsed = millis() - started;
+    if (elapsed < DISPLAY_MIN_INTERVAL) {
+      vTaskDelay(pdMS_TO_TICKS(DISPLAY_MIN_INTERVAL - elapsed)); // rate limit, packets arriving now are shown together
+    }
+  }
+}
+
+void StartDisplayTask() {
+  xTaskCreatePinnedToCore(displayTask, "display", DISPLAY_TASK_STACK, nullptr, DISPLAY_TASK_PRIORITY, &displayTaskHandle, DISPLAY_TASK_CORE);
+}
+
+void showSonde(uint16_t sn) {
+  shownSN = sn;
+  haveSonde = true;
+  if (displayTaskHandle != nullptr) {
+    xTaskNotifyGive(displayTaskHandle);
+  }
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+
+extern Adafruit_SSD1306 display; // only use directly in setup(), before StartDisplayTask()
+
+void SetupDisplay();
+void StartDisplayTask();
+void showSonde(uint16_t sn); // schedule a redraw with the data of this sonde, never blocks
@@ -0,0 +1,211 @@
+#include "rx_queue.h"
+#include "trace.h"
+#include <atomic>
+
+#define RX_POOL_SIZE 8       // frames, must be a power of two
+#define RX_TASK_CORE 1       // same core as the DIO0 interrupt and loop()
+#define RX_TASK_STACK 3072
+#define RX_TASK_PRIORITY (configMAX_PRIORITIES - 1) // above loop() and everything else, reading the FIFO can't wait
+#define MODEM_SIGNAL_DETECTED 0x01 // RegModemStat
+
+static_assert((RX_POOL_SIZE & (RX_POOL_SIZE - 1)) == 0, "RX_POOL_SIZE must be a power of two");
+
+volatile uint32_t rxOverflows = 0;
+ChannelStats channelStats[CHANNEL_COUNT];
+
+static SX1278 *rxRadio = nullptr;
+static TaskHandle_t rxTaskHandle = nullptr;
+static SemaphoreHandle_t radioMutex = nullptr;
+static volatile bool radioHeld = false; // set while loop() uses the radio, DIO0 is not a received frame then
+static volatile bool scanning = false;  // DIO0 ends a CAD instead of a reception
+static volatile bool sending = false;   // DIO0 ends a transmission started by transmitFrame()
+static volatile uint32_t sentAt = 0;
+static bool scanStarted = false;        // a CAD is running on rxChannel
+static volatile uint8_t rxChannel = 0;  // channel the radio is tuned to
+static volatile uint32_t lockedAt = 0;
+
+// single producer (RX task) / single consumer (loop) ring, the slot index is the pool index
+static RxFrame rxPool[RX_POOL_SIZE];
+static std::atomic<uint32_t> rxHead(0); // only written by the RX task
+static std::atomic<uint32_t> rxTail(0); // only written by releaseRx()
+
+ICACHE_RAM_ATTR
+static void rxInterrupt() {
+  TRACE_EVENT(TRACE_RX_IRQ, 0);
+  if (radioHeld || rxTaskHandle == nullptr) {
+    return;
+  }
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(rxTaskHandle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+static void readFrame(RxFrame &frame) {
+  size_t length = rxRadio->getPacketLength();
+  frame.state = length <= sizeof(frame.data) ? rxRadio->readData(frame.data, length) : RADIOLIB_ERR_PACKET_TOO_LONG;
+  frame.length = length <= sizeof(frame.data) ? length : 0;
+  frame.rssi = rxRadio->getRSSI();
+  frame.snr = rxRadio->getSNR();
+  frame.frequencyError = rxRadio->getFrequencyError();
+  frame.received = millis();
+  frame.channel = rxChannel;
+  if (frame.state == RADIOLIB_ERR_NONE) {
+    channelStats[rxChannel].frames++;
+    channelStats[rxChannel].rssi = frame.rssi;
+  }
+  TRACE_EVENT(TRACE_RX_READ, frame.length);
+}
+
+static void scanStep() {
+  // lock onto a channel with a preamble, otherwise run CAD on the next one
+  if (scanStarted && rxRadio->getChannelScanResult() == RADIOLIB_LORA_DETECTED) {
+    channelStats[rxChannel].detections++;
+    scanning = false;
+    scanStarted = false;
+    lockedAt = millis();
+    rxRadio->startReceive();
+    return;
+  }
+  if (scanStarted) {
+    rxChannel = (rxChannel + 1) % CHANNEL_COUNT;
+    rxRadio->setFrequency(channels[rxChannel]);
+  }
+  scanStarted = rxRadio->startChannelScan() == RADIOLIB_ERR_NONE;
+  if (!scanStarted) {
+    scanning = false; // loop() starts over after its timeout
+    rxRadio->startReceive();
+  }
+}
+
+static void rxTask(void *parameter) {
+  static RxFrame overflow; // the FIFO is emptied even when the pool is full, the frame is dropped afterwards
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    xSemaphoreTake(radioMutex, portMAX_DELAY);
+    if (sending) {
+      rxRadio->finishTransmit();
+      rxRadio->startReceive();
+      sentAt = millis();
+      sending = false;
+      xSemaphoreGive(radioMutex);
+      continue;
+    }
+    if (scanning) {
+      scanStep();
+      xSemaphoreGive(radioMutex);
+      continue;
+    }
+    uint32_t head = rxHead.load(std::memory_order_relaxed);
+    bool full = head - rxTail.load(std::memory_order_acquire) >= RX_POOL_SIZE;
+    readFrame(full ? overflow : rxPool[head & (RX_POOL_SIZE - 1)]);
+    xSemaphoreGive(radioMutex);
+
+    if (full) {
+      rxOverflows++;
+    } else {
+      rxHead.store(head + 1, std::memory_order_release);
+    }
+  }
+}
+
+void SetupRxQueue(SX1278 &radio) {
+  rxRadio = &radio;
+  radioMutex = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(rxTask, "rx", RX_TASK_STACK, nullptr, RX_TASK_PRIORITY, &rxTaskHandle, RX_TASK_CORE);
+  radio.setPacketReceivedAction(rxInterrupt);
+}
+
+RxFrame *peekRx() {
+  uint32_t tail = rxTail.load(std::memory_order_relaxed);
+  if (tail == rxHead.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return &rxPool[tail & (RX_POOL_SIZE - 1)];
+}
+
+void releaseRx() {
+  rxTail.store(rxTail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void lockRadio() {
+  xSemaphoreTake(radioMutex, portMAX_DELAY);
+  radioHeld = true;
+}
+
+void unlockRadio() {
+  radioHeld = false;
+  xSemaphoreGive(radioMutex);
+}
+
+bool transmitFrame(uint8_t *data, size_t length) {
+  xSemaphoreTake(radioMutex, portMAX_DELAY);
+  scanning = false;
+  sending = rxRadio->startTransmit(data, length) == RADIOLIB_ERR_NONE;
+  if (!sending) {
+    rxRadio->startReceive();
+  }
+  xSemaphoreGive(radioMutex);
+  return sending;
+}
+
+bool transmitting() {
+  return sending;
+}
+
+uint32_t transmitEndedAt() {
+  return sentAt;
+}
+
+bool signalDetected() {
+  lockRadio();
+  bool detected = rxRadio->getModemStatus() & MODEM_SIGNAL_DETECTED;
+  unlockRadio();
+  return detected;
+}
+
+void scanChannels() {
+  if (CHANNEL_COUNT < 2 || scanning) {
+    return;
+  }
+  xSemaphoreTake(radioMutex, portMAX_DELAY);
+  scanStarted = false;
+  scanning = true;
+  xSemaphoreGive(radioMutex);
+  xTaskNotifyGive(rxTaskHandle); // the RX task starts the first CAD on the current channel
+}
+
+bool channelScanning() {
+  return scanning;
+}
+
+uint32_t channelLockedAt() {
+  return lockedAt;
+}
+
+void tuneChannel(uint8_t channel) {
+  if (channel >= CHANNEL_COUNT || (!scanning && channel == rxChannel)) {
+    return;
+  }
+  lockRadio();
+  scanning = false;
+  if (channel != rxChannel) {
+    rxRadio->setFrequency(channels[channel]);
+    rxChannel = channel;
+  }
+  rxRadio->startReceive();
+  unlockRadio();
+}
+
+void printChannelStats(Print &out) {
+  for (uint8_t channel = 0; channel < CHANNEL_COUNT; channel++) {
+    out.print(F("[channel] "));
+    out.print(channels[channel], 3);
+    out.print(F(" MHz, CAD: "));
+    out.print(channelStats[channel].detections);
+    out.print(F(", frames: "));
+    out.print(channelStats[channel].frames);
+    out.print(F(", RSSI: "));
+    out.println(channelStats[channel].rssi);
+  }
+}
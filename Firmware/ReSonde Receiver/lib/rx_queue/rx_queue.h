@@ -0,0 +1,56 @@
+#pragma once
+#include <Arduino.h>
+#include <RadioLib.h>
+#include "frame.h"
+#include "channels.h"
+
+struct RxFrame { // one frame read from the radio right after it arrived
+  uint8_t data[FRAME_MAX_LENGTH];
+  uint8_t length;
+  int16_t state;       // RadioLib status of readData()
+  float rssi;          // dBm
+  float snr;           // dB
+  float frequencyError; // Hz
+  uint32_t received;   // millis()
+  uint8_t channel;     // index into channels[]
+};
+
+struct ChannelStats { // written by the RX task
+  uint32_t detections; // preambles found by the channel scan
+  uint32_t frames;     // frames received with a good CRC
+  float rssi;          // dBm, of the last frame
+};
+
+extern volatile uint32_t rxOverflows; // frames read but dropped because loop() did not keep up
+extern ChannelStats channelStats[CHANNEL_COUNT];
+
+// The DIO0 interrupt wakes a high priority task that empties the radio FIFO into a preallocated pool at once,
+// so a frame arriving while loop() is busy with the previous one is not lost. The radio stays in continuous
+// receive. Frames are handed to loop() through a single producer / single consumer ring.
+void SetupRxQueue(SX1278 &radio); // registers the interrupt and starts the RX task, the radio must be receiving
+RxFrame *peekRx();                // oldest frame not yet handled, nullptr if there is none, loop() only
+void releaseRx();                 // done with the frame peekRx() returned
+
+// Other radio accesses from loop() (transmit, retuning) have to hold the radio so the RX task does not
+// talk to it at the same time. Interrupts while holding it are ignored, a transmission also raises DIO0.
+void lockRadio();
+void unlockRadio();
+
+// A transmission from loop() does not block it: the RX task takes the DIO0 at its end for the radio and puts
+// it back into receive. Retuning meanwhile would abort the transmission, loop() waits for transmitting().
+bool transmitFrame(uint8_t *data, size_t length); // loop() only, false if the radio did not start
+bool transmitting();
+uint32_t transmitEndedAt(); // millis() when the last transmission ended
+bool signalDetected();      // a preamble is being received right now, loop() only
+
+// With more than one channel in channels.h the receiver follows one sonde as it hops: loop() retunes to
+// the channel of the next frame with tuneChannel(). Once the sonde is lost, scanChannels() lets the RX task
+// run CAD on each channel in turn, on whatever profile the radio is set to (the fallback, where keyframes
+// are sent), and go back to continuous receive on the first channel with a preamble. A sweep has to fit
+// into the preamble, about 20 ms per channel at SF9 / 62.5 kHz, so more than three channels need a longer
+// preamble on both sides.
+void scanChannels();            // also when already scanning, loop() only
+bool channelScanning();
+uint32_t channelLockedAt();     // millis() when the scan last found a preamble
+void tuneChannel(uint8_t channel); // stops a scan, loop() only
+void printChannelStats(Print &out);
@@ -0,0 +1,98 @@
+#include "serial_out.h"
+
+#define SERIAL_TX_BUFFER 1024 // bytes, large enough that a frame never blocks in Serial.write()
+
+static SerialOutputMode outputMode = SERIAL_TEXT;
+
+class NullPrint : public Print {
+public:
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *buffer, size_t size) override { return size; }
+};
+
+static NullPrint discard;
+
+void SetupSerialOutput(SerialOutputMode mode) {
+  outputMode = mode;
+  Serial.setTxBufferSize(SERIAL_TX_BUFFER); // must happen before begin()
+  Serial.begin(mode == SERIAL_BINARY ? SERIAL_BINARY_BAUD : SERIAL_TEXT_BAUD);
+}
+
+Print &serialLog() {
+  if (outputMode == SERIAL_BINARY) {
+    return discard;
+  }
+  return Serial;
+}
+
+static void printPacketText(const SondeState &sonde) {
+  const Packet &packet = sonde.packet;
+  Serial.print(packet.SN); Serial.print(", "); // Serial Number
+  Serial.print(packet.counter); Serial.print(", "); // Packet counter
+  Serial.print(packet.time); Serial.print(", "); // Time in unix code
+  Serial.print(packet.lat); Serial.print(", "); // Latitude, e-7 to get standard format
+  Serial.print(packet.lon); Serial.print(", "); // Longitude, e-7 to get standard format
+  Serial.print(packet.alt); Serial.print(", "); // Altitude, in mm
+  Serial.print(packet.vSpeed); Serial.print(", "); // Vertical speed, in cm/s
+  Serial.print(packet.eSpeed); Serial.print(", "); // East speed, in cm/s
+  Serial.print(packet.nSpeed); Serial.print(", "); // North speed, in cm/s
+  Serial.print(packet.sats); Serial.print(", "); // Number of satellites
+  Serial.print(packet.temp); Serial.print(", "); // Temperature, in /320 to get C
+  Serial.print(packet.rh); Serial.print(", "); // Relative humidity, /2 to get %
+  Serial.print(packet.battery); Serial.print(", "); // battery voltage, (battery*3.3)/255 to get V
+  Serial.println(sonde.rssi);
+}
+
+static uint16_t crc16(const uint8_t *data, size_t length) { // CRC-16/CCITT-FALSE
+  uint16_t crc = 0xFFFF;
+  while (length--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static size_t cobsEncode(const uint8_t *in, size_t length, uint8_t *out) {
+  size_t codeIndex = 0; // where the length code of the current block goes
+  size_t written = 1;
+  uint8_t code = 1;
+
+  for (size_t i = 0; i < length; i++) {
+    if (in[i] != 0) {
+      out[written++] = in[i];
+      code++;
+    }
+    if (in[i] == 0 || code == 0xFF) { // block ends at a zero or after 254 data bytes
+      out[codeIndex] = code;
+      codeIndex = written++;
+      code = 1;
+    }
+  }
+  out[codeIndex] = code;
+  return written;
+}
+
+static void printPacketBinary(const SondeState &sonde) {
+  SerialFrame frame;
+  frame.version = SERIAL_FRAME_VERSION;
+  frame.rxTime = sonde.lastHeard;
+  frame.rssi = lroundf(sonde.rssi * 10.0f);
+  frame.snr = lroundf(sonde.snr * 10.0f);
+  frame.packet = sonde.packet;
+  frame.crc = crc16((const uint8_t*)&frame, offsetof(SerialFrame, crc));
+
+  uint8_t encoded[sizeof(SerialFrame) + sizeof(SerialFrame) / 254 + 2]; // COBS overhead plus the delimiter
+  size_t length = cobsEncode((const uint8_t*)&frame, sizeof(frame), encoded);
+  encoded[length++] = 0x00;
+  Serial.write(encoded, length); // one write per frame
+}
+
+void printPacket(const SondeState &sonde) {
+  if (outputMode == SERIAL_BINARY) {
+    printPacketBinary(sonde);
+  } else {
+    printPacketText(sonde);
+  }
+}
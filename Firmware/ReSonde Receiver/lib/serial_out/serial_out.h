@@ -0,0 +1,27 @@
+#pragma once
+#include <Arduino.h>
+#include "sonde_table.h"
+
+enum SerialOutputMode : uint8_t {
+  SERIAL_TEXT,   // one CSV line per packet at 115200 baud, see printPacket()
+  SERIAL_BINARY, // one COBS framed SerialFrame per packet at SERIAL_BINARY_BAUD
+};
+
+#define SERIAL_TEXT_BAUD 115200
+#define SERIAL_BINARY_BAUD 921600
+#define SERIAL_FRAME_VERSION 1
+
+// Binary mode record, little endian. On the wire it is COBS encoded and terminated by a 0x00 byte,
+// so a host can resynchronise on any zero byte and drop frames whose CRC does not match.
+struct __attribute__((packed)) SerialFrame {
+  uint8_t version;    // SERIAL_FRAME_VERSION
+  uint32_t rxTime;    // millis() of the receiver when the packet arrived
+  int16_t rssi;       // dBm * 10
+  int16_t snr;        // dB * 10
+  Packet packet;      // as received over the air
+  uint16_t crc;       // CRC-16/CCITT-FALSE over all bytes above
+};
+
+void SetupSerialOutput(SerialOutputMode mode); // replaces Serial.begin()
+Print &serialLog(); // for status text, Serial in text mode and discarded in binary mode so the frame stream stays clean
+void printPacket(const SondeState &sonde);
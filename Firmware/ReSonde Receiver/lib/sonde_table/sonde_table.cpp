@@ -0,0 +1,162 @@
+#include "sonde_table.h"
+#include "frame.h"
+
+static_assert((SONDE_TABLE_SIZE & (SONDE_TABLE_SIZE - 1)) == 0, "SONDE_TABLE_SIZE must be a power of two");
+static_assert((PARITY_HISTORY & (PARITY_HISTORY - 1)) == 0 && PARITY_HISTORY >= FRAME_PARITY_MAX_GROUP, "PARITY_HISTORY must be a power of two covering a parity group");
+
+// open addressing hash table keyed by SN. The keys are kept apart from the entries so a lookup
+// only touches one small array, probing is bounded by SONDE_TABLE_SIZE.
+static uint16_t sondeKeys[SONDE_TABLE_SIZE];
+static bool sondeUsed[SONDE_TABLE_SIZE];
+static SondeState sondes[SONDE_TABLE_SIZE];
+static Packet history[SONDE_TABLE_SIZE][PARITY_HISTORY]; // indexed by counter, kept apart so snapshots stay small
+static bool historyUsed[SONDE_TABLE_SIZE][PARITY_HISTORY];
+static uint8_t usedCount = 0;
+static portMUX_TYPE sondeLock = portMUX_INITIALIZER_UNLOCKED; // held while an entry changes, so snapshots never see half a packet
+
+static int8_t findSlot(uint16_t sn) {
+  for (uint8_t i = 0; i < SONDE_TABLE_SIZE; i++) {
+    uint8_t slot = (sn + i) & (SONDE_TABLE_SIZE - 1);
+    if (!sondeUsed[slot]) {
+      return -1; // keys are never removed, so an empty slot ends the probe
+    }
+    if (sondeKeys[slot] == sn) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+static uint8_t claimSlot(uint16_t sn) {
+  if (usedCount < SONDE_TABLE_SIZE) {
+    for (uint8_t i = 0; i < SONDE_TABLE_SIZE; i++) {
+      uint8_t slot = (sn + i) & (SONDE_TABLE_SIZE - 1);
+      if (!sondeUsed[slot]) {
+        sondeUsed[slot] = true;
+        usedCount++;
+        return slot;
+      }
+    }
+  }
+
+  // table full, replace the sonde we have not heard from for the longest time
+  uint8_t oldest = 0;
+  unsigned long now = millis();
+  for (uint8_t slot = 1; slot < SONDE_TABLE_SIZE; slot++) {
+    if (now - sondes[slot].lastHeard > now - sondes[oldest].lastHeard) {
+      oldest = slot;
+    }
+  }
+  return oldest;
+}
+
+SondeState *updateSonde(const Packet &packet, float rssi, float snr, bool isKey, FlightPhase phase) {
+  portENTER_CRITICAL(&sondeLock);
+  int8_t found = findSlot(packet.SN);
+  uint8_t slot = found >= 0 ? found : claimSlot(packet.SN);
+  SondeState &sonde = sondes[slot];
+
+  if (found < 0) { // new sonde, start fresh statistics
+    sondeKeys[slot] = packet.SN;
+    sonde.received = 0;
+    sonde.lost = 0;
+    sonde.haveKey = false;
+    sonde.gapCount = 0;
+    memset(historyUsed[slot], 0, sizeof(historyUsed[slot]));
+  } else {
+    uint16_t gap = packet.counter - sonde.packet.counter; // wraps correctly at 65535
+    if (gap > 0 && gap < 0x8000) {
+      sonde.lost += gap - 1;
+      if (gap > 1) { // remember the most recent packets of the gap, they are the most likely to still be wanted
+        sonde.gapCount = gap - 1 > GAP_MAX_COUNT ? GAP_MAX_COUNT : gap - 1;
+        sonde.gapFirst = packet.counter - sonde.gapCount;
+      }
+    } // a counter that went backwards means the tracker restarted, nothing was lost
+  }
+
+  history[slot][packet.counter & (PARITY_HISTORY - 1)] = packet;
+  historyUsed[slot][packet.counter & (PARITY_HISTORY - 1)] = true;
+  sonde.packet = packet;
+  sonde.rssi = rssi;
+  sonde.snr = snr;
+  sonde.received++;
+  sonde.lastHeard = millis();
+  sonde.phase = phase;
+  if (isKey) {
+    sonde.key = packet;
+    sonde.haveKey = true;
+  }
+  portEXIT_CRITICAL(&sondeLock);
+  return &sonde;
+}
+
+const SondeState *getSonde(uint16_t sn) {
+  int8_t slot = findSlot(sn);
+  return slot >= 0 ? &sondes[slot] : nullptr;
+}
+
+bool copySonde(uint16_t sn, SondeState &out) {
+  portENTER_CRITICAL(&sondeLock);
+  int8_t slot = findSlot(sn);
+  if (slot >= 0) {
+    out = sondes[slot];
+  }
+  portEXIT_CRITICAL(&sondeLock);
+  return slot >= 0;
+}
+
+bool takeGap(uint16_t sn, uint16_t &first, uint8_t &count) {
+  portENTER_CRITICAL(&sondeLock);
+  int8_t slot = findSlot(sn);
+  bool found = slot >= 0 && sondes[slot].gapCount > 0;
+  if (found) {
+    first = sondes[slot].gapFirst;
+    count = sondes[slot].gapCount;
+    sondes[slot].gapCount = 0;
+  }
+  portEXIT_CRITICAL(&sondeLock);
+  return found;
+}
+
+bool recoverPacket(uint16_t sn, uint16_t first, uint8_t count, const uint8_t *parity, Packet &out) {
+  // XOR of the parity and all received packets of the group leaves the missing one
+  int8_t slot = findSlot(sn);
+  if (slot < 0 || count > PARITY_HISTORY) {
+    return false;
+  }
+
+  uint8_t missing = 0;
+  uint16_t missingCounter = 0;
+  uint8_t rebuilt[FRAME_PARITY_BYTES];
+  memcpy(rebuilt, parity, sizeof(rebuilt));
+  for (uint8_t i = 0; i < count; i++) {
+    uint16_t counter = first + i;
+    const Packet &packet = history[slot][counter & (PARITY_HISTORY - 1)];
+    if (historyUsed[slot][counter & (PARITY_HISTORY - 1)] && packet.counter == counter) {
+      parityAdd(rebuilt, packet);
+    } else {
+      missing++;
+      missingCounter = counter;
+    }
+  }
+  if (missing != 1) {
+    return false; // nothing lost, or more than the parity can fix
+  }
+
+  out.SN = sn;
+  out.counter = missingCounter;
+  memcpy((uint8_t *)&out + 4, rebuilt, sizeof(rebuilt));
+
+  portENTER_CRITICAL(&sondeLock);
+  history[slot][missingCounter & (PARITY_HISTORY - 1)] = out;
+  historyUsed[slot][missingCounter & (PARITY_HISTORY - 1)] = true;
+  if (sondes[slot].lost > 0) {
+    sondes[slot].lost--;
+  }
+  portEXIT_CRITICAL(&sondeLock);
+  return true;
+}
+
+uint8_t sondeCount() {
+  return usedCount;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+#include "packet.h"
+#include "frame.h"
+
+#define SONDE_TABLE_SIZE 8 // max sondes tracked at the same time, must be a power of two
+#define PARITY_HISTORY 8   // recent packets kept per sonde to rebuild a lost one from a parity frame, power of two
+#define GAP_MAX_COUNT 16   // longest gap asked for in one NACK, the tracker only has time for a few frames anyway
+
+struct SondeState { // everything the receiver knows about one sonde
+  Packet packet;           // last packet received
+  float rssi;              // dBm, of the last packet
+  float snr;               // dB, of the last packet
+  uint32_t received;       // packets received
+  uint32_t lost;           // packets missing according to gaps in packet.counter
+  unsigned long lastHeard; // millis() of the last packet
+  FlightPhase phase;       // reported with the last packet
+  Packet key;              // last keyframe, the reference for delta frames
+  bool haveKey;
+  uint16_t gapFirst;       // first counter of the last gap, not yet asked for again
+  uint8_t gapCount;        // 0 if there is none
+};
+
+SondeState *updateSonde(const Packet &packet, float rssi, float snr, bool isKey, FlightPhase phase); // store a received packet, returns the sonde's entry
+const SondeState *getSonde(uint16_t sn);                             // nullptr if the sonde is not in the table, only safe on the loop() task
+bool copySonde(uint16_t sn, SondeState &out);                        // consistent snapshot for other tasks, false if unknown
+bool takeGap(uint16_t sn, uint16_t &first, uint8_t &count);          // hands out the sonde's last counter gap once, false if there is none
+bool recoverPacket(uint16_t sn, uint16_t first, uint8_t count, const uint8_t *parity, Packet &out); // rebuilds the one missing packet of a parity group
+uint8_t sondeCount();
@@ -0,0 +1,33 @@
+#include "upload_format.h"
+
+size_t writeUploadBinary(uint8_t *out, const UploadHeader &header, const TelemetryRecord *records, uint8_t count) {
+  // header and raw packets, the server decodes them with the layout generated from packet.h
+  memcpy(out, &header, sizeof(header));
+  size_t length = sizeof(header);
+  for (uint8_t i = 0; i < count; i++) {
+    UploadRecord record;
+    record.packet = records[i].packet;
+    record.rssi = records[i].rssi;
+    record.received = records[i].received;
+    record.phase = records[i].phase;
+    record.snr = records[i].snr;
+    memcpy(out + length, &record, sizeof(record));
+    length += sizeof(record);
+  }
+  return length;
+}
+
+size_t writeUploadJson(char *out, const TelemetryRecord *records, uint8_t count) {
+  // JSON array, one object per record in the format the server expects
+  size_t length = 0;
+  out[length++] = '[';
+  for (uint8_t i = 0; i < count; i++) {
+    if (i > 0) {
+      out[length++] = ',';
+    }
+    length += writeRecordJson(out + length, records[i].packet, records[i].rssi / 10.0f, records[i].snr / 10.0f,
+                              records[i].phase);
+  }
+  out[length++] = ']';
+  return length;
+}
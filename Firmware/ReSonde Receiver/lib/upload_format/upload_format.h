@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "packet.h"
+#include "frame.h"
+#include "json.h"
+
+struct TelemetryRecord { // one received frame waiting for upload
+  Packet packet;
+  FlightPhase phase; // fills the padding after the packet
+  int16_t rssi;      // dBm * 10
+  int16_t snr;       // dB * 10
+  uint32_t received; // millis()
+};
+
+static_assert(sizeof(TelemetryRecord) == 40, "TelemetryRecord is stored as is in the backlog");
+
+// Binary upload body (Content-Type application/octet-stream): one UploadHeader, then UploadRecords back to
+// back. The server turns received into wall clock time with its own clock: now - (sent - received).
+#define UPLOAD_MAGIC 0x5352 // "RS"
+
+struct __attribute__((packed)) UploadHeader {
+  uint16_t magic;
+  uint8_t version;       // PACKET_SCHEMA_VERSION
+  uint8_t receiverId[6]; // WiFi MAC
+  uint32_t sent;         // millis() when the batch was posted
+};
+
+struct __attribute__((packed)) UploadRecord {
+  Packet packet;
+  int16_t rssi;      // dBm * 10
+  uint32_t received; // millis()
+  uint8_t phase;     // FlightPhase
+  int16_t snr;       // dB * 10
+};
+
+// largest bodies for count records, '[', records with separators and ']' for JSON
+#define UPLOAD_BINARY_SIZE(count) (sizeof(UploadHeader) + (count) * sizeof(UploadRecord))
+#define UPLOAD_JSON_SIZE(count) ((count) * (JSON_RECORD_MAX + 1) + 2)
+
+// Both write into the caller's buffer and allocate nothing, they return the body length.
+size_t writeUploadBinary(uint8_t *out, const UploadHeader &header, const TelemetryRecord *records, uint8_t count); // out must hold UPLOAD_BINARY_SIZE(count) bytes
+size_t writeUploadJson(char *out, const TelemetryRecord *records, uint8_t count); // out must hold UPLOAD_JSON_SIZE(count) bytes
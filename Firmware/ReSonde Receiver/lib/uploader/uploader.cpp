@@ -0,0 +1,261 @@
+#include "uploader.h"
+#include "json.h"
+#include "backlog.h"
+#include "trace.h"
+#include "serial_out.h"
+#include <atomic>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+
+#define UPLOAD_QUEUE_SIZE 32   // records, must be a power of two
+#define UPLOAD_TASK_CORE 0     // loop() and the radio run on core 1, so uploads get core 0
+#define UPLOAD_TASK_STACK 8192 // bytes, TLS needs a big stack
+#define UPLOAD_TASK_PRIORITY 1
+#define UPLOAD_BATCH_SIZE 10       // max records per POST
+#define UPLOAD_BATCH_TIMEOUT 2000  // ms, max time the oldest record waits for the batch to fill
+#define UPLOAD_HTTP_TIMEOUT 5000   // ms
+#define UPLOAD_BINARY 1            // 0 posts JSON arrays for servers without the binary endpoint
+#define BACKLOG_BATCH_SIZE 40      // max records per POST when draining the backlog
+#define BACKLOG_DRAIN_INTERVAL 1000 // ms between backlog POSTs, still drains far faster than live records arrive
+#define WIFI_RETRY_INTERVAL 10000  // ms between reconnect attempts while WiFi is down
+#define UPLOAD_MAX_RECORDS (BACKLOG_BATCH_SIZE > UPLOAD_BATCH_SIZE ? BACKLOG_BATCH_SIZE : UPLOAD_BATCH_SIZE)
+
+static_assert((UPLOAD_QUEUE_SIZE & (UPLOAD_QUEUE_SIZE - 1)) == 0, "UPLOAD_QUEUE_SIZE must be a power of two");
+
+const char* serverUrl = "https://dashboard.resonde.de/api/upload";
+
+volatile uint32_t uploadOverflows = 0;
+volatile uint32_t uploadDropped = 0;
+volatile uint32_t uploadBacklog = 0;
+
+// single producer (loop) / single consumer (upload task) ring, head and tail are free running counters
+static TelemetryRecord uploadRing[UPLOAD_QUEUE_SIZE];
+static std::atomic<uint32_t> ringHead(0); // only written by queueTelemetry()
+static std::atomic<uint32_t> ringTail(0); // only written by the upload task
+
+static TaskHandle_t uploadTaskHandle = nullptr;
+
+// connection state, only touched by the upload task
+static WiFiClientSecure uploadClient;
+static HTTPClient http;
+static bool httpStarted = false;
+
+static TelemetryRecord batch[UPLOAD_BATCH_SIZE];
+static TelemetryRecord backlogBatch[BACKLOG_BATCH_SIZE];
+static unsigned long lastDrain = 0;
+static unsigned long lastWifiAttempt = 0;
+#if UPLOAD_BINARY
+static uint8_t payload[UPLOAD_BINARY_SIZE(UPLOAD_MAX_RECORDS)];
+static UploadHeader uploadHeader = {UPLOAD_MAGIC, PACKET_SCHEMA_VERSION, {}, 0};
+#else
+static char payload[UPLOAD_JSON_SIZE(UPLOAD_MAX_RECORDS)];
+#endif
+static uint8_t batchLength = 0;
+static unsigned long batchStarted = 0; // millis() when the first record of the batch was taken
+
+bool queueTelemetry(const Packet &packet, float rssi, float snr, FlightPhase phase) {
+  uint32_t head = ringHead.load(std::memory_order_relaxed);
+  uint32_t tail = ringTail.load(std::memory_order_acquire);
+
+  if (head - tail >= UPLOAD_QUEUE_SIZE) { // ring full, the upload task is behind
+    uploadOverflows++;
+    return false;
+  }
+
+  TelemetryRecord &slot = uploadRing[head & (UPLOAD_QUEUE_SIZE - 1)];
+  slot.packet = packet;
+  slot.phase = phase;
+  slot.rssi = (int16_t)lroundf(rssi * 10);
+  slot.snr = (int16_t)lroundf(snr * 10);
+  slot.received = millis();
+  ringHead.store(head + 1, std::memory_order_release);
+  TRACE_EVENT(TRACE_UPLOAD_QUEUED, packet.counter);
+
+  if (uploadTaskHandle != nullptr) {
+    xTaskNotifyGive(uploadTaskHandle); // wake the upload task
+  }
+  return true;
+}
+
+static bool popTelemetry(TelemetryRecord &record) {
+  uint32_t tail = ringTail.load(std::memory_order_relaxed);
+  uint32_t head = ringHead.load(std::memory_order_acquire);
+
+  if (tail == head) {
+    return false; // ring empty
+  }
+
+  record = uploadRing[tail & (UPLOAD_QUEUE_SIZE - 1)];
+  ringTail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+static bool uploadRecords(const TelemetryRecord *records, uint8_t count) {
+  if (!httpStarted) {
+    // one client for the whole session, HTTPClient keeps the TLS connection alive between POSTs
+    uploadClient.setInsecure(); // same as the old http.begin(url) without a CA certificate
+    http.setReuse(true);
+    http.setTimeout(UPLOAD_HTTP_TIMEOUT);
+    http.begin(uploadClient, serverUrl);
+    httpStarted = true;
+  }
+
+#if UPLOAD_BINARY
+  uploadHeader.sent = millis();
+  size_t length = writeUploadBinary(payload, uploadHeader, records, count);
+#else
+  size_t length = writeUploadJson(payload, records, count);
+#endif
+
+  http.addHeader("Content-Type", UPLOAD_BINARY ? "application/octet-stream" : "application/json"); // cleared after every response
+  int httpCode = http.POST((uint8_t*)payload, length);
+  if (httpCode <= 0) {
+    // connection level error, drop the connection so the next batch starts a fresh one
+    http.end();
+    httpStarted = false;
+  }
+  if (httpCode >= 200 && httpCode < 300) {
+    TRACE_EVENT(TRACE_UPLOAD_SENT, count);
+    return true;
+  }
+  return false;
+}
+
+static void flushBatch() {
+  // while a backlog is left the live batch queues behind it, so the server always gets records oldest first
+  if (WiFi.status() != WL_CONNECTED || backlogCount() > 0 || !uploadRecords(batch, batchLength)) {
+    if (!storeBacklog(batch, batchLength)) { // keep it for later, the server is not reachable
+      uploadDropped += batchLength;
+    }
+    uploadBacklog = backlogCount();
+  }
+  batchLength = 0;
+}
+
+static void serviceConnection() {
+  // reconnect in the background, nothing here waits for WiFi
+  if (WiFi.status() != WL_CONNECTED) {
+    if (millis() - lastWifiAttempt >= WIFI_RETRY_INTERVAL) {
+      lastWifiAttempt = millis();
+      WiFi.reconnect();
+    }
+    return;
+  }
+
+  // drain the backlog oldest first, one larger batch per interval and only while no live batch is waiting,
+  // live records go through the backlog until it is empty
+  if (batchLength == 0 && backlogCount() > 0 && millis() - lastDrain >= BACKLOG_DRAIN_INTERVAL) {
+    lastDrain = millis();
+    uint8_t count = peekBacklog(backlogBatch, BACKLOG_BATCH_SIZE);
+    if (count > 0 && uploadRecords(backlogBatch, count)) {
+      dropBacklog(count);
+    }
+    uploadBacklog = backlogCount();
+  }
+}
+
+static void uploadTask(void *parameter) {
+  while (true) {
+    // sleep until loop() queues something, or until the pending batch times out
+    TickType_t wait = portMAX_DELAY;
+    if (batchLength > 0) {
+      unsigned long age = millis() - batchStarted;
+      wait = age < UPLOAD_BATCH_TIMEOUT ? pdMS_TO_TICKS(UPLOAD_BATCH_TIMEOUT - age) : 0;
+    }
+    if (backlogCount() > 0 || WiFi.status() != WL_CONNECTED) {
+      TickType_t service = pdMS_TO_TICKS(BACKLOG_DRAIN_INTERVAL); // also paces the reconnect attempts
+      wait = wait < service ? wait : service;
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
+
+    while (batchLength < UPLOAD_BATCH_SIZE && popTelemetry(batch[batchLength])) {
+      if (batchLength == 0) {
+        batchStarted = millis();
+      }
+      batchLength++;
+
+      if (batchLength == UPLOAD_BATCH_SIZE) {
+        flushBatch();
+      }
+    }
+
+    if (batchLength > 0 && millis() - batchStarted >= UPLOAD_BATCH_TIMEOUT) {
+      flushBatch();
+    }
+
+    serviceConnection();
+  }
+}
+
+#ifdef UPLOAD_BENCHMARK
+// build with -D UPLOAD_BENCHMARK to print serializer cost per record on boot
+static String stringRecordJson(const TelemetryRecord &record) { // the old String based payload, kept for comparison
+  const Packet &packet = record.packet;
+  String json = "{";
+  json += "\"sn\":" + String(packet.SN) + ",";
+  json += "\"counter\":" + String(packet.counter) + ",";
+  json += "\"time\":" + String(packet.time) + ",";
+  json += "\"lat\":" + String(packet.lat) + ",";
+  json += "\"lon\":" + String(packet.lon) + ",";
+  json += "\"alt\":" + String(packet.alt) + ",";
+  json += "\"vSpeed\":" + String(packet.vSpeed) + ",";
+  json += "\"eSpeed\":" + String(packet.eSpeed) + ",";
+  json += "\"nSpeed\":" + String(packet.nSpeed) + ",";
+  json += "\"sats\":" + String(packet.sats) + ",";
+  json += "\"temp\":" + String(packet.temp) + ",";
+  json += "\"rh\":" + String(packet.rh) + ",";
+  json += "\"battery\":" + String(packet.battery) + ",";
+  json += "\"rssi\":" + String(record.rssi / 10.0f);
+  json += "}";
+  return json;
+}
+
+static void runSerializerBenchmark() {
+  const uint16_t rounds = 1000;
+  TelemetryRecord record = {{1234, 4321, 1760000000, 515000000, 100000000, 12345678, -512, 1234, -987, 12, -6400, 101, 180}, PHASE_ASCENT, -1125, 75, 0};
+  char buffer[JSON_RECORD_MAX];
+  volatile size_t sink = 0;
+
+  uint32_t start = ESP.getCycleCount();
+  for (uint16_t i = 0; i < rounds; i++) {
+    record.packet.counter = i;
+    sink += stringRecordJson(record).length();
+  }
+  uint32_t stringCycles = (ESP.getCycleCount() - start) / rounds;
+
+  start = ESP.getCycleCount();
+  for (uint16_t i = 0; i < rounds; i++) {
+    record.packet.counter = i;
+    sink += writeRecordJson(buffer, record.packet, record.rssi / 10.0f, record.snr / 10.0f, PHASE_ASCENT);
+  }
+  uint32_t bufferCycles = (ESP.getCycleCount() - start) / rounds;
+
+  Print &out = serialLog();
+  out.print(F("[upload] JSON cycles per record, String: ")); out.print(stringCycles);
+  out.print(F(", buffer: ")); out.println(bufferCycles);
+}
+#endif
+
+void SetupUploader(const char *ssid, const char *password) {
+#if UPLOAD_BINARY
+  uint64_t mac = ESP.getEfuseMac(); // factory MAC, first byte in the lowest bits
+  for (uint8_t i = 0; i < sizeof(uploadHeader.receiverId); i++) {
+    uploadHeader.receiverId[i] = mac >> (8 * i);
+  }
+#endif
+#ifdef UPLOAD_BENCHMARK
+  runSerializerBenchmark();
+#endif
+  if (!SetupBacklog()) {
+    serialLog().println(F("[upload] no filesystem, records are lost while offline"));
+  }
+  uploadBacklog = backlogCount();
+
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
+  WiFi.begin(ssid, password); // returns right away, the upload task keeps retrying
+  lastWifiAttempt = millis();
+
+  xTaskCreatePinnedToCore(uploadTask, "upload", UPLOAD_TASK_STACK, nullptr, UPLOAD_TASK_PRIORITY, &uploadTaskHandle, UPLOAD_TASK_CORE);
+}
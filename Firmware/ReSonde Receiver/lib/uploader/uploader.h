@@ -0,0 +1,10 @@
+#pragma once
+#include <Arduino.h>
+#include "upload_format.h" // record layout and the payload writers
+
+extern volatile uint32_t uploadOverflows; // records rejected because the upload ring was full
+extern volatile uint32_t uploadDropped;   // records neither delivered nor kept in the backlog
+extern volatile uint32_t uploadBacklog;   // records waiting in flash for the server to be reachable
+
+void SetupUploader(const char *ssid, const char *password); // starts WiFi without waiting for it and the upload task
+bool queueTelemetry(const Packet &packet, float rssi, float snr, FlightPhase phase);
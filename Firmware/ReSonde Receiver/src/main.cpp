@@ -1,12 +1,20 @@
 #include <Arduino.h>
 #include <SPI.h>
-#include <Wire.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
 #include <RadioLib.h>
 
 #include <WiFi.h>
-#include <HTTPClient.h>
+
+#include "packet.h"
+#include "frame.h"
+#include "datarate.h"
+#include "schedule.h"
+#include "oled.h"
+#include "serial_out.h"
+#include "sonde_table.h"
+#include "uploader.h"
+#include "benchmark.h"
+#include "trace.h"
+#include "rx_queue.h"
 
 
 ////// CHANGE THESE VALUES TO YOUR WIFI CREDENTIALS //////
@@ -14,218 +22,263 @@
 #define PASSWORD "Your_PASSWORD" // replace with your WiFi password
 
 
-// OLED display definitions
-#define SCREEN_WIDTH 128
-#define SCREEN_HEIGHT 64
-#define OLED_RESET -1
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-
 #define LED 25 // LED pin
 
-#define FREQUENCY           434.6   // MHz      LoRa settings. Leave like this to work with ReSonde
-#define LORA_SPREADING_FACTOR 9
-#define LORA_BANDWIDTH      62.5   // kHz
-#define LORA_CODING_RATE    8       // 4/8
+#define SERIAL_OUTPUT SERIAL_TEXT // SERIAL_TEXT for CSV lines at 115200 baud, SERIAL_BINARY for COBS framed packets at 921600 baud
+
+#define LORA_CODING_RATE    8       // 4/8      LoRa settings. Frequency, spreading factor and bandwidth follow the sonde, see channels.h and datarate.h
 #define LORA_SYNC_WORD      0x12
-#define TX_POWER            2      // tx power in dBm, neccesary but not relevant
+#define TX_POWER            10      // NACK power in dBm, the same as the trackers' so each tracker we hear also hears us
 #define LORA_PREAMBLE_LENGTH 8      // symbols
-
-const char* serverUrl = "https://dashboard.resonde.de/api/upload";
-
-
-struct __attribute__((packed)) Packet { // see printPacket() for field descriptions
-  uint16_t SN;
-  uint16_t counter;
-  uint32_t time;
-  int32_t lat;
-  int32_t lon;
-  int32_t alt;
-  int16_t vSpeed;
-  int16_t eSpeed;
-  int16_t nSpeed;
-  uint8_t sats;
-  int16_t temp;
-  uint8_t rh;
-  uint8_t battery;
-} packet;                                   // Main packet to be received
+#define NACK_DELAY          10      // ms after the frame before answering with a NACK, lets the tracker switch to receive. Plus a random backoff up to FRAME_NACK_BACKOFF
+#define SEND_NACKS          1       // ask trackers to resend packets missed in a counter gap
+#define CHANNEL_HOLD_MARGIN 50      // ms added to the tracker's NACK window and the airtime of its answer before following the sonde to its next channel
+#define CHANNEL_DWELL       1000    // ms to wait for a frame on a channel the scan locked onto
 
 
 
 SX1278 radio = new Module(18, 26, 23, -1); // LoRa(sx1278) module (CS, IRQ, RST, GPIO), works fine with ttgo V2
-volatile bool receivedFlag = false; // goes true when a packet is received
+uint32_t undecodedFrames = 0; // frames dropped because they were malformed or their keyframe was missed
+uint8_t rxRate = DATA_RATE_FALLBACK; // data rate profile the radio is listening on
+unsigned long lastFrameMillis = 0;
+FlightPhase lastFramePhase = PHASE_ASCENT; // of the followed sonde, sets how long to wait for its next frame
+int8_t nextChannel = -1; // channel of the followed sonde's next frame, -1 if there is no retune pending
+uint32_t channelHold = 0; // ms after the last frame or our NACK until the sonde's exchange on this channel is over
+
+enum NackState : uint8_t {
+  NACK_IDLE,
+  NACK_PENDING, // waiting for the end of its backoff
+  NACK_SENDING, // on the air, retuning waits for its end
+};
+NackState nackState = NACK_IDLE;
+uint8_t nack[FRAME_NACK_LENGTH];
+uint16_t nackSN;
+unsigned long nackAt = 0;                     // millis() the pending NACK starts at
+uint8_t deferredRate = DATA_RATE_COUNT;       // profile to retune to once the NACK is out, DATA_RATE_COUNT if none
+uint32_t suppressedNacks = 0;                 // NACKs dropped because another receiver already asked
+
+bool decodeReceived(const uint8_t *frame, size_t length, Packet &packet, bool &isKey) {
+  // expand a key, delta or profile frame into a full packet, using the sonde's last keyframe or packet as reference
+  uint16_t sn;
+  if (!frameSerialNumber(frame, length, sn)) {
+    undecodedFrames++;
+    return false;
+  }
 
-ICACHE_RAM_ATTR
-void setFlag(void) {
-  // set received flag after packet has been received
-  receivedFlag = true;
+  const SondeState *sonde = getSonde(sn);
+  if (frameType(frame, length) == FRAME_PROFILE) { // only some fields, the others stay as they were
+    isKey = false;
+    if (decodeProfileFrame(frame, length, sonde != nullptr ? &sonde->packet : nullptr, packet) != FRAME_OK) {
+      undecodedFrames++;
+      return false;
+    }
+    return true;
+  }
+  FrameResult result = decodeFrame(frame, length, sonde != nullptr && sonde->haveKey ? &sonde->key : nullptr, packet, isKey);
+  if (result != FRAME_OK) {
+    undecodedFrames++;
+    return false;
+  }
+  return true;
 }
 
-String convertTime(unsigned long in_time) { //function to convert unix time to string
-  unsigned long secondsInDay = in_time % 86400UL;
-
-  int hours   = secondsInDay / 3600;
-  int minutes = (secondsInDay % 3600) / 60;
-  int seconds = secondsInDay % 60;
+void sendNack(uint16_t sn, const RxFrame &rx) {
+  // the tracker listens right after each frame, on the profile it was sent on. pollNack() starts the NACK
+  // after a random backoff, so the receivers that missed the same packets don't all answer at once
+  uint16_t first;
+  uint8_t count;
+  if (!SEND_NACKS || nackState != NACK_IDLE || !takeGap(sn, first, count)) {
+    return;
+  }
+  encodeNack(sn, first, count, nack);
+  nackSN = sn;
+  nackAt = rx.received + NACK_DELAY + random(FRAME_NACK_BACKOFF + 1);
+  nackState = NACK_PENDING;
+}
 
-  char buffer[9];
-  snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d", hours, minutes, seconds);
-  return(buffer);
+void heardNack(const uint8_t *frame, size_t length) {
+  // another receiver already asks the tracker, its burst answers us too
+  uint16_t sn, first;
+  uint8_t count;
+  if (nackState == NACK_PENDING && decodeNack(frame, length, sn, first, count) && sn == nackSN) {
+    nackState = NACK_IDLE;
+    suppressedNacks++;
+  }
 }
 
+void updateChannelHold() {
+  // the tracker listens for NACKs, then sends its parity or a burst frame. Each of them restarts the hold,
+  // the longest gap is the whole listen window followed by one full frame
+  uint32_t window = FRAME_NACK_TURNAROUND + FRAME_NACK_BACKOFF + radio.getTimeOnAir(FRAME_NACK_LENGTH) / 1000;
+  channelHold = window + radio.getTimeOnAir(FRAME_MAX_LENGTH) / 1000 + CHANNEL_HOLD_MARGIN;
+}
 
-void updateDisplay() {
-  // Function to update the OLED display with received data
-  display.clearDisplay();
-  display.setCursor(0,0);
-  display.print("SN:"); display.print(packet.SN);
-  display.print(" | "); display.println(packet.counter);
-  display.print("Time: "); display.println(convertTime(packet.time));
-  display.print(String((float)packet.lat * 1e-7, 6));
-  display.print("  "); display.println(String((float)packet.lon * 1e-7, 6));
-  display.print("Alt: "); display.print((int)round(packet.alt * 1e-3)); display.print("m");
-  display.print(" S: "); display.println(packet.sats);
-  display.print("Env: "); display.print(packet.temp / 320.0f); display.print("C");
-  display.print(" | "); display.print(packet.rh * 0.5f); display.println("%");
-  display.print("Batt: "); display.print((packet.battery * 3.3f) / 255.0f); display.println(" V");
-  display.print("RSSI: "); display.print(radio.getRSSI()); display.println("dBm");
-  if(WiFi.status() == WL_CONNECTED){
-    display.println("WiFi connected!");
-  } else {
-    display.println("WiFi NOT connected!");
+void setDataRate(uint8_t rate) {
+  // retune to the profile the sonde announced for its next frame
+  if (nackState != NACK_IDLE) {
+    deferredRate = rate; // the NACK goes out on the profile the tracker listens on
+    return;
   }
-  display.display();
+  if (rate == rxRate || rate >= DATA_RATE_COUNT) {
+    return;
+  }
+  lockRadio();
+  radio.setSpreadingFactor(dataRates[rate].sf);
+  radio.setBandwidth(dataRates[rate].bw);
+  radio.startReceive();
+  updateChannelHold();
+  unlockRadio();
+  rxRate = rate;
 }
 
-void printPacket() {
-  Serial.print(packet.SN); Serial.print(", "); // Serial Number
-  Serial.print(packet.counter); Serial.print(", "); // Packet counter
-  Serial.print(packet.time); Serial.print(", "); // Time in unix code
-  Serial.print(packet.lat); Serial.print(", "); // Latitude, e-7 to get standard format
-  Serial.print(packet.lon); Serial.print(", "); // Longitude, e-7 to get standard format
-  Serial.print(packet.alt); Serial.print(", "); // Altitude, in mm
-  Serial.print(packet.vSpeed); Serial.print(", "); // Vertical speed, in cm/s
-  Serial.print(packet.eSpeed); Serial.print(", "); // East speed, in cm/s
-  Serial.print(packet.nSpeed); Serial.print(", "); // North speed, in cm/s
-  Serial.print(packet.sats); Serial.print(", "); // Number of satellites
-  Serial.print(packet.temp); Serial.print(", "); // Temperature, in /320 to get C
-  Serial.print(packet.rh); Serial.print(", "); // Relative humidity, /2 to get %
-  Serial.print(packet.battery); Serial.print(", "); // battery voltage, (battery*3.3)/255 to get V
-  Serial.println(radio.getRSSI());
+void pollNack() {
+  if (nackState == NACK_PENDING && (long)(millis() - nackAt) >= 0) {
+    if (signalDetected()) {
+      nackState = NACK_IDLE; // likely another receiver's NACK, listen to the burst instead
+      suppressedNacks++;
+    } else {
+      nackState = transmitFrame(nack, FRAME_NACK_LENGTH) ? NACK_SENDING : NACK_IDLE;
+    }
+  } else if (nackState == NACK_SENDING && !transmitting()) {
+    nackState = NACK_IDLE;
+  }
+  if (nackState == NACK_IDLE && deferredRate < DATA_RATE_COUNT) {
+    uint8_t rate = deferredRate;
+    deferredRate = DATA_RATE_COUNT;
+    setDataRate(rate);
+  }
 }
 
-void uploadTelemetry() {
-    HTTPClient http;
-    http.begin(serverUrl);
-    http.addHeader("Content-Type", "application/json");
-    
-    // Build JSON payload matching the expected format
-    String payload = "{";
-    payload += "\"sn\":" + String(packet.SN) + ",";
-    payload += "\"counter\":" + String(packet.counter) + ",";
-    payload += "\"time\":" + String(packet.time) + ",";
-    payload += "\"lat\":" + String(packet.lat) + ",";
-    payload += "\"lon\":" + String(packet.lon) + ",";
-    payload += "\"alt\":" + String(packet.alt) + ",";
-    payload += "\"vSpeed\":" + String(packet.vSpeed) + ",";
-    payload += "\"eSpeed\":" + String(packet.eSpeed) + ",";
-    payload += "\"nSpeed\":" + String(packet.nSpeed) + ",";
-    payload += "\"sats\":" + String(packet.sats) + ",";
-    payload += "\"temp\":" + String(packet.temp) + ",";
-    payload += "\"rh\":" + String(packet.rh) + ",";
-    payload += "\"battery\":" + String(packet.battery) + ",";
-    payload += "\"rssi\":" + String(radio.getRSSI());
-    payload += "}";
-    
-    int httpCode = http.POST(payload);
-    http.end();
+void followSonde(uint16_t sn, const RxFrame &rx) {
+  // the next frame comes on the announced profile and, when hopping, on the channel of the next counter
+  lastFrameMillis = rx.received;
+  setDataRate(frameNextRate(rx.data, rx.length));
+  const SondeState *sonde = getSonde(sn);
+  lastFramePhase = sonde != nullptr ? sonde->phase : framePhase(rx.data, rx.length); // parity frames carry no phase
+  if (CHANNEL_COUNT > 1 && sonde != nullptr) {
+    nextChannel = frameChannel(sn, sonde->packet.counter + 1);
+  }
 }
 
-
 void setup() {
-  Serial.begin(115200);
+  SetupSerialOutput(SERIAL_OUTPUT);
+  TRACE_BEGIN();
 
   pinMode(LED, OUTPUT);
 
   // Setup for OLED
-  Wire.begin(21,22);
-  if(!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
-    Serial.println(F("SSD1306 allocation failed"));
-    while(true){ delay(100); };
-  }
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setTextColor(SSD1306_WHITE);
-  display.setCursor(0,0);
-  display.println("ReSonde Receiver");
-  display.display();
+  SetupDisplay();
 
   
-  WiFi.begin(SSID, PASSWORD);
-  Serial.print("Connecting to WiFi");
-
-  unsigned long startAttemptTime = millis();
-  const unsigned long wifiTimeout = 30000; // 30 seconds
-
-  while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < wifiTimeout) {
-    delay(500);
-    Serial.print(".");
-  }
-
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println(" connected!");
-    display.println("WiFi connected!");
-  } else {
-    Serial.println(" failed!");
-    display.println("WiFi NOT connected!");
-  }
-
-
   // Setup for SX1278 LoRa
 
   SPI.begin(5,19,27,18); // SCK, MISO, MOSI, SS
 
-  Serial.print(F("[SX1278] Initializing ... ")); // Initialize LoRa module
-  int state = radio.begin(FREQUENCY, LORA_BANDWIDTH, LORA_SPREADING_FACTOR, LORA_CODING_RATE, LORA_SYNC_WORD, TX_POWER, LORA_PREAMBLE_LENGTH);
+  serialLog().print(F("[SX1278] Initializing ... ")); // Initialize LoRa module
+  const DataRate &fallback = dataRates[DATA_RATE_FALLBACK];
+  int state = radio.begin(channels[0], fallback.bw, fallback.sf, LORA_CODING_RATE, LORA_SYNC_WORD, TX_POWER, LORA_PREAMBLE_LENGTH);
+  if (state == RADIOLIB_ERR_NONE) {
+    state = radio.setCRC(true); // frames failing it come out of readData() with RADIOLIB_ERR_CRC_MISMATCH
+  }
   if (state == RADIOLIB_ERR_NONE) {
-    Serial.println(F("success!"));
+    serialLog().println(F("success!"));
   } else {
-    Serial.print(F("failed, code "));
-    Serial.println(state);
+    serialLog().print(F("failed, code "));
+    serialLog().println(state);
     while (true) { delay(10); }
   }
 
-  radio.setPacketReceivedAction(setFlag); // set interrupt function when packet is received
-
-  Serial.print(F("[SX1278] Starting to listen ... ")); //Set up radio to receive mode
+  serialLog().print(F("[SX1278] Starting to listen ... ")); //Set up radio to receive mode
   state = radio.startReceive();
   if (state == RADIOLIB_ERR_NONE) {
-    Serial.println(F("success!"));
+    serialLog().println(F("success!"));
     display.println("Receiving!");
   } else {
-    Serial.print(F("failed, code "));
-    Serial.println(state);
+    serialLog().print(F("failed, code "));
+    serialLog().println(state);
     while (true) { delay(10); }
   }
 
   display.display();
 
+  updateChannelHold();
+  SetupRxQueue(radio); // from here on frames are read by the RX task as soon as they arrive
+
+#ifdef PIPELINE_BENCHMARK
+  runPipelineBenchmark();
+#endif
+  SetupUploader(SSID, PASSWORD); // connect WiFi in the background and start the upload task on the other core
+  StartDisplayTask(); // from here on only the display task draws on the OLED
+}
+
+void handleFrame(const RxFrame &rx) {
+  const uint8_t *frame = rx.data;
+  size_t length = rx.length;
+  int state = rx.state;
+
+  Packet packet;
+  bool isKey;
+  FrameType type = frameType(frame, length);
+  uint16_t paritySN, parityFirst;
+  uint8_t parityCount;
+  const uint8_t *parity;
+  FlightPhase phase = framePhase(frame, length);
+  if (state == RADIOLIB_ERR_NONE && type == FRAME_NACK) {
+    heardNack(frame, length); // another receiver asking a tracker for packets, nothing to decode
+  } else if (state == RADIOLIB_ERR_NONE && decodeParityFrame(frame, length, paritySN, parityFirst, parityCount, parity)) {
+    if (recoverPacket(paritySN, parityFirst, parityCount, parity, packet)) {
+      const SondeState *sonde = getSonde(paritySN);
+      queueTelemetry(packet, rx.rssi, rx.snr, sonde != nullptr ? sonde->phase : PHASE_ASCENT); // rebuilt a frame we missed, only upload it
+    }
+    followSonde(paritySN, rx);
+  } else if (state == RADIOLIB_ERR_NONE && type == FRAME_BURST && decodeReceived(frame, length, packet, isKey)) {
+    queueTelemetry(packet, rx.rssi, rx.snr, phase); // older packet resent from the tracker's flash log, only upload it
+    followSonde(packet.SN, rx);
+  } else if(state == RADIOLIB_ERR_NONE && decodeReceived(frame, length, packet, isKey)) {
+    digitalWrite(LED, HIGH); // turning on LED to indicate packet was received
+    const SondeState *sonde = updateSonde(packet, rx.rssi, rx.snr, isKey, phase); // file packet under its SN
+    queueTelemetry(sonde->packet, sonde->rssi, rx.snr, phase); // hand the packet to the upload task, never blocks
+    showSonde(sonde->packet.SN); // let the display task redraw the OLED, never blocks
+    printPacket(*sonde); // print data on Serial port (USB)
+    digitalWrite(LED, LOW); // turn off LED after processing the received packet
+    sendNack(packet.SN, rx); // ask for what was missed before this packet
+
+    followSonde(packet.SN, rx);
+  }
 }
 
 void loop() {
-  if (receivedFlag) {
-    // reset flag
-    receivedFlag = false;
-
-    int state = radio.readData((uint8_t*)&packet, sizeof(packet)); // read data from receiver and put into packet struct
-
-    if(state == RADIOLIB_ERR_NONE) {
-      digitalWrite(LED, HIGH); // turning on LED to indicate packet was received
-      updateDisplay(); // print data on OLED
-      printPacket(); // print data on Serial port (USB)
-      if(WiFi.status() == WL_CONNECTED){
-        uploadTelemetry();
-      }
-      digitalWrite(LED, LOW); // turn off LED after processing and uploading the received packet
+  // frames were already read by the RX task, even the ones that arrived while the last one was handled
+  for (RxFrame *rx = peekRx(); rx != nullptr; rx = peekRx()) {
+    handleFrame(*rx);
+    releaseRx();
+  }
+  pollNack();
+
+  uint32_t frameTimeout = dataRateTimeout(lastFramePhase); // ms without a frame before the sonde counts as lost, longer once landed
+  if (rxRate != DATA_RATE_FALLBACK && millis() - lastFrameMillis > frameTimeout) {
+    setDataRate(DATA_RATE_FALLBACK); // lost the sonde, wait for its next keyframe on the fallback profile
+  }
+
+  unsigned long holdFrom = (long)(transmitEndedAt() - lastFrameMillis) > 0 ? transmitEndedAt() : lastFrameMillis; // our NACK's burst is still to come
+  if (nextChannel >= 0 && nackState == NACK_IDLE && millis() - holdFrom > channelHold) {
+    tuneChannel(nextChannel); // the sonde's exchange for this frame is over
+    nextChannel = -1;
+  }
+  if (CHANNEL_COUNT > 1 && !channelScanning() && nackState == NACK_IDLE && millis() - lastFrameMillis > frameTimeout &&
+      millis() - channelLockedAt() > CHANNEL_DWELL) {
+    scanChannels(); // lost the sonde or the locked preamble was not for us, search all channels
+  }
+
+  if (Serial.available()) { // commands over USB
+    char command = Serial.read();
+    if (command == 'c') {
+      printChannelStats(serialLog());
+    }
+#ifdef TRACE
+    if (command == 't') {
+      dumpTrace(serialLog());
     }
+#endif
   }
 }
\ No newline at end of file
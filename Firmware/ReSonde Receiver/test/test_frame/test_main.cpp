@@ -0,0 +1,135 @@
+// Host tests of the shared frame codec: pio test -e native
+#include <unity.h>
+#include <string.h>
+#include "packet.h"
+#include "frame.h"
+
+static Packet flightPacket(uint16_t counter) {
+  Packet packet = {1234, counter, 1760000000u + counter, 515000000 + counter * 270, 100000000 + counter * 420,
+                   120000 + counter * 5000, 500, 300, 300, 12, packetTempRaw(15), packetRhRaw(60), 180};
+  return packet;
+}
+
+void test_key_and_delta_round_trip(void) {
+  FrameEncoder encoder = {};
+  uint8_t frame[FRAME_MAX_LENGTH];
+  Packet key, decoded;
+  bool isKey;
+  for (uint16_t i = 0; i < 25; i++) {
+    Packet packet = flightPacket(i);
+    size_t length = encodeFrame(encoder, packet, i * 1000, 10, frame);
+    TEST_ASSERT_EQUAL(i % 10 == 0 ? FRAME_KEY : FRAME_DELTA, frameType(frame, length));
+    TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(frame, length, i % 10 == 0 ? nullptr : &key, decoded, isKey));
+    TEST_ASSERT_EQUAL_MEMORY(&packet, &decoded, sizeof(Packet));
+    if (isKey) {
+      key = decoded;
+    }
+  }
+}
+
+void test_delta_needs_its_key(void) {
+  FrameEncoder encoder = {};
+  uint8_t frame[FRAME_MAX_LENGTH];
+  Packet decoded;
+  bool isKey;
+  encodeFrame(encoder, flightPacket(0), 0, 10, frame);
+  size_t length = encodeFrame(encoder, flightPacket(1), 1000, 10, frame);
+  TEST_ASSERT_EQUAL(FRAME_NEED_KEY, decodeFrame(frame, length, nullptr, decoded, isKey));
+}
+
+void test_keyframe_schema_version(void) {
+  FrameEncoder encoder = {};
+  uint8_t frame[FRAME_MAX_LENGTH];
+  Packet packet = flightPacket(0), decoded;
+  bool isKey;
+  size_t length = encodeFrame(encoder, packet, 0, 10, frame);
+  TEST_ASSERT_EQUAL(2 + sizeof(Packet), length);
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame(frame, length - 1, nullptr, decoded, isKey)); // trackers without the version byte
+  frame[length - 1] = PACKET_SCHEMA_VERSION + 1;
+  TEST_ASSERT_EQUAL(FRAME_OTHER_SCHEMA, decodeFrame(frame, length, nullptr, decoded, isKey));
+}
+
+void test_bare_packet_is_a_key(void) {
+  Packet packet = flightPacket(7), decoded;
+  bool isKey;
+  TEST_ASSERT_EQUAL(FRAME_KEY, frameType((const uint8_t *)&packet, sizeof(Packet)));
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeFrame((const uint8_t *)&packet, sizeof(Packet), nullptr, decoded, isKey));
+  TEST_ASSERT_TRUE(isKey);
+  TEST_ASSERT_EQUAL_MEMORY(&packet, &decoded, sizeof(Packet));
+}
+
+void test_header_bits(void) {
+  FrameEncoder encoder = {};
+  uint8_t frame[FRAME_MAX_LENGTH];
+  size_t length = encodeFrame(encoder, flightPacket(0), 0, 10, frame);
+  frame[0] |= (2 << FRAME_RATE_SHIFT) | (PHASE_DESCENT << FRAME_PHASE_SHIFT);
+  TEST_ASSERT_EQUAL(FRAME_KEY, frameType(frame, length));
+  TEST_ASSERT_EQUAL(2, frameNextRate(frame, length));
+  TEST_ASSERT_EQUAL(PHASE_DESCENT, framePhase(frame, length));
+  uint16_t sn;
+  TEST_ASSERT_TRUE(frameSerialNumber(frame, length, sn));
+  TEST_ASSERT_EQUAL_UINT16(1234, sn);
+}
+
+void test_nack_round_trip(void) {
+  uint8_t frame[FRAME_NACK_LENGTH];
+  uint16_t sn, first;
+  uint8_t count;
+  TEST_ASSERT_EQUAL(FRAME_NACK_LENGTH, encodeNack(1234, 500, 3, frame));
+  TEST_ASSERT_TRUE(decodeNack(frame, FRAME_NACK_LENGTH, sn, first, count));
+  TEST_ASSERT_EQUAL_UINT16(1234, sn);
+  TEST_ASSERT_EQUAL_UINT16(500, first);
+  TEST_ASSERT_EQUAL_UINT8(3, count);
+}
+
+void test_parity_rebuilds_a_packet(void) {
+  uint8_t parity[FRAME_PARITY_BYTES] = {};
+  Packet group[3] = {flightPacket(10), flightPacket(11), flightPacket(12)};
+  for (const Packet &packet : group) {
+    parityAdd(parity, packet);
+  }
+  uint8_t frame[FRAME_MAX_LENGTH];
+  size_t length = encodeParityFrame(1234, 10, 3, parity, frame);
+
+  uint16_t sn, first;
+  uint8_t count;
+  const uint8_t *received;
+  TEST_ASSERT_TRUE(decodeParityFrame(frame, length, sn, first, count, received));
+  TEST_ASSERT_EQUAL_UINT8(3, count);
+  uint8_t missing[FRAME_PARITY_BYTES];
+  memcpy(missing, received, FRAME_PARITY_BYTES);
+  Packet rebuilt;
+  memcpy(&rebuilt, &group[1], 4); // only SN and counter are known of the lost one
+  parityAdd(missing, group[0]);
+  parityAdd(missing, group[2]);
+  memcpy((uint8_t *)&rebuilt + 4, missing, FRAME_PARITY_BYTES);
+  TEST_ASSERT_EQUAL_MEMORY(&group[1], &rebuilt, sizeof(Packet));
+}
+
+void test_profile_keeps_other_fields(void) {
+  Packet base = flightPacket(20), packet = flightPacket(21), decoded;
+  packet.temp = packetTempRaw(-40);
+  uint8_t frame[FRAME_MAX_LENGTH];
+  size_t length = encodeProfileFrame(PositionProfile::ID, packet, frame);
+  TEST_ASSERT_EQUAL(FRAME_PROFILE, frameType(frame, length));
+  TEST_ASSERT_EQUAL(FRAME_OK, decodeProfileFrame(frame, length, &base, decoded));
+  TEST_ASSERT_EQUAL_INT32(packet.lat, decoded.lat);
+  TEST_ASSERT_EQUAL_UINT16(packet.counter, decoded.counter);
+  TEST_ASSERT_EQUAL_INT(base.temp, decoded.temp); // not in the position profile
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_key_and_delta_round_trip);
+  RUN_TEST(test_delta_needs_its_key);
+  RUN_TEST(test_keyframe_schema_version);
+  RUN_TEST(test_bare_packet_is_a_key);
+  RUN_TEST(test_header_bits);
+  RUN_TEST(test_nack_round_trip);
+  RUN_TEST(test_parity_rebuilds_a_packet);
+  RUN_TEST(test_profile_keeps_other_fields);
+  return UNITY_END();
+}
@@ -0,0 +1,124 @@
+// Host run of the pipeline benchmark: pio test -e native -v prints the timings. The replay test reads a
+// flight CSV downloaded from the server (/api/sonde/<sn>/download/csv), set RESONDE_FLIGHT_CSV to replay
+// another one than the short flight in Firmware/test_data. The allocator below counts every heap allocation,
+// the receiver's per packet path must not make any.
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <new>
+#include "benchmark.h"
+#include "flight_csv.h"
+
+#define MAX_FLIGHT_PACKETS 20000 // about 5.5 hours at 1 Hz
+
+static uint32_t nanoseconds() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t allocationCount = 0;
+static uint32_t allocatedBytes = 0;
+
+#ifdef __GLIBC__ // the C allocator as well, glibc lets the program replace it
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+
+extern "C" void *malloc(size_t size) {
+  allocationCount++;
+  allocatedBytes += size;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+  allocationCount++;
+  allocatedBytes += count * size;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) {
+  allocationCount++;
+  allocatedBytes += size;
+  return __libc_realloc(pointer, size);
+}
+#endif
+
+void *operator new(size_t size) {
+#ifndef __GLIBC__ // counted by malloc() otherwise
+  allocationCount++;
+  allocatedBytes += size;
+#endif
+  void *pointer = malloc(size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void *pointer) noexcept {
+  free(pointer);
+}
+
+void operator delete(void *pointer, size_t size) noexcept {
+  free(pointer);
+}
+
+static uint32_t allocations() {
+  return allocationCount;
+}
+
+static uint32_t bytes() {
+  return allocatedBytes;
+}
+
+static void printResult(const char *name, const PipelineResult &result) {
+  printf("[benchmark] %s frames: %u, avg bytes: %.2f, round trip errors: %u\n", name,
+         (unsigned)result.frames, (float)result.bytes / result.frames, (unsigned)result.mismatches);
+  printf("[benchmark] %s ns per frame, encode: %u, decode: %u, upload: %u, JSON: %u, display: %u, slowest end to end: %u\n",
+         name, (unsigned)(result.encodeTicks / result.frames), (unsigned)(result.decodeTicks / result.frames),
+         (unsigned)(result.uploadTicks / result.frames), (unsigned)(result.jsonTicks / result.frames),
+         (unsigned)(result.displayTicks / result.frames), (unsigned)result.maxLatencyTicks);
+}
+
+static void checkHeap(const char *name, const Packet *packets, uint16_t count) {
+  HeapResult heap = measureHeap(packets, count, allocations, bytes);
+  printf("[benchmark] %s heap per frame, upload: %.2f allocations %.1f bytes, display: %.2f allocations %.1f bytes\n",
+         name, (float)heap.uploadAllocations / heap.frames, (float)heap.uploadBytes / heap.frames,
+         (float)heap.displayAllocations / heap.frames, (float)heap.displayBytes / heap.frames);
+  TEST_ASSERT_EQUAL_UINT32(0, heap.uploadAllocations);
+  TEST_ASSERT_EQUAL_UINT32(0, heap.displayAllocations);
+}
+
+static Packet flight[MAX_FLIGHT_PACKETS];
+
+void test_pipeline_round_trip(void) {
+  syntheticFlight(flight, 600); // ten minutes of ascent at 1 Hz
+  PipelineResult result = measurePipeline(flight, 600, nanoseconds);
+  printResult("synthetic", result);
+  TEST_ASSERT_EQUAL_UINT32(0, result.mismatches);
+  TEST_ASSERT_LESS_THAN_UINT32(result.frames * 24, result.bytes); // deltas have to pay off
+  checkHeap("synthetic", flight, 600);
+}
+
+void test_replay_flight_csv(void) {
+  const char *path = getenv("RESONDE_FLIGHT_CSV");
+  uint16_t count = readFlightCsv(path != nullptr ? path : FLIGHT_CSV, 1234, flight, MAX_FLIGHT_PACKETS);
+  if (count == 0) {
+    TEST_IGNORE_MESSAGE("no flight CSV, run from the project directory or set RESONDE_FLIGHT_CSV");
+  }
+  PipelineResult result = measurePipeline(flight, count, nanoseconds);
+  printResult("replay", result);
+  TEST_ASSERT_EQUAL_UINT32(0, result.mismatches);
+  checkHeap("replay", flight, count);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_pipeline_round_trip);
+  RUN_TEST(test_replay_flight_csv);
+  return UNITY_END();
+}
@@ -2,6 +2,16 @@
 #include <RadioLib.h>
 #include "settings.h"
 #include "debug.h"
+#include "packet.h"
+#include "frame.h"
+#include "datarate.h"
+#include "channels.h"
+#include "tdma.h"
+#include "flashlog.h"
+#include "power.h"
+#include "trace.h"
+
+#define SLOT_MARGIN 10     // ms kept free at the end of the slot
 
 STM32WLx radio = new STM32WLx_Module();
 
@@ -14,11 +24,29 @@ static const Module::RfSwitchMode_t rfswitch_table[] = {
 };
 
 int transmissionState = RADIOLIB_ERR_NONE; // variable containing transmission state
-volatile bool transmittedFlag = false; // flag set true when transmission finished
+volatile bool transmittedFlag = false; // flag set true when transmission finished or a NACK arrived
+
+enum RadioState : uint8_t {
+  RADIO_IDLE,
+  RADIO_TX,     // regular frame
+  RADIO_LISTEN, // waiting for a receiver to report missed packets
+  RADIO_PARITY, // parity frame of the FEC group
+  RADIO_BURST   // resending a missed packet from the flash log
+};
+
+RadioState radioState = RADIO_IDLE;
+uint32_t listenUntil = 0;
+uint8_t parity[FRAME_PARITY_BYTES]; // XOR of the packets sent in the current FEC group
+uint16_t parityFirst = 0;
+uint8_t parityCount = 0;
+bool parityDue = false;
+uint16_t burstNext = 0; // next counter to resend
+uint8_t burstLeft = 0;
 
 // function gets called when transmission finsihed
 void setFlag(void) {
   transmittedFlag = true;
+  TRACE_EVENT(TRACE_TX_DONE, 0);
 }
 
 void finishTransmission() {
@@ -31,43 +59,268 @@ void finishTransmission() {
   radio.finishTransmit();
 }
 
+bool radioBusy() {
+  return radioState != RADIO_IDLE;
+}
+
 void SetupRadio() {
   // set imaginary rfswitch table as the ReSonde uses no RF switch
   radio.setRfSwitchTable(rfswitch_pins, rfswitch_table);
 
   // initialize radio
-  int state = radio.begin(FREQ, BW, SF, CR, SW, TX_PWR, PL, 3.3, false);
+  const DataRate &fallback = dataRates[DATA_RATE_FALLBACK];
+  int state = radio.begin(channels[0], fallback.bw, fallback.sf, CR, SW, fallback.power, PL, 3.3, false);
   if(state != RADIOLIB_ERR_NONE) {
     DEBUG_PRINTLN("Radio init failed, code: " + String(state));
     while(true);
   }
+  radio.setCRC(2); // receivers drop frames without a good payload CRC
 
   // set the function that will be called when transmission is finished
   radio.setDio1Action(setFlag);
 }
 
-extern struct __attribute__((packed)) Packet {
-  uint16_t SN;
-  uint16_t counter;
-  uint32_t time;
-  int32_t lat;
-  int32_t lon;
-  int32_t alt;
-  int16_t vSpeed;
-  int16_t eSpeed;
-  int16_t nSpeed;
-  uint8_t sats;
-  int16_t temp;
-  uint8_t rh;
-  uint8_t battery;
-} packet;
-
-void startTX() {
-  // start transmission
-  transmissionState = radio.startTransmit((uint8_t*)&packet, sizeof(packet));
+FrameEncoder encoder; // keyframe state for delta compression
+uint8_t profileFrames = 0; // profile frames sent since the last one on the fallback profile
+FlightPhase txPhase = PHASE_ASCENT; // sent in the header of every frame with a packet
+uint8_t frame[FRAME_MAX_LENGTH]; // frame being transmitted, must stay valid until the transmission finished
+
+uint8_t txRate = DATA_RATE_FALLBACK;        // data rate profile the radio is set to
+uint8_t announcedRate = DATA_RATE_FALLBACK; // profile the previous frame announced for this one
+uint8_t scheduledRate = DATA_RATE_FALLBACK; // profile the range based schedule currently wants
+uint32_t lastTxMillis = 0;                  // start of the previous frame with a packet
+uint32_t parityDropped = 0;                 // parity frames that did not fit into the TDMA slot
+uint8_t txChannel = 0;                      // channel the radio is tuned to, see channels.h
+bool haveLaunchSite = false;
+int32_t launchLat, launchLon, launchAlt;
+
+uint8_t chooseDataRate(const Packet &packet) {
+  // pick the fastest profile whose range covers the current distance to the launch site
+  if (!haveLaunchSite) { // first packet with a good fix is the launch site
+    launchLat = packet.lat;
+    launchLon = packet.lon;
+    launchAlt = packet.alt;
+    haveLaunchSite = true;
+  }
+
+  float north = (packet.lat - launchLat) * 0.011132f; // e-7 degrees to m
+  float east = (packet.lon - launchLon) * 0.011132f * cosf(packet.lat * 1.745329e-9f);
+  float up = (packet.alt - launchAlt) * 0.001f;
+  uint32_t range = sqrtf(north * north + east * east + up * up);
+
+  while (scheduledRate > 0 && range > dataRates[scheduledRate].range) {
+    scheduledRate--; // link getting longer, slow down straight away
+  }
+  while (scheduledRate + 1 < DATA_RATE_COUNT && range < dataRates[scheduledRate + 1].range / 5 * 4) {
+    scheduledRate++; // only speed up with 20% margin, so the rate does not flap at a boundary
+  }
+  return scheduledRate;
+}
+
+void applyDataRate(uint8_t rate) {
+  if (rate == txRate) {
+    return;
+  }
+  radio.setSpreadingFactor(dataRates[rate].sf);
+  radio.setBandwidth(dataRates[rate].bw);
+  radio.setOutputPower(dataRates[rate].power);
+  txRate = rate;
+}
+
+void applyChannel(uint8_t channel) {
+  if (channel == txChannel) {
+    return;
+  }
+  radio.setFrequency(channels[channel]);
+  txChannel = channel;
+}
+
+static_assert(FEC_GROUP == 0 || (FEC_GROUP >= 2 && FEC_GROUP <= FRAME_PARITY_MAX_GROUP), "FEC_GROUP must be 0 or 2 to 4");
+static_assert(FEC_GROUP == 0 || PACKET_PROFILE == PACKET_PROFILE_FULL, "parity covers whole packets, receivers only have the profile's fields");
+
+void addToParity(const Packet &packet) {
+  // groups are consecutive counters, a packet that was never sent starts a new group
+  if (parityCount == 0 || packet.counter != (uint16_t)(parityFirst + parityCount)) {
+    memset(parity, 0, sizeof(parity));
+    parityFirst = packet.counter;
+    parityCount = 0;
+  }
+  parityAdd(parity, packet);
+  parityDue = ++parityCount == FEC_GROUP;
+}
+
+void startTX(const Packet &packet, FlightPhase phase, uint32_t interval) {
+  uint32_t now = millis();
+  if (now - lastTxMillis > dataRateTimeout(txPhase)) {
+    announcedRate = DATA_RATE_FALLBACK; // receivers gave up on the announcement, they wait as long as the last frame's phase says
+  }
+  lastTxMillis = now;
+
+  // compress the packet into a key or delta frame, or pack the profile for this phase, and start transmission
+  // PTU is not sampled after burst. Its fields stay as they were, so delta frames keep descent frames short,
+  // only the landed beacons are too far apart for deltas and send the self contained position profile
+  uint8_t profile = phase == PHASE_ASCENT ? PACKET_PROFILE : phase == PHASE_DESCENT ? PACKET_PROFILE_FULL : PositionProfile::ID;
+  size_t length;
+  bool nextKey;
+  if (profile == PACKET_PROFILE_FULL) {
+    length = encodeFrame(encoder, packet, now, KEYFRAME_INTERVAL, frame);
+    if ((frame[0] & FRAME_TYPE_MASK) == FRAME_KEY && announcedRate != DATA_RATE_FALLBACK) {
+      forceKeyframe(encoder); // the delta did not pay off and this key goes out fast, repeat it on the fallback
+    }
+    nextKey = nextFrameIsKey(encoder, KEYFRAME_INTERVAL);
+  } else {
+    length = encodeProfileFrame(profile, packet, frame); // self contained, no keyframe needed
+    profileFrames = (profileFrames + 1) % KEYFRAME_INTERVAL;
+    nextKey = profileFrames == 0; // still every n-th frame on the fallback profile
+  }
+
+  // announce the next frame's data rate, keyframes always use the fallback so lost receivers find us again.
+  // So does a frame further away than receivers wait on an announced profile, e.g. across the descent to
+  // landed switch, and every landed beacon, a receiver that lost them would wait ten beacons for a keyframe
+  uint8_t nextRate = DATA_RATE_FALLBACK;
+  if (ADAPTIVE_DATA_RATE && !nextKey && phase != PHASE_LANDED && interval <= dataRateTimeout(phase)) {
+    nextRate = chooseDataRate(packet);
+  }
+  frame[0] |= (nextRate << FRAME_RATE_SHIFT) | (phase << FRAME_PHASE_SHIFT);
+  txPhase = phase;
+  applyDataRate(announcedRate); // receivers expect this frame on the profile we announced last time
+  applyChannel(frameChannel(SERIAL_NUMBER, packet.counter)); // listen, parity and bursts follow on the same channel
+  announcedRate = nextRate;
+  if (FEC_GROUP && profile == PACKET_PROFILE_FULL) {
+    addToParity(packet);
+  }
+  if (radio.getTimeOnAir(length) > slotLength() * 1000) {
+    DEBUG_PRINTLN("Frame is longer than the TDMA slot"); // slow profiles need fewer TDMA_SLOTS
+  }
+  TRACE_EVENT(TRACE_TX_START, frame[0] & FRAME_TYPE_MASK);
+  transmissionState = radio.startTransmit(frame, length);
   if (transmissionState == RADIOLIB_ERR_NONE) {
+    radioState = RADIO_TX;
     DEBUG_PRINTLN("Transmission started...");    
   } else {
     DEBUG_PRINTLN("Transmission failed to start, code: " + String(transmissionState));
   }
-}
\ No newline at end of file
+}
+
+bool fitsSlot(uint32_t duration) {
+  return duration + SLOT_MARGIN < slotTimeLeft();
+}
+
+bool startListening() {
+  // receivers answer a frame that revealed a counter gap with a NACK on the same profile
+  uint32_t window = FRAME_NACK_TURNAROUND + FRAME_NACK_BACKOFF + radio.getTimeOnAir(FRAME_NACK_LENGTH) / 1000;
+  if (!BURST_DOWNLINK || !fitsSlot(window) || radio.startReceive() != RADIOLIB_ERR_NONE) {
+    return false;
+  }
+  listenUntil = millis() + window;
+  requestWakeup(listenUntil);
+  radioState = RADIO_LISTEN;
+  return true;
+}
+
+bool startParity() {
+  // sent after the group's last frame, on the profile receivers expect our next frame on
+  if (!parityDue) {
+    return false;
+  }
+  parityDue = false;
+  size_t length = encodeParityFrame(SERIAL_NUMBER, parityFirst, parityCount, parity, frame);
+  parityCount = 0;
+  frame[0] |= announcedRate << FRAME_RATE_SHIFT;
+  applyDataRate(announcedRate);
+  if (!fitsSlot(radio.getTimeOnAir(length) / 1000)) {
+    parityDropped++; // the group is unprotected, see FEC_GROUP in settings.h
+    DEBUG_PRINTLN("Parity frame does not fit the TDMA slot, dropped " + String(parityDropped));
+    return false;
+  }
+  if (radio.startTransmit(frame, length) != RADIOLIB_ERR_NONE) {
+    return false;
+  }
+  radioState = RADIO_PARITY;
+  return true;
+}
+
+bool startBurst() {
+  // resend the next missed packet, on the profile receivers already expect our next frame on
+  Packet logged;
+  while (burstLeft > 0) {
+    uint16_t counter = burstNext++;
+    burstLeft--;
+    if (!findLogged(counter, logged)) {
+      continue; // from before the last restart
+    }
+
+    size_t length = encodeBurstFrame(logged, frame);
+    frame[0] |= (announcedRate << FRAME_RATE_SHIFT) | (txPhase << FRAME_PHASE_SHIFT);
+    applyDataRate(announcedRate);
+    if (!fitsSlot(radio.getTimeOnAir(length) / 1000)) {
+      burstLeft = 0; // the rest has to be asked for again
+      return false;
+    }
+    if (radio.startTransmit(frame, length) == RADIOLIB_ERR_NONE) {
+      radioState = RADIO_BURST;
+      return true;
+    }
+  }
+  return false;
+}
+
+void receiveNack() {
+  uint8_t nack[FRAME_NACK_LENGTH];
+  uint16_t sn, first;
+  uint8_t count;
+  size_t length = radio.getPacketLength();
+  if (length == FRAME_NACK_LENGTH && radio.readData(nack, length) == RADIOLIB_ERR_NONE &&
+      decodeNack(nack, length, sn, first, count) && sn == SERIAL_NUMBER) {
+    DEBUG_PRINTLN("NACK received for " + String(count) + " packets from " + String(first));
+    if (burstLeft == 0) {
+      burstNext = first;
+      burstLeft = count;
+    }
+    radio.standby();
+    if (!startParity() && !startBurst()) {
+      radioState = RADIO_IDLE;
+    }
+    return;
+  }
+  radio.startReceive(); // not for us, keep listening until the window closes
+}
+
+void pollRadio() {
+  if (transmittedFlag) {
+    transmittedFlag = false;
+    switch (radioState) {
+      case RADIO_TX:
+        finishTransmission();
+        DEBUG_PRINTLN("Transmission finished");
+        if (!startListening() && !startParity() && !startBurst()) {
+          radioState = RADIO_IDLE;
+        }
+        break;
+      case RADIO_PARITY:
+        radio.finishTransmit();
+        if (!startBurst()) {
+          radioState = RADIO_IDLE;
+        }
+        break;
+      case RADIO_LISTEN:
+        receiveNack();
+        break;
+      case RADIO_BURST:
+        radio.finishTransmit();
+        if (!startBurst()) {
+          radioState = RADIO_IDLE;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (radioState == RADIO_LISTEN && (int32_t)(millis() - listenUntil) >= 0) {
+    radio.standby(); // no NACK, carry on with the parity and what was already asked for
+    if (!startParity() && !startBurst()) {
+      radioState = RADIO_IDLE;
+    }
+  }
+}
@@ -1,5 +1,10 @@
+#include "packet.h"
+#include "frame.h"
+
 void SetupRadio();
-extern volatile bool transmittedFlag;
-void finishTransmission();
+void pollRadio();  // handles DIO1 and the NACK listen window, call from loop()
+bool radioBusy();  // transmitting, listening for a NACK or resending logged packets
+
+extern uint32_t parityDropped; // parity frames skipped because they did not fit into the TDMA slot
 
-void startTX();
\ No newline at end of file
+void startTX(const Packet &packet, FlightPhase phase, uint32_t interval); // deltas during descent, the position profile once landed, interval is the ms until the next one
\ No newline at end of file
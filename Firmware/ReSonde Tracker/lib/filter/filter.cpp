@@ -0,0 +1,131 @@
+#include "filter.h"
+#include "settings.h"
+#include "packet.h"
+
+#define FILTER_Q 16           // fraction bits of the gains
+#define FILTER_MAX_GAP 5000   // ms without an update after which the filter starts over from the measurement
+#define MM_PER_DEGREE_E3 11132 // mm per 1e-7 degree of latitude, times 1000
+#define RH_NONE 255
+
+constexpr int32_t filterGain(double gain) { return (int32_t)(gain * (1L << FILTER_Q) + 0.5); }
+
+constexpr int32_t POSITION_GAIN = filterGain(0.3); // share of the GNSS position, the rest comes from the integrated velocity
+constexpr int32_t VELOCITY_GAIN = filterGain(0.5); // share of the new GNSS velocity
+constexpr int32_t RH_GAIN = filterGain(0.5);       // smoothing ahead of the lag correction, which amplifies noise
+constexpr int32_t RH_MAX_CORRECTION = packetRhRaw(15); // lag correction is limited to this, in packet units
+
+// Response time of a polymer capacitive humidity sensor over temperature, linear in between.
+// Typical values, calibrate them against the sensor actually fitted.
+struct LagPoint {
+  int16_t temp;  // packet units
+  uint16_t tau;  // ms
+};
+
+static const LagPoint lagTable[] = {
+  {packetTempRaw(-60), 60000},
+  {packetTempRaw(-40), 15000},
+  {packetTempRaw(-20), 4000},
+  {packetTempRaw(0), 1500},
+  {packetTempRaw(20), 600},
+};
+
+#define LAG_POINTS (sizeof(lagTable) / sizeof(lagTable[0]))
+
+static FilteredState state;
+static bool initialized = false;
+static uint32_t lastUpdate = 0;   // millis() of the last fix
+static int32_t rhSmooth = 0;      // packet units << FILTER_Q
+static uint32_t rhTaken = 0;      // taken time of the last sample used
+static bool rhValid = false;
+
+static int32_t blend(int32_t value, int32_t measured, int32_t gain) {
+  int64_t difference = (int64_t)measured - value;
+  return value + (int32_t)((difference * gain + (1L << (FILTER_Q - 1))) >> FILTER_Q);
+}
+
+static int64_t cosineQ(int32_t lat) {
+  // Bhaskara's approximation in millidegrees, within 0.2 % and no trigonometry needed
+  int64_t d = (lat < 0 ? -(int64_t)lat : lat) / 10000;
+  const int64_t halfTurn2 = 32400000000LL; // 180000 millidegrees squared
+  int64_t cosine = ((halfTurn2 - 4 * d * d) << FILTER_Q) / (halfTurn2 + d * d);
+  return cosine < (1 << FILTER_Q) / 100 ? (1 << FILTER_Q) / 100 : cosine; // longitude steps explode at the pole
+}
+
+static uint32_t sensorLag(int16_t temp) {
+  if (temp <= lagTable[0].temp)
+    return lagTable[0].tau;
+  for (uint8_t i = 1; i < LAG_POINTS; i++) {
+    if (temp < lagTable[i].temp) {
+      const LagPoint &a = lagTable[i - 1], &b = lagTable[i];
+      return a.tau + (int32_t)((int32_t)b.tau - a.tau) * (temp - a.temp) / (b.temp - a.temp);
+    }
+  }
+  return lagTable[LAG_POINTS - 1].tau;
+}
+
+static void updateHumidity(const SensorSample &sample) {
+  if (sample.rh == RH_NONE) {
+    rhValid = false;
+    state.rh = RH_NONE;
+    return;
+  }
+  if (rhValid && sample.taken == rhTaken)
+    return; // no new sample since the last epoch
+
+  int32_t measured = (int32_t)sample.rh << FILTER_Q;
+  if (!rhValid || sample.taken - rhTaken > FILTER_MAX_GAP) {
+    rhSmooth = measured;
+    rhTaken = sample.taken;
+    rhValid = true;
+    state.rh = sample.rh;
+    return;
+  }
+
+  uint32_t dt = sample.taken - rhTaken;
+  int32_t previous = rhSmooth;
+  rhSmooth = blend(rhSmooth, measured, RH_GAIN);
+  rhTaken = sample.taken;
+
+  // first order sensor: true = measured + tau * d(measured)/dt
+  int64_t correction = ((int64_t)(rhSmooth - previous) * sensorLag(sample.temp) / dt) >> FILTER_Q;
+  correction = constrain(correction, (int64_t)-RH_MAX_CORRECTION, (int64_t)RH_MAX_CORRECTION);
+  int32_t rh = ((rhSmooth + (1 << (FILTER_Q - 1))) >> FILTER_Q) + (int32_t)correction;
+  state.rh = (uint8_t)constrain(rh, (int32_t)0, (int32_t)packetRhRaw(100));
+}
+
+const FilteredState &updateFilter(const GnssFix &fix, const SensorSample &sample) {
+#if STATE_FILTER
+  uint32_t dt = fix.received - lastUpdate;
+  if (initialized && dt < FILTER_MAX_GAP) {
+    // predict with the velocity of the last epoch, then correct with the measurements
+    int64_t northMm = (int64_t)state.velN * dt, eastMm = (int64_t)state.velE * dt; // mm * 1000
+    state.lat += (int32_t)(northMm / MM_PER_DEGREE_E3);
+    state.lon += (int32_t)((eastMm << FILTER_Q) / (MM_PER_DEGREE_E3 * cosineQ(state.lat)));
+    state.alt -= (int32_t)((int64_t)state.velD * dt / 1000);
+
+    state.lat = blend(state.lat, fix.lat, POSITION_GAIN);
+    state.lon = blend(state.lon, fix.lon, POSITION_GAIN);
+    state.alt = blend(state.alt, fix.altMSL, POSITION_GAIN);
+    state.velN = blend(state.velN, fix.velN, VELOCITY_GAIN);
+    state.velE = blend(state.velE, fix.velE, VELOCITY_GAIN);
+    state.velD = blend(state.velD, fix.velD, VELOCITY_GAIN);
+  } else
+#endif
+  {
+    state.lat = fix.lat;
+    state.lon = fix.lon;
+    state.alt = fix.altMSL;
+    state.velN = fix.velN;
+    state.velE = fix.velE;
+    state.velD = fix.velD;
+    initialized = true;
+  }
+  lastUpdate = fix.received;
+
+#if STATE_FILTER
+  updateHumidity(sample);
+#else
+  state.rh = sample.rh;
+#endif
+  return state;
+}
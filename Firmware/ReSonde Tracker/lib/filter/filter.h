@@ -0,0 +1,18 @@
+#pragma once
+#include <Arduino.h>
+#include "gnss.h"
+#include "sensors.h"
+
+// State filter run once per GNSS epoch, so a packet sent every few epochs still carries the trend of all of
+// them. A complementary filter integrates the GNSS velocity and pulls the result towards the GNSS position,
+// and the humidity is corrected for the response time of the sensor, which grows as it gets colder.
+// The STM32WL has no FPU, so it is all integer math with the gains fixed at compile time.
+
+struct FilteredState {
+  int32_t lat, lon;         // e-7 degrees
+  int32_t alt;              // mm
+  int32_t velN, velE, velD; // mm/s
+  uint8_t rh;               // packet units, 255 while there is no measurement
+};
+
+const FilteredState &updateFilter(const GnssFix &fix, const SensorSample &sample); // call for each NAV-PVT used
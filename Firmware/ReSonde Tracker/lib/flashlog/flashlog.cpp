@@ -0,0 +1,168 @@
+#include "flashlog.h"
+#include "debug.h"
+
+#define LOG_PAGES 32    // 64 kB at the end of the flash
+#define LOG_MAGIC 0x474C5352u // "RSLG"
+#define LOG_QUEUE_SIZE 8 // records waiting to be programmed
+#define RECORD_WORDS (sizeof(LogRecord) / sizeof(uint64_t))
+#define RECORDS_PER_PAGE ((FLASH_PAGE_SIZE - sizeof(PageHeader)) / sizeof(LogRecord))
+
+struct __attribute__((packed)) PageHeader { // first double word of every page
+  uint32_t magic;
+  uint32_t sequence; // increases by one per page written, across restarts
+};
+
+struct __attribute__((packed)) LogRecord {
+  Packet packet;
+  uint8_t check; // inverted XOR of the packet, so erased or half written records are rejected
+};
+
+static_assert(sizeof(PageHeader) == sizeof(uint64_t), "page header must be one double word");
+static_assert(sizeof(LogRecord) % sizeof(uint64_t) == 0, "records must be whole double words");
+
+extern uint32_t _sidata, _sdata, _edata; // from the linker script, end of the firmware image
+
+static uintptr_t logStart = 0; // address of the first log page, 0 if the log is disabled
+static uint8_t page = 0;      // page being written
+static uint16_t record = 0;   // next record in it, 0 if the page still has to be erased
+static uint8_t word = 0;      // next double word of the record at the head of the queue
+static uint32_t sequence = 0;
+static uint32_t sessionSequence = 0; // first page sequence written since this start
+
+static LogRecord queue[LOG_QUEUE_SIZE];
+static uint8_t queueHead = 0, queueLength = 0;
+
+static uintptr_t pageAddress(uint8_t p) {
+  return logStart + (uintptr_t)p * FLASH_PAGE_SIZE;
+}
+
+static const PageHeader &pageHeader(uint8_t p) {
+  return *(const PageHeader *)pageAddress(p);
+}
+
+static const LogRecord &pageRecord(uint8_t p, uint16_t r) {
+  return *(const LogRecord *)(pageAddress(p) + sizeof(PageHeader) + r * sizeof(LogRecord));
+}
+
+static uint8_t recordCheck(const Packet &packet) {
+  const uint8_t *bytes = (const uint8_t *)&packet;
+  uint8_t check = 0;
+  for (uint8_t i = 0; i < sizeof(Packet); i++) {
+    check ^= bytes[i];
+  }
+  return ~check;
+}
+
+void SetupLog() {
+  logStart = FLASH_BASE + FLASH_SIZE - LOG_PAGES * FLASH_PAGE_SIZE;
+  uintptr_t imageEnd = (uintptr_t)&_sidata + ((uintptr_t)&_edata - (uintptr_t)&_sdata);
+  if (imageEnd > logStart) {
+    DEBUG_PRINTLN("Firmware overlaps the flash log, logging disabled");
+    logStart = 0;
+    return;
+  }
+
+  bool found = false;
+  for (uint8_t p = 0; p < LOG_PAGES; p++) {
+    const PageHeader &header = pageHeader(p);
+    if (header.magic == LOG_MAGIC && (!found || (int32_t)(header.sequence - sequence) > 0)) {
+      page = p;
+      sequence = header.sequence;
+      found = true;
+    }
+  }
+
+  // never append to a page of an earlier run, the counters start over after a restart
+  page = found ? (page + 1) % LOG_PAGES : 0;
+  sequence++;
+  sessionSequence = sequence;
+  record = 0;
+}
+
+void logPacket(const Packet &packet) {
+  if (logStart == 0) {
+    return;
+  }
+  if (queueLength == LOG_QUEUE_SIZE) {
+    DEBUG_PRINTLN("Flash log queue full, dropping packet");
+    return;
+  }
+  LogRecord &entry = queue[(queueHead + queueLength) % LOG_QUEUE_SIZE];
+  entry.packet = packet;
+  entry.check = recordCheck(packet);
+  queueLength++;
+}
+
+void pollLog() {
+  if (queueLength == 0) {
+    return;
+  }
+
+  HAL_FLASH_Unlock();
+  if (record == 0) { // start a new page, the erase stalls the CPU for ~20 ms once per page
+    FLASH_EraseInitTypeDef erase;
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Page = (pageAddress(page) - FLASH_BASE) / FLASH_PAGE_SIZE;
+    erase.NbPages = 1;
+    uint32_t error;
+    PageHeader header = {LOG_MAGIC, sequence};
+    uint64_t headerWord;
+    memcpy(&headerWord, &header, sizeof(headerWord));
+    if (HAL_FLASHEx_Erase(&erase, &error) == HAL_OK && HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, pageAddress(page), headerWord) == HAL_OK) {
+      record = 1; // records are counted from 1 here, 0 means the page is not ready
+    } else {
+      DEBUG_PRINTLN("Flash log page erase failed");
+    }
+  } else {
+    uint64_t data;
+    memcpy(&data, (const uint8_t *)&queue[queueHead] + word * sizeof(uint64_t), sizeof(data));
+    uintptr_t address = (uintptr_t)&pageRecord(page, record - 1) + word * sizeof(uint64_t);
+    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address, data) != HAL_OK) {
+      DEBUG_PRINTLN("Flash log write failed");
+    }
+
+    if (++word == RECORD_WORDS) { // record complete
+      word = 0;
+      queueHead = (queueHead + 1) % LOG_QUEUE_SIZE;
+      queueLength--;
+      if (record++ == RECORDS_PER_PAGE) { // page full, move on to the next one
+        page = (page + 1) % LOG_PAGES;
+        sequence++;
+        record = 0;
+      }
+    }
+  }
+  HAL_FLASH_Lock();
+}
+
+bool findLogged(uint16_t counter, Packet &out) {
+  if (logStart == 0) {
+    return false;
+  }
+  for (uint8_t i = queueLength; i > 0; i--) { // not programmed yet
+    const LogRecord &entry = queue[(queueHead + i - 1) % LOG_QUEUE_SIZE];
+    if (entry.packet.counter == counter) {
+      out = entry.packet;
+      return true;
+    }
+  }
+
+  uint8_t p = page;
+  uint16_t written = record > 0 ? record - 1 : 0; // complete records in the current page
+  for (uint8_t pages = 0; pages < LOG_PAGES; pages++) {
+    const PageHeader &header = pageHeader(p);
+    if (header.magic != LOG_MAGIC || (int32_t)(header.sequence - sessionSequence) < 0) {
+      break; // reached a page of an earlier run
+    }
+    for (uint16_t r = written; r > 0; r--) {
+      const LogRecord &entry = pageRecord(p, r - 1);
+      if (entry.packet.counter == counter && entry.check == recordCheck(entry.packet)) {
+        out = entry.packet;
+        return true;
+      }
+    }
+    p = (p + LOG_PAGES - 1) % LOG_PAGES;
+    written = RECORDS_PER_PAGE;
+  }
+  return false;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <Arduino.h>
+#include "packet.h"
+
+// Append-only log of every packet in the last LOG_PAGES pages of the internal flash, used to resend
+// packets a receiver missed. Pages are used as a ring, so each one is erased once per lap.
+
+void SetupLog();                                 // finds the newest page and starts a new session after it
+void logPacket(const Packet &packet);            // queues the packet, it is programmed by pollLog()
+void pollLog();                                  // programs one double word of the queue per call
+bool findLogged(uint16_t counter, Packet &out);  // searches this session's packets, newest first
@@ -0,0 +1,241 @@
+#include "gnss.h"
+#include "debug.h"
+#include "settings.h"
+#include <SparkFun_u-blox_GNSS_v3.h>
+
+// The SparkFun library is only used to configure the module. Afterwards USART2 (PA3 RX, PA2 TX) is
+// handed to a circular DMA transfer and NAV-PVT is parsed straight out of the DMA buffer, so receiving
+// costs no CPU time apart from the parsing itself.
+
+#define GNSS_BAUD 38400
+#define GNSS_DMA_SIZE 1024 // bytes, about 260 ms of data at 38400 baud, the longest loop() may stall
+
+HardwareSerial SerialGNSS(PA3, PA2); // Serial for Max M10S, only used during configuration
+SFE_UBLOX_GNSS_SERIAL GNSS;
+
+GnssFix gnssFix;
+
+static UART_HandleTypeDef gnssUart;
+static DMA_HandleTypeDef gnssDma;
+static uint8_t dmaBuffer[GNSS_DMA_SIZE];
+static uint16_t readIndex = 0; // next byte of dmaBuffer to parse
+
+// ---- UBX parser ----- //
+
+#define UBX_SYNC1 0xB5
+#define UBX_SYNC2 0x62
+#define UBX_CLASS_NAV 0x01
+#define UBX_ID_NAV_PVT 0x07
+#define UBX_NAV_PVT_LENGTH 92
+
+enum UbxState : uint8_t { SYNC1, SYNC2, CLASS, ID, LENGTH1, LENGTH2, PAYLOAD, CHECKSUM_A, CHECKSUM_B };
+
+static UbxState ubxState = SYNC1;
+static uint8_t ubxClass, ubxId, ckA, ckB;
+static uint16_t ubxLength, ubxIndex;
+static uint8_t ubxPayload[UBX_NAV_PVT_LENGTH]; // only NAV-PVT is kept, everything else is just checksummed
+
+static void checksum(uint8_t byte) {
+  ckA += byte;
+  ckB += ckA;
+}
+
+static uint32_t u32(const uint8_t *p) { return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t u16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static uint32_t unixTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second) {
+  // days since 1970-01-01 of a proleptic Gregorian date
+  int32_t y = year - (month <= 2);
+  int32_t era = y / 400;
+  uint32_t yoe = y - era * 400;
+  uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  int32_t days = era * 146097 + (int32_t)doe - 719468;
+  return days * 86400UL + hour * 3600UL + minute * 60UL + second;
+}
+
+static void decodeNavPvt(const uint8_t *p) {
+  gnssFix.iTOW = u32(p + 0);
+  gnssFix.unixEpoch = unixTime(u16(p + 4), p[6], p[7], p[8], p[9], p[10]);
+  gnssFix.fixType = p[20];
+  gnssFix.numSV = p[23];
+  gnssFix.lon = u32(p + 24);
+  gnssFix.lat = u32(p + 28);
+  gnssFix.altMSL = u32(p + 36);
+  gnssFix.velN = u32(p + 48);
+  gnssFix.velE = u32(p + 52);
+  gnssFix.velD = u32(p + 56);
+  gnssFix.received = millis();
+}
+
+static bool parseByte(uint8_t byte) { // returns true when a complete NAV-PVT passed the checksum
+  switch (ubxState) {
+    case SYNC1:
+      if (byte == UBX_SYNC1) ubxState = SYNC2;
+      break;
+    case SYNC2:
+      ubxState = byte == UBX_SYNC2 ? CLASS : (byte == UBX_SYNC1 ? SYNC2 : SYNC1);
+      break;
+    case CLASS:
+      ubxClass = byte;
+      ckA = ckB = 0;
+      checksum(byte);
+      ubxState = ID;
+      break;
+    case ID:
+      ubxId = byte;
+      checksum(byte);
+      ubxState = LENGTH1;
+      break;
+    case LENGTH1:
+      ubxLength = byte;
+      checksum(byte);
+      ubxState = LENGTH2;
+      break;
+    case LENGTH2:
+      ubxLength |= byte << 8;
+      checksum(byte);
+      ubxIndex = 0;
+      ubxState = ubxLength > 0 ? PAYLOAD : CHECKSUM_A;
+      break;
+    case PAYLOAD:
+      if (ubxIndex < sizeof(ubxPayload)) {
+        ubxPayload[ubxIndex] = byte;
+      }
+      checksum(byte);
+      if (++ubxIndex >= ubxLength) ubxState = CHECKSUM_A;
+      break;
+    case CHECKSUM_A:
+      ubxState = byte == ckA ? CHECKSUM_B : SYNC1;
+      break;
+    case CHECKSUM_B:
+      ubxState = SYNC1;
+      if (byte == ckB && ubxClass == UBX_CLASS_NAV && ubxId == UBX_ID_NAV_PVT && ubxLength == UBX_NAV_PVT_LENGTH) {
+        decodeNavPvt(ubxPayload);
+        return true;
+      }
+      break;
+  }
+  return false;
+}
+
+bool pollGNSS() {
+  uint16_t writeIndex = GNSS_DMA_SIZE - __HAL_DMA_GET_COUNTER(&gnssDma); // where the DMA will write next
+  if (writeIndex == GNSS_DMA_SIZE) {
+    writeIndex = 0;
+  }
+
+  bool newFix = false;
+  while (readIndex != writeIndex) {
+    newFix |= parseByte(dmaBuffer[readIndex]);
+    readIndex = (readIndex + 1) % GNSS_DMA_SIZE;
+  }
+
+  __HAL_UART_CLEAR_OREFLAG(&gnssUart); // an overrun would stop the UART from requesting DMA transfers
+  return newFix;
+}
+
+// ---- setup ----- //
+
+static bool startDmaReception() {
+  // PA2/PA3 are muxed by hand, the first PinMap entry for them is LPUART1 (AF8), which SerialGNSS used
+  GPIO_InitTypeDef pins = {};
+  pins.Pin = GPIO_PIN_2 | GPIO_PIN_3;
+  pins.Mode = GPIO_MODE_AF_PP;
+  pins.Pull = GPIO_PULLUP;
+  pins.Speed = GPIO_SPEED_FREQ_HIGH;
+  pins.Alternate = GPIO_AF7_USART2;
+  __HAL_RCC_GPIOA_CLK_ENABLE();
+  HAL_GPIO_Init(GPIOA, &pins);
+  __HAL_RCC_USART2_CLK_ENABLE();
+  __HAL_RCC_DMAMUX1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  gnssUart.Instance = USART2;
+  gnssUart.Init.BaudRate = GNSS_BAUD;
+  gnssUart.Init.WordLength = UART_WORDLENGTH_8B;
+  gnssUart.Init.StopBits = UART_STOPBITS_1;
+  gnssUart.Init.Parity = UART_PARITY_NONE;
+  gnssUart.Init.Mode = UART_MODE_TX_RX;
+  gnssUart.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+  gnssUart.Init.OverSampling = UART_OVERSAMPLING_16;
+  gnssUart.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+  gnssUart.Init.ClockPrescaler = UART_PRESCALER_DIV1;
+  gnssUart.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
+  if (HAL_UART_Init(&gnssUart) != HAL_OK) {
+    return false;
+  }
+
+  gnssDma.Instance = DMA1_Channel1;
+  gnssDma.Init.Request = DMA_REQUEST_USART2_RX;
+  gnssDma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+  gnssDma.Init.PeriphInc = DMA_PINC_DISABLE;
+  gnssDma.Init.MemInc = DMA_MINC_ENABLE;
+  gnssDma.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  gnssDma.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  gnssDma.Init.Mode = DMA_CIRCULAR;
+  gnssDma.Init.Priority = DMA_PRIORITY_HIGH;
+  if (HAL_DMA_Init(&gnssDma) != HAL_OK) {
+    return false;
+  }
+
+  // started without the HAL UART callbacks, the Arduino core owns those for its own serial ports
+  if (HAL_DMA_Start(&gnssDma, (uintptr_t)&USART2->RDR, (uintptr_t)dmaBuffer, GNSS_DMA_SIZE) != HAL_OK) {
+    return false;
+  }
+  SET_BIT(USART2->CR3, USART_CR3_DMAR);
+  readIndex = 0;
+  return true;
+}
+
+bool SetupGNSS() {
+  // Setting up the Max M10S GNSS module
+  DEBUG_PRINTLN("Attempting to start GNSS...");
+  SerialGNSS.begin(9600);
+
+  if (GNSS.begin(SerialGNSS))
+  {
+    DEBUG_PRINTLN("GNSS started successfully!");
+  }
+  else
+  {
+    DEBUG_PRINTLN("GNSS failed to start.");
+    return false;
+  }
+
+  GNSS.setVal32(UBLOX_CFG_UART1_BAUDRATE, GNSS_BAUD, VAL_LAYER_RAM_BBR);
+  GNSS.saveConfiguration();
+  GNSS.end();
+
+  SerialGNSS.flush();
+  SerialGNSS.end();
+  SerialGNSS.begin(GNSS_BAUD);
+
+  if (GNSS.begin(SerialGNSS))
+  {
+    DEBUG_PRINTLN("GNSS started with higher baud rate successfully!");
+  }
+  else
+  {
+    DEBUG_PRINTLN("GNSS failed to start with higher baud rate.");
+    return false;
+  }
+
+  GNSS.setUART1Output(COM_TYPE_UBX);
+  GNSS.setNavigationFrequency(NAV_RATE);
+  GNSS.setAutoPVT(true);
+  GNSS.setDynamicModel(DYN_MODEL_AIRBORNE1g);
+  GNSS.setLNAMode(SFE_UBLOX_LNA_MODE_BYPASS);
+  GNSS.saveConfiguration();
+
+  // configuration done, release LPUART1 and its pins, then hand the GNSS over to USART2 and DMA
+  GNSS.end();
+  SerialGNSS.flush();
+  SerialGNSS.end();
+  if (!startDmaReception()) {
+    DEBUG_PRINTLN("GNSS DMA reception failed to start.");
+    return false;
+  }
+  DEBUG_PRINTLN("GNSS receiving over DMA");
+  return true;
+}
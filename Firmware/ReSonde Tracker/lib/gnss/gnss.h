@@ -0,0 +1,21 @@
+#pragma once
+#include <Arduino.h>
+
+struct GnssFix { // contents of the last UBX-NAV-PVT message
+  uint32_t iTOW;      // GPS time of week of the navigation epoch in ms
+  uint32_t unixEpoch; // s
+  int32_t lat;        // e-7 degrees
+  int32_t lon;        // e-7 degrees
+  int32_t altMSL;     // mm
+  int32_t velN;       // mm/s
+  int32_t velE;       // mm/s
+  int32_t velD;       // mm/s
+  uint8_t numSV;      // satellites used in the solution
+  uint8_t fixType;
+  uint32_t received;  // millis() when the message was parsed
+};
+
+extern GnssFix gnssFix;
+
+bool SetupGNSS(); // configures the MAX-M10S and starts DMA reception, false if the module does not answer
+bool pollGNSS();  // parses what the DMA received since the last call, true when a new NAV-PVT arrived
@@ -0,0 +1,40 @@
+#include "phase.h"
+
+#define DESCENT_SPEED 5000    // mm/s, falling faster than this counts towards the burst
+#define BURST_DROP 200000     // mm below the highest altitude, keeps gusts during the ascent from counting
+#define LANDED_SPEED 1000     // mm/s, slower than this in either direction counts towards the landing
+#define DESCENT_CONFIRM 5     // epochs in a row before the descent is taken as real
+#define LANDED_CONFIRM 30     // epochs in a row, a slow patch under the parachute should not end the descent
+
+static FlightPhase phase = PHASE_ASCENT;
+static int32_t maxAlt = INT32_MIN;
+static uint8_t confirmed = 0; // epochs in a row that agree with the next phase
+
+FlightPhase updatePhase(const FilteredState &state) {
+  if (state.alt > maxAlt) {
+    maxAlt = state.alt;
+  }
+
+  bool next = false;
+  switch (phase) {
+    case PHASE_ASCENT:
+      next = state.velD > DESCENT_SPEED && state.alt < maxAlt - BURST_DROP;
+      break;
+    case PHASE_DESCENT:
+      next = state.velD < LANDED_SPEED && state.velD > -LANDED_SPEED;
+      break;
+    default:
+      return phase;
+  }
+
+  confirmed = next ? confirmed + 1 : 0;
+  if (confirmed >= (phase == PHASE_ASCENT ? DESCENT_CONFIRM : LANDED_CONFIRM)) {
+    phase = phase == PHASE_ASCENT ? PHASE_DESCENT : PHASE_LANDED;
+    confirmed = 0;
+  }
+  return phase;
+}
+
+FlightPhase flightPhase() {
+  return phase;
+}
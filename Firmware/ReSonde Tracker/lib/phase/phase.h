@@ -0,0 +1,11 @@
+#pragma once
+#include <Arduino.h>
+#include "frame.h"
+#include "filter.h"
+
+// Flight phase from the trend of the filtered altitude and vertical speed. Burst is a sustained fall well
+// below the highest altitude seen, landing a vertical speed near zero for a while after that. A phase is
+// never left again, a sonde that fell back to the ground does not take off a second time.
+
+FlightPhase updatePhase(const FilteredState &state); // call for each filtered epoch
+FlightPhase flightPhase();
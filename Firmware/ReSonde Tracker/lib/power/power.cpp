@@ -0,0 +1,166 @@
+#include "power.h"
+#include "debug.h"
+#include "settings.h"
+#include <STM32LowPower.h>
+#include <STM32RTC.h>
+
+// Event driven idle handling. The loop only ever waits for three things: the next NAV-PVT from the
+// GNSS, the radio's DIO1 interrupt and (if wired) the GNSS timepulse. While a NAV-PVT can arrive the
+// MCU only does WFI so the GNSS DMA keeps running. Otherwise it goes to Stop2 until shortly before the
+// next message is due, the radio IRQ is a Stop2 wake up source so a finished transmission still wakes it.
+
+#define GNSS_WAKE_GUARD 50          // ms, leave Stop2 this long before the next NAV-PVT is due
+#define STOP2_MIN_TIME 10           // ms, shorter idle periods are not worth the clock restart
+#define POWER_REPORT_INTERVAL 60000 // ms between debug reports
+#define WAKEUP_SLOTS 4              // pending wake up requests, one per user (TDMA slot, NACK window, sensors) is enough
+
+PowerStats powerStats;
+
+static STM32RTC &rtc = STM32RTC::getInstance();
+static uint32_t lastGnssMessage = 0; // millis()
+static uint32_t wakeupAt[WAKEUP_SLOTS];
+static bool wakeupPending[WAKEUP_SLOTS];
+static uint32_t runStarted = 0;
+static uint32_t lastReport = 0;
+#ifdef GNSS_TIMEPULSE_PIN
+static volatile bool timepulse = false;
+static volatile uint32_t timepulseMillis = 0;
+static bool haveTimepulse = false;
+
+static void timepulseWakeup() {
+  timepulse = true;
+  timepulseMillis = millis(); // corrected in stop2() if the pulse ended a Stop2 period
+}
+
+#endif
+
+bool lastTimepulse(uint32_t &at) {
+#ifdef GNSS_TIMEPULSE_PIN
+  at = timepulseMillis;
+  return haveTimepulse;
+#else
+  return false;
+#endif
+}
+
+static uint32_t rtcMillis() { // keeps counting in Stop2, unlike SysTick
+  uint32_t subSeconds;
+  uint32_t seconds = rtc.getEpoch(&subSeconds);
+  return seconds * 1000 + subSeconds;
+}
+
+void SetupPower() {
+  LowPower.begin(); // also starts the RTC
+#ifdef GNSS_TIMEPULSE_PIN
+  pinMode(GNSS_TIMEPULSE_PIN, INPUT);
+  LowPower.attachInterruptWakeup(GNSS_TIMEPULSE_PIN, timepulseWakeup, RISING, DEEP_SLEEP_MODE);
+#endif
+  resetPowerStats();
+}
+
+void noteGnssMessage() {
+  lastGnssMessage = millis();
+}
+
+uint32_t nextGnssMessage() {
+  return lastGnssMessage + NAV_PERIOD;
+}
+
+void requestWakeup(uint32_t at) {
+  // every request is kept until it was reached, a later one must not get lost behind an earlier one
+  int8_t latest = -1;
+  for (uint8_t i = 0; i < WAKEUP_SLOTS; i++) {
+    if (!wakeupPending[i] || wakeupAt[i] == at) {
+      wakeupAt[i] = at;
+      wakeupPending[i] = true;
+      return;
+    }
+    if (latest < 0 || (int32_t)(wakeupAt[i] - wakeupAt[latest]) > 0) {
+      latest = i;
+    }
+  }
+  if ((int32_t)(at - wakeupAt[latest]) < 0) {
+    wakeupAt[latest] = at; // all taken, give up the one furthest away
+    DEBUG_PRINTLN("Wake up requests full, dropped the latest");
+  }
+}
+
+void resetPowerStats() {
+  memset(&powerStats, 0, sizeof(powerStats));
+  runStarted = millis();
+}
+
+void printPowerStats() {
+  uint32_t total = powerStats.ms[POWER_RUN] + powerStats.ms[POWER_SLEEP] + powerStats.ms[POWER_STOP2];
+  if (total == 0) {
+    return;
+  }
+  DEBUG_PRINT("Duty cycle run/sleep/stop2 in 0.1%: ");
+  DEBUG_PRINT((uint32_t)(powerStats.ms[POWER_RUN] * 1000ULL / total)); DEBUG_PRINT("/");
+  DEBUG_PRINT((uint32_t)(powerStats.ms[POWER_SLEEP] * 1000ULL / total)); DEBUG_PRINT("/");
+  DEBUG_PRINT((uint32_t)(powerStats.ms[POWER_STOP2] * 1000ULL / total));
+  DEBUG_PRINT(", wakeups: "); DEBUG_PRINTLN(powerStats.wakeups);
+}
+
+static void stop2(uint32_t duration) {
+#ifdef DEBUG
+  SerialDebug.flush(); // the UART clock stops in Stop2
+#endif
+  uint32_t before = rtcMillis();
+  LowPower.deepSleep(duration); // Stop2, the RTC alarm ends it at the latest
+  uint32_t slept = rtcMillis() - before;
+
+  uwTick += slept; // SysTick was stopped, keep millis() in step with real time
+#ifdef GNSS_TIMEPULSE_PIN
+  if (timepulse) {
+    timepulseMillis = millis(); // the pulse woke us, its ISR still saw the uncorrected tick
+  }
+#endif
+  powerStats.ms[POWER_STOP2] += slept;
+}
+
+void idleUntilNextEvent(bool peripheralsBusy) {
+  uint32_t now = millis();
+  powerStats.ms[POWER_RUN] += now - runStarted;
+  powerStats.wakeups++;
+
+  if (now - lastReport >= POWER_REPORT_INTERVAL) {
+    lastReport = now;
+    printPowerStats();
+  }
+
+  uint32_t nextGnssMessage = lastGnssMessage + NAV_PERIOD;
+  int32_t untilWake = (int32_t)(nextGnssMessage - GNSS_WAKE_GUARD - now);
+
+#ifdef GNSS_TIMEPULSE_PIN
+  if (timepulse) { // the epoch just started, its NAV-PVT follows within a few ms
+    timepulse = false;
+    haveTimepulse = true;
+    untilWake = 0;
+  } else if ((int32_t)(now - nextGnssMessage) > NAV_PERIOD / 2) {
+    untilWake = NAV_PERIOD; // message overdue by more than half a period, wait for the timepulse instead
+  }
+#endif
+
+  for (uint8_t i = 0; i < WAKEUP_SLOTS; i++) {
+    if (!wakeupPending[i]) {
+      continue;
+    }
+    int32_t untilRequest = (int32_t)(wakeupAt[i] - now);
+    if (untilRequest <= 0) {
+      wakeupPending[i] = false; // reached, the caller handles it after this wake up, the others stay armed
+      untilWake = 0;
+    } else if (untilRequest < untilWake) {
+      untilWake = untilRequest;
+    }
+  }
+
+  if (untilWake >= STOP2_MIN_TIME && !peripheralsBusy) {
+    stop2(untilWake);
+  } else {
+    __WFI(); // GNSS data may arrive any moment, only halt the core. SysTick wakes us at the latest after 1 ms
+    powerStats.ms[POWER_SLEEP] += millis() - now;
+  }
+
+  runStarted = millis();
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+
+enum PowerState : uint8_t {
+  POWER_RUN,   // CPU busy
+  POWER_SLEEP, // WFI, DMA keeps receiving GNSS data, woken by any interrupt
+  POWER_STOP2, // Stop2, woken by the RTC alarm, the radio IRQ (DIO1) or the GNSS timepulse
+  POWER_STATES
+};
+
+struct PowerStats { // time spent per state since the last resetPowerStats(), for average current per flight phase
+  uint32_t ms[POWER_STATES];
+  uint32_t wakeups;
+};
+
+extern PowerStats powerStats;
+
+void SetupPower();
+void noteGnssMessage();        // call when a NAV-PVT arrived, the next one is expected one nav period later
+uint32_t nextGnssMessage();    // millis() when the next NAV-PVT is expected
+void requestWakeup(uint32_t at); // make sure the next idle period ends by millis() == at
+bool lastTimepulse(uint32_t &at); // millis() of the last GNSS timepulse, false if none was seen or it is not wired
+void idleUntilNextEvent(bool peripheralsBusy); // call at the end of loop(), returns after the next wake up. Busy peripherals keep the clocks running
+void resetPowerStats();
+void printPowerStats();
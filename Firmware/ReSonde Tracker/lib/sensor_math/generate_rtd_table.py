@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Generate the RTD lookup table used by rtdTableTemperature() from the Adafruit_MAX31865 conversion.
+
+The table interpolates the exact formulas. The driver computes in single precision, so for a few codes its
+rounded result is one unit off the interpolation; those codes are listed as fixups, which makes the table
+return packetTempRaw(calculateTemperature()) for every code in it.
+
+Run after changing RREF, RNOMINAL, the step or the range:
+    python3 generate_rtd_table.py
+"""
+import math
+import os
+import struct
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+OUTPUT = os.path.join(HERE, 'rtd_table.h')
+
+RREF = 4020.0      # keep in sync with sensor_math.h
+RNOMINAL = 1000.0
+RTD_A = 3.9083e-3  # Callendar-Van Dusen coefficients of the Adafruit driver
+RTD_B = -5.775e-7
+
+TEMP_SCALE = 320   # PACKET_TEMP_SCALE
+FRACTION_BITS = 12 # table entries are packet units << FRACTION_BITS
+STEP_BITS = 4      # 16 ADC codes between entries, interpolation error stays below 1/100 of a packet unit
+FIRST_CODE = 4896  # -100 C
+LAST_CODE = 10672  # +80 C, codes outside the table use the float conversion
+
+
+def resistance(code):
+    return code / 32768 * RREF
+
+
+def callendar_van_dusen(code):
+    """The driver's solution for temperatures >= 0 C."""
+    z2 = RTD_A * RTD_A - 4 * RTD_B
+    z3 = 4 * RTD_B / RNOMINAL
+    return (math.sqrt(z2 + z3 * resistance(code)) - RTD_A) / (2 * RTD_B)
+
+
+def polynomial(code):
+    """The driver's fit for temperatures below 0 C."""
+    r = resistance(code) / RNOMINAL * 100
+    return -242.02 + 2.2228 * r + 2.5859e-3 * r ** 2 - 4.8260e-6 * r ** 3 - 2.8183e-8 * r ** 4 + 1.5243e-10 * r ** 5
+
+
+def f32(value):
+    return struct.unpack('<f', struct.pack('<f', value))[0]
+
+
+def driver(code):
+    """Adafruit_MAX31865::calculateTemperature() step by step, float where the driver uses float."""
+    rt = f32(f32(f32(code) / 32768) * f32(RREF))
+    z1 = f32(-RTD_A)
+    z2 = f32(RTD_A * RTD_A - 4 * RTD_B)
+    z3 = f32(4 * RTD_B / f32(RNOMINAL))
+    z4 = f32(2 * RTD_B)
+    temp = f32(z2 + f32(z3 * rt))
+    temp = f32(f32(f32(math.sqrt(temp)) + z1) / z4)  # sqrt(float) is correctly rounded
+    if temp >= 0:
+        return temp
+
+    rt = f32(f32(rt / f32(RNOMINAL)) * 100)
+    rpoly = rt
+    temp = f32(-242.02)
+    for coefficient in (2.2228, 2.5859e-3, -4.8260e-6, -2.8183e-8, 1.5243e-10):  # double literals, float sums
+        temp = f32(temp + coefficient * rpoly)
+        rpoly = f32(rpoly * rt)
+    return temp
+
+
+def packet_temp_raw(celsius):
+    value = f32(celsius * TEMP_SCALE)
+    return int(value - 0.5) if value < 0 else int(value + 0.5)
+
+
+def entry(celsius):
+    return round(celsius * TEMP_SCALE * (1 << FRACTION_BITS))
+
+
+def render():
+    step = 1 << STEP_BITS
+    assert FIRST_CODE % step == 0 and LAST_CODE % step == 0
+    zero_code = next(c for c in range(FIRST_CODE, LAST_CODE) if callendar_van_dusen(c + 1) >= 0)  # last code below 0 C
+    straddle = zero_code - zero_code % step  # the two formulas do not meet at 0 C, this interval needs both
+
+    codes = range(FIRST_CODE, LAST_CODE + 1, step)
+    values = [entry(polynomial(c) if c <= zero_code else callendar_van_dusen(c)) for c in codes]
+    rows = [', '.join(str(v) for v in values[i:i + 8]) for i in range(0, len(values), 8)]
+    straddle_below = entry(callendar_van_dusen(straddle))
+    straddle_above = entry(polynomial(straddle + step))
+
+    fixups = []
+    for code in range(FIRST_CODE, LAST_CODE):  # the same integer steps as rtdTableTemperature()
+        index, fraction = (code - FIRST_CODE) >> STEP_BITS, (code - FIRST_CODE) & (step - 1)
+        low, high = values[index], values[index + 1]
+        if code - fraction == straddle:
+            if code <= zero_code:
+                high = straddle_above
+            else:
+                low = straddle_below
+        table = (low + (((high - low) * fraction) >> STEP_BITS) + (1 << (FRACTION_BITS - 1))) >> FRACTION_BITS
+        delta = packet_temp_raw(driver(code)) - table
+        assert abs(delta) <= 1, f'code {code} is {delta} units off, the table is too coarse'
+        if delta:
+            fixups.append(code << 1 | (delta > 0))
+    fixup_rows = [', '.join(str(v) for v in fixups[i:i + 12]) for i in range(0, len(fixups), 12)]
+
+    lines = [
+        '#pragma once',
+        '#include <stdint.h>',
+        '',
+        '// RTD code to temperature, generated by generate_rtd_table.py from the Adafruit_MAX31865 conversion, do not edit.',
+        f'// RREF {RREF:g}, RNOMINAL {RNOMINAL:g}. Entries are packet temperature units << RTD_FRACTION_BITS.',
+        '',
+        f'#define RTD_FRACTION_BITS {FRACTION_BITS}',
+        f'#define RTD_STEP_BITS {STEP_BITS}',
+        f'#define RTD_FIRST_CODE {FIRST_CODE}',
+        f'#define RTD_LAST_CODE {LAST_CODE}',
+        f'#define RTD_ZERO_CODE {zero_code} // last code below 0 C, where the driver switches formulas',
+        f'#define RTD_STRADDLE_CODE {straddle} // start of the interval holding RTD_ZERO_CODE',
+        f'#define RTD_STRADDLE_BELOW {straddle_below} // CVD at its start',
+        f'#define RTD_STRADDLE_ABOVE {straddle_above} // polynomial at its end',
+        '',
+        f'static const int32_t rtdTable[{len(values)}] = {{',
+        *[f'  {row},' for row in rows],
+        '};',
+        '',
+        '// codes where the driver\'s float result rounds one unit off the interpolation, sorted,',
+        '// code << 1 | 1 if the driver is one unit above',
+        f'static const uint16_t rtdFixups[{len(fixups)}] = {{',
+        *[f'  {row},' for row in fixup_rows],
+        '};',
+        '',
+    ]
+    return '\n'.join(lines)
+
+
+if __name__ == '__main__':
+    with open(OUTPUT, 'w') as f:
+        f.write(render())
+    print(f'wrote {OUTPUT}')
@@ -0,0 +1,81 @@
+#pragma once
+#include <stdint.h>
+
+// RTD code to temperature, generated by generate_rtd_table.py from the Adafruit_MAX31865 conversion, do not edit.
+// RREF 4020, RNOMINAL 1000. Entries are packet temperature units << RTD_FRACTION_BITS.
+
+#define RTD_FRACTION_BITS 12
+#define RTD_STEP_BITS 4
+#define RTD_FIRST_CODE 4896
+#define RTD_LAST_CODE 10672
+#define RTD_ZERO_CODE 8151 // last code below 0 C, where the driver switches formulas
+#define RTD_STRADDLE_CODE 8144 // start of the interval holding RTD_ZERO_CODE
+#define RTD_STRADDLE_BELOW -298022 // CVD at its start
+#define RTD_STRADDLE_ABOVE 358967 // polynomial at its end
+
+static const int32_t rtdTable[362] = {
+  -131691863, -131057158, -130422308, -129787314, -129152176, -128516894, -127881469, -127245901,
+  -126610190, -125974337, -125338343, -124702207, -124065929, -123429511, -122792952, -122156254,
+  -121519415, -120882438, -120245321, -119608065, -118970671, -118333139, -117695470, -117057663,
+  -116419719, -115781638, -115143421, -114505068, -113866580, -113227956, -112589197, -111950304,
+  -111311277, -110672115, -110032820, -109393391, -108753830, -108114136, -107474310, -106834351,
+  -106194261, -105554040, -104913688, -104273205, -103632592, -102991849, -102350976, -101709973,
+  -101068842, -100427581, -99786193, -99144676, -98503031, -97861259, -97219360, -96577334,
+  -95935181, -95292902, -94650497, -94007966, -93365310, -92722529, -92079623, -91436592,
+  -90793438, -90150159, -89506757, -88863232, -88219584, -87575813, -86931920, -86287904,
+  -85643767, -84999508, -84355128, -83710627, -83066005, -82421263, -81776400, -81131418,
+  -80486316, -79841095, -79195755, -78550296, -77904719, -77259023, -76613210, -75967279,
+  -75321230, -74675064, -74028782, -73382382, -72735867, -72089235, -71442487, -70795624,
+  -70148646, -69501552, -68854343, -68207020, -67559583, -66912031, -66264366, -65616587,
+  -64968695, -64320689, -63672571, -63024340, -62375996, -61727541, -61078973, -60430294,
+  -59781503, -59132601, -58483588, -57834464, -57185229, -56535884, -55886429, -55236864,
+  -54587190, -53937406, -53287512, -52637510, -51987398, -51337178, -50686850, -50036413,
+  -49385868, -48735216, -48084455, -47433588, -46782613, -46131531, -45480342, -44829046,
+  -44177644, -43526136, -42874521, -42222801, -41570975, -40919043, -40267006, -39614864,
+  -38962616, -38310264, -37657807, -37005246, -36352580, -35699810, -35046936, -34393958,
+  -33740877, -33087692, -32434403, -31781012, -31127517, -30473919, -29820219, -29166415,
+  -28512510, -27858502, -27204392, -26550179, -25895865, -25241449, -24586931, -23932312,
+  -23277591, -22622770, -21967847, -21312822, -20657697, -20002472, -19347145, -18691718,
+  -18036191, -17380563, -16724835, -16069007, -15413079, -14757050, -14100923, -13444695,
+  -12788368, -12131941, -11475415, -10818789, -10162065, -9505241, -8848318, -8191296,
+  -7534175, -6876955, -6219636, -5562219, -4904703, -4247089, -3589376, -2931565,
+  -2273655, -1615647, -957541, -299336, 360274, 1018667, 1677159, 2335748,
+  2994435, 3653220, 4312103, 4971084, 5630163, 6289340, 6948615, 7607989,
+  8267460, 8927030, 9586698, 10246465, 10906330, 11566293, 12226355, 12886515,
+  13546774, 14207131, 14867587, 15528142, 16188796, 16849548, 17510399, 18171349,
+  18832398, 19493546, 20154793, 20816139, 21477584, 22139128, 22800772, 23462514,
+  24124356, 24786297, 25448338, 26110478, 26772717, 27435056, 28097495, 28760033,
+  29422670, 30085408, 30748245, 31411182, 32074218, 32737355, 33400591, 34063928,
+  34727364, 35390900, 36054537, 36718273, 37382110, 38046047, 38710084, 39374222,
+  40038460, 40702798, 41367237, 42031776, 42696416, 43361156, 44025997, 44690939,
+  45355981, 46021124, 46686368, 47351713, 48017159, 48682706, 49348353, 50014102,
+  50679952, 51345903, 52011955, 52678108, 53344363, 54010719, 54677176, 55343735,
+  56010395, 56677157, 57344020, 58010985, 58678051, 59345219, 60012489, 60679861,
+  61347334, 62014910, 62682587, 63350366, 64018248, 64686231, 65354316, 66022504,
+  66690794, 67359186, 68027680, 68696277, 69364976, 70033777, 70702681, 71371688,
+  72040797, 72710009, 73379323, 74048740, 74718260, 75387883, 76057608, 76727437,
+  77397368, 78067403, 78737540, 79407781, 80078125, 80748572, 81419122, 82089775,
+  82760532, 83431392, 84102356, 84773423, 85444594, 86115868, 86787246, 87458727,
+  88130312, 88802001, 89473794, 90145691, 90817692, 91489796, 92162005, 92834317,
+  93506734, 94179255, 94851880, 95524609, 96197443, 96870381, 97543423, 98216570,
+  98889822, 99563178, 100236638, 100910203, 101583873, 102257648, 102931527, 103605511,
+  104279600, 104953794,
+};
+
+// codes where the driver's float result rounds one unit off the interpolation, sorted,
+// code << 1 | 1 if the driver is one unit above
+static const uint16_t rtdFixups[153] = {
+  9954, 10162, 11398, 11436, 11874, 11918, 12270, 12854, 14364, 14546, 15756, 15850,
+  16344, 16346, 16348, 16386, 16388, 16426, 16428, 16466, 16468, 16610, 16642, 16644,
+  16676, 16708, 16738, 16768, 16798, 16828, 16856, 16884, 16966, 16992, 17068, 17092,
+  17164, 17188, 17256, 17278, 17300, 17322, 17448, 17488, 17508, 17566, 17604, 17642,
+  17678, 17750, 17768, 17820, 17854, 17872, 17888, 17922, 17954, 18050, 18066, 18082,
+  18128, 18158, 18174, 18188, 18248, 18262, 18320, 18334, 18348, 18362, 18376, 18390,
+  18404, 18418, 18432, 18500, 18540, 18606, 18670, 18708, 18746, 18758, 18820, 18844,
+  18856, 18868, 18880, 18904, 18916, 18986, 19032, 19190, 19222, 19244, 19298, 19330,
+  19340, 19372, 19414, 19434, 19506, 19516, 19526, 19536, 19546, 19556, 19566, 19576,
+  19586, 19596, 19616, 19684, 19694, 19742, 19780, 19790, 19846, 19874, 19920, 19948,
+  19966, 19984, 20002, 20020, 20038, 20056, 20074, 20214, 20248, 20282, 20316, 20358,
+  20400, 20482, 20490, 20498, 20658, 20666, 20674, 20744, 20798, 20836, 20844, 20874,
+  20904, 20934, 20986, 21038, 21060, 21096, 21132, 21168, 21232,
+};
@@ -0,0 +1,116 @@
+#include "sensor_math.h"
+#include "packet.h"
+#include "rtd_table.h"
+
+// ---- temperature ----- //
+
+int8_t rtdFixup(uint16_t rtd)
+{ // binary search of the generated fixups, 0 for most codes
+  uint16_t low = 0, high = sizeof(rtdFixups) / sizeof(rtdFixups[0]);
+  while (low < high)
+  {
+    uint16_t middle = (low + high) / 2;
+    uint16_t code = rtdFixups[middle] >> 1;
+    if (code == rtd)
+      return ((rtdFixups[middle] & 1) ? 1 : -1);
+    if (code < rtd)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return (0);
+}
+
+bool rtdTableTemperature(uint16_t rtd, int16_t &temperature)
+{ // interpolated from the generated table, the fixups make it the driver's float result for every code
+  if (rtd < RTD_FIRST_CODE || rtd >= RTD_LAST_CODE)
+    return (false);
+
+  uint16_t index = (rtd - RTD_FIRST_CODE) >> RTD_STEP_BITS;
+  int32_t fraction = (rtd - RTD_FIRST_CODE) & ((1 << RTD_STEP_BITS) - 1);
+  int32_t low = rtdTable[index], high = rtdTable[index + 1];
+  if (rtd - fraction == RTD_STRADDLE_CODE)
+  { // the driver's two formulas do not meet at 0 C, stay on the one this code uses
+    if (rtd <= RTD_ZERO_CODE)
+      high = RTD_STRADDLE_ABOVE;
+    else
+      low = RTD_STRADDLE_BELOW;
+  }
+  int32_t value = low + (((high - low) * fraction) >> RTD_STEP_BITS);
+  temperature = (int16_t)(((value + (1 << (RTD_FRACTION_BITS - 1))) >> RTD_FRACTION_BITS) + rtdFixup(rtd)); // arithmetic shift rounds like packetRound
+  return (true);
+}
+
+// ---- humidity ----- //
+// The constants are whole numbers of 0.1 fF, so the humidity is one exact fraction of the frequencies, the
+// temperature and the previous value, rounded once to the unit asked for. The float code rounded every step:
+// its packet value is the same except when the humidity is within 1e-5 %RH of the point between two packet
+// values, where it can come out one unit (0.5 %RH) off the correctly rounded one.
+
+constexpr int64_t tenthFemtofarads(double farads) { return (int64_t)(farads * 1e16 + 0.5); }
+
+constexpr int64_t C_ref = tenthFemtofarads(107e-12);  // capacity of reference capacitor including stray capacitance
+const uint32_t R = 220e3;                              // resistance of resistor in oscillator in ohms
+constexpr int64_t stray_c = tenthFemtofarads(10e-12); // stray capacitance
+
+constexpr int64_t C0 = tenthFemtofarads(120e-12);                 // nominal sensor capacitance
+constexpr int64_t C0_HC0 = tenthFemtofarads(120e-12 * 3420e-6);   // C0 times the nominal humidity coefficient of 3420e-6 per %RH
+constexpr int64_t TEMP_COEFFICIENT = tenthFemtofarads(0.0014e-12); // capacitance drift per %RH and degree from 30 C
+constexpr int64_t COMPENSATION_SCALE = 1000L * PACKET_TEMP_SCALE;  // previous is in 0.001 %RH, the temperature in packet units
+
+static_assert(C_ref == 1070000 && stray_c == 100000 && C0 == 1200000 && C0_HC0 == 4104 && TEMP_COEFFICIENT == 14,
+              "the capacitances must be exact in 0.1 fF");
+
+//float K = 0.0f;       // calibration constant determined through calibration with reference C - Not used anymore!!!
+
+int64_t divideFloor(int64_t dividend, int64_t divisor)
+{ // divisor > 0
+  int64_t quotient = dividend / divisor;
+  return (dividend % divisor < 0 ? quotient - 1 : quotient);
+}
+
+int64_t humidityFloor(uint32_t f_cal, uint32_t f_RH, int16_t temperature, int32_t previous, int64_t scale, bool &exact)
+{ // floor(scale * RH), exact is set if nothing was cut off. scale up to 2000, no input overflows then
+  // RH = (C_ref * f_cal / f_RH - stray_c - C0 + TEMP_COEFFICIENT * previous * (temperature - 30 C) / COMPENSATION_SCALE) / C0_HC0
+  int64_t sensor = C_ref * f_cal; // total capacity from the frequencies, times f_RH
+  int64_t sensorWhole = sensor / f_RH, sensorRest = sensor % f_RH;
+
+  int64_t drift = TEMP_COEFFICIENT * previous * (temperature - packetTempRaw(30)); // temperature compensation based on last humidity value, -dC
+  int64_t driftWhole = divideFloor(drift, COMPENSATION_SCALE), driftRest = drift - driftWhole * COMPENSATION_SCALE;
+
+  // the whole 0.1 fF and the two remainders, which add up to less than 2
+  int64_t whole = sensorWhole - stray_c - C0 + driftWhole;
+  int64_t rest = sensorRest * COMPENSATION_SCALE + driftRest * f_RH;
+  int64_t restDivisor = (int64_t)f_RH * COMPENSATION_SCALE;
+
+  int64_t scaled = whole * scale + rest * scale / restDivisor; // the fraction cut off here is below one, it can't change the floor below
+  exact = rest * scale % restDivisor == 0 && divideFloor(scaled, C0_HC0) * C0_HC0 == scaled;
+  return (divideFloor(scaled, C0_HC0));
+}
+
+int32_t humidityMilli(uint32_t f_cal, uint32_t f_RH, int16_t temperature, int32_t previous)
+{ // rounded half away from zero like packetRound, from floor(2000 * RH)
+  bool exact;
+  int64_t twice = humidityFloor(f_cal, f_RH, temperature, previous, 2000, exact);
+  if (twice >= 0)
+    return ((int32_t)divideFloor(twice + 1, 2));
+  return ((int32_t)-divideFloor(1 - twice - (exact ? 0 : 1), 2));
+}
+
+uint8_t formatHumidity(uint32_t f_cal, uint32_t f_RH, int16_t temperature, int32_t previous)
+{
+  bool exact;
+  int64_t quarters = humidityFloor(f_cal, f_RH, temperature, previous, 2 * PACKET_RH_SCALE, exact); // floor of 4 * RH
+  if (quarters < 0)
+  {
+    return (0);
+  }
+  else if (quarters > 2 * PACKET_RH_SCALE * 125 || (quarters == 2 * PACKET_RH_SCALE * 125 && !exact))
+  {
+    return (252);
+  }
+  else
+  {
+    return ((uint8_t)((quarters + 1) / 2)); // same rounding as packetRhRaw()
+  }
+}
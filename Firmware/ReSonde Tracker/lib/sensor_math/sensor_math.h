@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+
+// Integer conversion of the raw sensor readings to packet units. The Cortex-M4 has no FPU, and without any
+// HAL this also builds on the host, where test/test_sensor_math checks it against the float conversion.
+
+#define RREF 4020.0   // generate_rtd_table.py has its own copy of both
+#define RNOMINAL 1000.0
+
+bool rtdTableTemperature(uint16_t rtd, int16_t &temperature); // packet units, false outside the table, packetTempRaw() of the driver's result
+int32_t humidityMilli(uint32_t f_cal, uint32_t f_RH, int16_t temperature, int32_t previous); // 0.001 %RH, previous is the last result, for the temperature compensation
+uint8_t formatHumidity(uint32_t f_cal, uint32_t f_RH, int16_t temperature, int32_t previous); // the same humidity in packet units, 0 below 0 % and 252 above 125 %
@@ -1,24 +1,67 @@
+#include "sensors.h"
 #include "debug.h"
+#include "packet.h"
 #include <Arduino.h>
 
 // ---- temperature measurement ----- //
+// The Adafruit driver is used for setup and conversion, the one-shot conversion itself is driven from
+// pollTemperature() so the 10 ms bias settling and the 65 ms conversion do not block.
 
 #include <Adafruit_MAX31865.h>
-
-#define RREF 4020.0
-#define RNOMINAL 1000.0
-
-Adafruit_MAX31865 temp = Adafruit_MAX31865(PB8, PB5, PB4, PB3); // Initialise temperature IC with specific pins for ReSonde
+#include <Adafruit_SPIDevice.h>
+#include "power.h"
+#include "sensor_math.h"
+
+#define MAX31865_CONFIG_REG 0x00
+#define MAX31865_RTDMSB_REG 0x01
+#define MAX31865_CONFIG_BIAS 0x80
+#define MAX31865_CONFIG_1SHOT 0x20
+#define MAX31865_CONFIG_3WIRE 0x10
+#define MAX31865_CONFIG_FAULTSTAT 0x02
+#define BIAS_DELAY 10      // ms for the RTD bias to settle
+#define CONVERSION_TIME 65 // ms for a one-shot conversion
+
+Adafruit_MAX31865 temp = Adafruit_MAX31865(PB8, PB5, PB4, PB3);                              // Initialise temperature IC with specific pins for ReSonde
+Adafruit_SPIDevice tempSpi = Adafruit_SPIDevice(PB8, PB3, PB4, PB5, 1000000, SPI_BITORDER_MSBFIRST, SPI_MODE1); // Same pins, for the non-blocking conversion
+
+enum TemperatureState : uint8_t {
+  TEMPERATURE_IDLE,
+  TEMPERATURE_BIAS,   // bias on, waiting for the RTD voltage to settle
+  TEMPERATURE_CONVERT // one-shot conversion running
+};
+
+TemperatureState temperatureState = TEMPERATURE_IDLE;
+unsigned long temperatureStateStarted = 0;
 
 void SetupTemperature()
 {
   temp.begin(MAX31865_3WIRE); // Setup temperature IC for 3 wire RTD
+  tempSpi.begin();
+}
+
+void writeTemperatureConfig(uint8_t config)
+{
+  uint8_t buffer[2] = {(uint8_t)(MAX31865_CONFIG_REG | 0x80), (uint8_t)(config | MAX31865_CONFIG_3WIRE)}; // 0x80 marks a write
+  tempSpi.write(buffer, 2);
+}
+
+void setTemperatureState(TemperatureState state, uint16_t duration)
+{
+  temperatureState = state;
+  temperatureStateStarted = millis();
+  requestWakeup(temperatureStateStarted + duration); // the wait may be spent in Stop2, the MAX31865 converts on its own
+}
+
+int16_t rtdTemperature(uint16_t rtd)
+{ // packet units, from the generated table, same result as the driver's float conversion
+  int16_t temperature;
+  if (!rtdTableTemperature(rtd, temperature))
+    return (packetTempRaw(temp.calculateTemperature(rtd, RNOMINAL, RREF))); // far outside the flight range
+  return (temperature);
 }
 
-int16_t getFormattedTemperature()
+int16_t formatTemperature(uint16_t rtd)
 {
-  temp.clearFault();
-  float temperature = temp.temperature(RNOMINAL, RREF);
   uint8_t fault = temp.readFault();
   if (fault)
   {
@@ -35,182 +78,286 @@ int16_t getFormattedTemperature()
     if (fault & MAX31865_FAULT_OVUV)
       return (-640);
   }
-  else
+  return (rtdTemperature(rtd)); // Get temperature in packet units
+}
+
+void startTemperatureMeasurement()
+{
+  if (temperatureState != TEMPERATURE_IDLE)
+    return;
+  writeTemperatureConfig(MAX31865_CONFIG_BIAS | MAX31865_CONFIG_FAULTSTAT); // bias on and clear old faults
+  setTemperatureState(TEMPERATURE_BIAS, BIAS_DELAY);
+}
+
+bool pollTemperature(int16_t &result)
+{ // true once the conversion finished and result holds the formatted temperature
+  unsigned long elapsed = millis() - temperatureStateStarted;
+
+  if (temperatureState == TEMPERATURE_BIAS && elapsed >= BIAS_DELAY)
+  {
+    writeTemperatureConfig(MAX31865_CONFIG_BIAS | MAX31865_CONFIG_1SHOT);
+    setTemperatureState(TEMPERATURE_CONVERT, CONVERSION_TIME);
+  }
+  else if (temperatureState == TEMPERATURE_CONVERT && elapsed >= CONVERSION_TIME)
   {
-    return (round(temperature * 320.0f)); // Get temperature in celsius and convert for packet
+    uint8_t reg = MAX31865_RTDMSB_REG;
+    uint8_t rtd[2];
+    tempSpi.write_then_read(&reg, 1, rtd, 2);
+    writeTemperatureConfig(0); // bias off to save power
+    temperatureState = TEMPERATURE_IDLE;
+    result = formatTemperature(((rtd[0] << 8) | rtd[1]) >> 1); // lowest bit is the fault flag
+    return true;
   }
+  return false;
 }
 
 // ---- battery voltage measurement ----- //
-int8_t getFormattedBattVoltage()
+uint8_t getFormattedBattVoltage()
 {
   return (map(analogRead(PB2), 0, 1024, 0, 255)); // Read battery voltage on PB2 and convert for packet
 }
 
 // ---- humidity measurement ----- //
-// frequency measurement based on following example: https://github.com/stm32duino/STM32Examples/blob/main/examples/Peripherals/HardwareTimer/InputCapture/InputCapture.ino
+// The oscillator period is captured by TIM2 CH1 on PA0 and the capture registers are moved to a buffer by DMA,
+// so a measurement costs one interrupt instead of one per edge. The reference and sensor phases run as a
+// non-blocking state machine driven by pollHumidity() and the DMA completion interrupt.
+
+#define STAB_DELAY 5 // delay to allow oscillator to stabilise in ms
+#define CAPTURE_SAMPLES 100       // number of periods to average
+#define CAPTURE_TIMEOUT 50        // max time it can take to get the number of samples in milliseconds
+#define CAPTURE_DMA DMA1_Channel2 // DMA1_Channel1 is taken by the GNSS UART
+#define CAPTURE_DMA_IRQ DMA1_Channel2_IRQn
+#define CAPTURE_DMA_REQUEST DMA_REQUEST_TIM2_CH1 // PA0 is TIM2_CH1
+
+enum HumidityState : uint8_t {
+  HUMIDITY_IDLE,
+  HUMIDITY_REF_SETTLE,     // reference capacitor switched in, oscillator stabilising
+  HUMIDITY_REF_CAPTURE,
+  HUMIDITY_SENSOR_SETTLE,  // sensor switched in, oscillator stabilising
+  HUMIDITY_SENSOR_CAPTURE
+};
 
-uint32_t channel;
-volatile uint32_t FrequencyMeasured, LastCapture = 0, CurrentCapture;
-uint32_t input_freq = 0;
-volatile uint32_t rolloverCompareCount = 0;
 HardwareTimer *MyTim;
+uint32_t input_freq = 0;
+DMA_HandleTypeDef captureDma;
+uint32_t captureBuffer[CAPTURE_SAMPLES + 1]; // CCR1 values, only the low 16 bits are used
+volatile bool captureDone = false;
 
-bool newFrequency = false;
+HumidityState humidityState = HUMIDITY_IDLE;
+unsigned long humidityStateStarted = 0;
+uint32_t f_cal = 0, f_RH = 0; // frequencies of the last measurement, 0 if it failed
 
-void InputCapture_IT_callback(void)
+extern "C" void DMA1_Channel2_IRQHandler(void)
 {
-  CurrentCapture = MyTim->getCaptureCompare(channel);
-  /* frequency computation */
-  if (CurrentCapture > LastCapture)
+  HAL_DMA_IRQHandler(&captureDma);
+  if (captureDma.State == HAL_DMA_STATE_READY)
   {
-    FrequencyMeasured = input_freq / (CurrentCapture - LastCapture);
+    captureDone = true; // completion callback, all samples captured
   }
-  else if (CurrentCapture <= LastCapture)
+}
+
+void SetupFrequencyMeasurement()
+{
+  TIM_TypeDef *Instance = (TIM_TypeDef *)pinmap_peripheral(digitalPinToPinName(PA0), PinMap_PWM);
+  uint32_t channel = STM_PIN_CHANNEL(pinmap_function(digitalPinToPinName(PA0), PinMap_PWM));
+  MyTim = new HardwareTimer(Instance);
+  MyTim->setMode(channel, TIMER_INPUT_CAPTURE_RISING, PA0);
+  MyTim->setPrescaleFactor(1);
+  MyTim->setOverflow(0x10000); // 16 bit wrap, periods are summed modulo 2^16
+  input_freq = MyTim->getTimerClkFreq() / MyTim->getPrescaleFactor();
+
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  __HAL_RCC_DMAMUX1_CLK_ENABLE();
+  captureDma.Instance = CAPTURE_DMA;
+  captureDma.Init.Request = CAPTURE_DMA_REQUEST;
+  captureDma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+  captureDma.Init.PeriphInc = DMA_PINC_DISABLE;
+  captureDma.Init.MemInc = DMA_MINC_ENABLE;
+  captureDma.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+  captureDma.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+  captureDma.Init.Mode = DMA_NORMAL;
+  captureDma.Init.Priority = DMA_PRIORITY_LOW;
+  if (HAL_DMA_Init(&captureDma) != HAL_OK)
   {
-    /* 0x1000 is max overflow value */
-    FrequencyMeasured = input_freq / (0x10000 + CurrentCapture - LastCapture);
+    DEBUG_PRINTLN("Capture DMA init failed");
   }
-  LastCapture = CurrentCapture;
-  rolloverCompareCount = 0;
-  newFrequency = true;
+  __HAL_LINKDMA(MyTim->getHandle(), hdma[TIM_DMA_ID_CC1], captureDma);
+  HAL_NVIC_SetPriority(CAPTURE_DMA_IRQ, 2, 0);
+  HAL_NVIC_EnableIRQ(CAPTURE_DMA_IRQ);
 }
 
-void Rollover_IT_callback(void)
+void startCapture()
 {
-  rolloverCompareCount++;
-
-  if (rolloverCompareCount > 1)
+  captureDone = false;
+  if (HAL_TIM_IC_Start_DMA(MyTim->getHandle(), TIM_CHANNEL_1, captureBuffer, CAPTURE_SAMPLES + 1) != HAL_OK)
   {
-    FrequencyMeasured = 0;
+    DEBUG_PRINTLN("Capture start failed");
   }
 }
 
-void pauseFrequencyMeasurement()
-{ // disable frequency measurement when not needed to save power and cpu cycles
-  if (MyTim == nullptr)
-    return; // check if timer exists
-  MyTim->detachInterrupt(channel);
-  MyTim->detachInterrupt();
-  MyTim->pause();
+void stopCapture()
+{ // stop the timer when not needed to save power
+  HAL_TIM_IC_Stop_DMA(MyTim->getHandle(), TIM_CHANNEL_1);
 }
 
-void enableFrequencyMeasurement()
+uint32_t capturedFrequency()
 {
-  if (MyTim == nullptr)
-    return; // check if timer exists
-  MyTim->attachInterrupt(channel, InputCapture_IT_callback);
-  MyTim->attachInterrupt(Rollover_IT_callback);
-  MyTim->resume();
+  uint32_t ticks = 0;
+  for (uint16_t i = 1; i <= CAPTURE_SAMPLES; i++)
+  {
+    ticks += (uint16_t)(captureBuffer[i] - captureBuffer[i - 1]); // each period is far below 2^16 ticks
+  }
+  if (ticks == 0)
+  {
+    return 0;
+  }
+  return ((uint64_t)input_freq * CAPTURE_SAMPLES + ticks / 2) / ticks;
 }
 
-void SetupFrequencyMeasurement()
+void setHumidityState(HumidityState state)
 {
-  TIM_TypeDef *Instance = (TIM_TypeDef *)pinmap_peripheral(digitalPinToPinName(PA0), PinMap_PWM);
-  channel = STM_PIN_CHANNEL(pinmap_function(digitalPinToPinName(PA0), PinMap_PWM));
-  MyTim = new HardwareTimer(Instance);
-  MyTim->setMode(channel, TIMER_INPUT_CAPTURE_RISING, PA0);
-  uint32_t PrescalerFactor = 1;
-  MyTim->setPrescaleFactor(PrescalerFactor);
-  MyTim->setOverflow(0x10000);
-  MyTim->attachInterrupt(channel, InputCapture_IT_callback);
-  MyTim->attachInterrupt(Rollover_IT_callback);
-  MyTim->resume();
-
-  input_freq = MyTim->getTimerClkFreq() / MyTim->getPrescaleFactor();
+  humidityState = state;
+  humidityStateStarted = millis();
+}
 
-  pauseFrequencyMeasurement();
+void startHumidityMeasurement()
+{
+  if (humidityState != HUMIDITY_IDLE)
+  {
+    return; // still busy with the previous one
+  }
+  digitalWrite(PB12, LOW); // make sure the oscillator uses the reference capacitor
+  setHumidityState(HUMIDITY_REF_SETTLE);
 }
 
-uint16_t sta = 100;    // number of samples to average
-uint16_t timeout = 50; // max time it can take to get the number of samples in milliseconds
+bool humidityBusy()
+{
+  return humidityState != HUMIDITY_IDLE;
+}
 
-uint32_t getFrequency()
+bool pollHumidity()
 {
-  unsigned long startMillis = millis();
-  uint16_t samples = 0;
-  uint32_t frequencyBuffer = 0;
+  unsigned long elapsed = millis() - humidityStateStarted;
 
-  while (samples < sta and (millis() - startMillis) < timeout)
+  switch (humidityState)
   {
-    if (newFrequency)
+  case HUMIDITY_IDLE:
+    return false;
+
+  case HUMIDITY_REF_SETTLE:
+  case HUMIDITY_SENSOR_SETTLE:
+    if (elapsed >= STAB_DELAY) // let the oscillator stabilise
     {
-      samples++;
-      newFrequency = false;
-      frequencyBuffer += FrequencyMeasured;
+      startCapture();
+      setHumidityState(humidityState == HUMIDITY_REF_SETTLE ? HUMIDITY_REF_CAPTURE : HUMIDITY_SENSOR_CAPTURE);
     }
-  }
+    return false;
 
-  if (samples == sta)
-  {
-    return (round(frequencyBuffer / sta));
+  case HUMIDITY_REF_CAPTURE:
+    if (captureDone)
+    {
+      stopCapture();
+      f_cal = capturedFrequency();
+      digitalWrite(PB12, HIGH); // calibration done, now switch to the sensor
+      setHumidityState(HUMIDITY_SENSOR_SETTLE);
+      return false;
+    }
+    break;
+
+  case HUMIDITY_SENSOR_CAPTURE:
+    if (captureDone)
+    {
+      stopCapture();
+      f_RH = capturedFrequency();
+      digitalWrite(PB12, LOW);
+      setHumidityState(HUMIDITY_IDLE);
+      return true;
+    }
+    break;
   }
-  else
+
+  if (elapsed >= CAPTURE_TIMEOUT)
   {
     DEBUG_PRINTLN("Frequency measurement timeout");
-    return 0; // timeout
+    stopCapture();
+    digitalWrite(PB12, LOW);
+    f_cal = 0; // signals the failure to getHumidityFormatted()
+    setHumidityState(HUMIDITY_IDLE);
+    return true;
   }
+  return false;
 }
 
-const float C_ref = 107e-12;   // capacity of reference capacitor in F including stray capacitance
-const uint32_t R = 220e3;      // resistance of resistor in oscillator in ohms
-const float stray_c = 10e-12;  // stray capacitance in F
-const uint16_t stab_delay = 5; // delay to allow oscillator to stabilise in ms
-
-const float C0 = 120;      // nominal sensor capacitance in pF
-const float HC0 = 3420e-6; // nominal humidity coefficient of capacitance per %RH
-
-//float K = 0.0f;       // calibration constant determined through calibration with reference C - Not used anymore!!!
-float prev_RH = 0.0f; // previous relative humidity value
+int32_t prev_RH = 0; // previous relative humidity value in 0.001 %
 
 uint8_t getHumidityFormatted(int16_t temperature)
-{
-
-  enableFrequencyMeasurement();
-
-  digitalWrite(PB12, LOW); // make sure the oscillator uses the reference capacitor
-  delay(stab_delay);       // let the oscillator stabilise
-  uint32_t f_cal = getFrequency();
-  
-  if (f_cal == 0)
+{ // converts the frequencies of the last finished measurement
+  if (f_cal == 0 || f_RH == 0)
   {
-    pauseFrequencyMeasurement();
     return (255); // frequency measurement failed, return 255 to signal error
   }
- 
-  // calibration done, now measuring sensor
-
-  digitalWrite(PB12, HIGH); // switch to sensor
-  delay(stab_delay);        // let the oscillator stabilise
-  uint32_t f_RH = getFrequency();       // get frequency with RH sensor
 
-  float C_total_sensor = C_ref * ((float)f_cal / (float)f_RH);
+  uint8_t formatted = formatHumidity(f_cal, f_RH, temperature, prev_RH); // rounded from the exact value, not from prev_RH
+  prev_RH = humidityMilli(f_cal, f_RH, temperature, prev_RH); // temperature compensation based on last humidity value
+  return (formatted);
+}
 
-  //float C_temp = (float)f_RH / (R * K); // calculate total capacity from frequency
-  float C_RH = C_total_sensor - stray_c;        // subtract stray capacitance from total capacity to get sensor capacitance
-  float C_RH_pF = C_RH * 1.0e12f;       // convert to pF
+// ---- acquisition pipeline ----- //
+// All sensors are sampled together ahead of the next GNSS epoch. Finished samples are published by swapping
+// a double buffer, so the packet can be assembled from the latest complete sample the moment the PVT arrives.
 
-  // we now have the capacitance of the sensor in pF so we can convert it to relative humidity
+SensorSample samples[2] = {{0, 255, 0, 0}, {0, 255, 0, 0}}; // 255 rh signals no measurement yet
+uint8_t frontSample = 0;
+uint32_t acquisitionAt = 0;
+bool acquisitionScheduled = false;
+bool acquiring = false;
+bool temperatureDone = false, humidityDone = false;
 
-  float dC = -0.0014f * (prev_RH) * ((temperature / 320.0f) - 30.0f); // temperature compensation based on last humidity value
-  // now, we can calculate RH from the adjusted capacitance
-  float RH = ((C_RH_pF - dC) - C0) / (C0 * HC0);
+void scheduleAcquisition(uint32_t at)
+{
+  acquisitionAt = at;
+  acquisitionScheduled = true;
+  requestWakeup(at);
+}
 
-  digitalWrite(PB12, LOW);
-  pauseFrequencyMeasurement();
+bool sensorsBusy()
+{ // only the humidity timer needs the clocks, see idleUntilNextEvent()
+  return humidityBusy();
+}
 
-  prev_RH = RH;
-  
-  if (RH < 0.0f)
-  {
-    return (0);
-  }
-  else if (RH > 125.0f)
+bool pollSensors()
+{
+  if (acquisitionScheduled && !acquiring && (int32_t)(millis() - acquisitionAt) >= 0)
   {
-    return (252);
+    acquisitionScheduled = false;
+    acquiring = true;
+    temperatureDone = humidityDone = false;
+    samples[frontSample ^ 1].battery = getFormattedBattVoltage();
+    startTemperatureMeasurement();
+    startHumidityMeasurement();
   }
-  else
+
+  if (!acquiring)
+    return false;
+
+  SensorSample &back = samples[frontSample ^ 1];
+  if (!temperatureDone)
+    temperatureDone = pollTemperature(back.temp);
+  if (!humidityDone)
+    humidityDone = pollHumidity();
+
+  if (temperatureDone && humidityDone)
   {
-    return (round(RH * 2.0));
+    back.rh = getHumidityFormatted(back.temp); // Using the temperature of the same sample for compensation
+    back.taken = millis();
+    frontSample ^= 1;
+    acquiring = false;
+    return true;
   }
-}
\ No newline at end of file
+  return false;
+}
+
+const SensorSample &latestSample()
+{
+  return samples[frontSample];
+}
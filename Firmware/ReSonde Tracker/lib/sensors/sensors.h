@@ -1,5 +1,22 @@
+#pragma once
+#include <Arduino.h>
+
+struct SensorSample { // one complete set of sensor readings, already formatted for the packet
+  int16_t temp;
+  uint8_t rh;
+  uint8_t battery;
+  uint32_t taken; // millis() when the acquisition finished
+};
+
 void SetupTemperature();
-int16_t getFormattedTemperature();
-int8_t getFormattedBattVoltage();
+uint8_t getFormattedBattVoltage();
 void SetupFrequencyMeasurement();
-uint8_t getHumidityFormatted(int16_t temperature);
+void startHumidityMeasurement();
+bool humidityBusy();
+bool pollHumidity(); // advances the measurement, true once it finished
+uint8_t getHumidityFormatted(int16_t temperature); // uses the frequencies of the last finished measurement
+
+void scheduleAcquisition(uint32_t at); // sample all sensors starting at millis() == at
+bool sensorsBusy();                    // an acquisition is using peripherals that stop in Stop2
+bool pollSensors();                    // advances the acquisition, true when a new sample was published
+const SensorSample &latestSample();
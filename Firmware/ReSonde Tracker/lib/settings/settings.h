@@ -1,11 +1,23 @@
-#define FREQ      434.6   // Frequency in MHz
-#define BW      62.5   // Bandwidth in kHz
-#define SF      9       // Spreading Factor
-#define CR      8       // Coding Rate
+// Frequencies come from the channel plan in channels.h, shared with the receiver
+// Bandwidth, spreading factor and power come from the profiles in datarate.h
+// NAV_RATE, TX_DIVIDER and LANDED_BEACON_EPOCHS are in schedule.h, the receivers time out on the same intervals
+#include "schedule.h"
+#define CR      8       // Coding Rate, 5 is enough with FEC_GROUP set and saves a third of the airtime
 #define SW   RADIOLIB_SX126X_SYNC_WORD_PRIVATE // Sync Word
 #define PL  8      // Preamble length
-#define TX_PWR       10      // Transmission power in dBm
+#define ADAPTIVE_DATA_RATE 0 // Set to 1 to schedule faster profiles by range. Single sonde flights only, a receiver follows the profile of the sonde it heard last
 
 #define SERIAL_NUMBER 0 // Set to 0 for testing purposes
 
-#define TX_RATE 1 // How many times per second to transmit a packet
\ No newline at end of file
+#define FLIGHT_PHASES 1 // After burst skip the PTU sampling and send a frame every epoch, after landing only every LANDED_BEACON_EPOCHS epochs
+#define STATE_FILTER 1 // Send filtered position, velocity and lag corrected humidity instead of the raw values
+#define TDMA_SLOTS 1 // Transmit slots per nav period, each sonde uses slot SERIAL_NUMBER % TDMA_SLOTS. 1 transmits right away
+// Every frame has to fit its slot. A keyframe on the fallback profile takes about 700 ms, so more slots need faster profiles in datarate.h
+#define TDMA_OFFSET 100 // ms after the epoch when slot 0 starts, the packet is ready by then. Slots share the rest of the period
+//#define GNSS_TIMEPULSE_PIN PA1 // Uncomment if the GNSS timepulse output is wired to the MCU, lets it wake exactly at each epoch
+#define FEC_GROUP 0 // Send an XOR parity frame after every n (2-4) frames so receivers can rebuild one lost frame per group, 0 disables.
+                    // Frame, NACK window and parity have to fit into one TDMA slot. On the fallback profile they take longer than the 1 s nav period,
+                    // so FEC needs ADAPTIVE_DATA_RATE to schedule faster profiles, otherwise every parity frame is dropped (see parityDropped)
+#define BURST_DOWNLINK 1 // Listen for NACKs after each frame and resend the missed packets from the flash log
+#define KEYFRAME_INTERVAL 10 // Every n-th frame is a full keyframe, the ones in between are compressed deltas
+#define PACKET_PROFILE PACKET_PROFILE_FULL // Or the ID of a profile in packet.h to only send its fields. Every KEYFRAME_INTERVAL-th profile frame still goes out on the fallback profile
\ No newline at end of file
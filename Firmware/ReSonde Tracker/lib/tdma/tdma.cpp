@@ -0,0 +1,50 @@
+#include "tdma.h"
+#include "settings.h"
+#include "power.h"
+
+#define GNSS_PVT_DELAY 40 // ms from the navigation epoch until the NAV-PVT is parsed, used when no timepulse is wired
+#define SLOT_LENGTH ((NAV_PERIOD - TDMA_OFFSET) / TDMA_SLOTS)
+
+static_assert(TDMA_SLOTS >= 1 && SLOT_LENGTH > 0, "TDMA slots do not fit into the nav period");
+
+static uint32_t slotStart = 0; // millis()
+static bool slotPlanned = false;
+
+uint32_t slotLength() {
+  return TDMA_SLOTS > 1 ? SLOT_LENGTH : NAV_PERIOD;
+}
+
+void scheduleSlot(const GnssFix &fix) {
+  slotPlanned = true;
+  if (TDMA_SLOTS == 1) {
+    slotStart = millis();
+    return;
+  }
+
+  uint32_t epoch = fix.received - GNSS_PVT_DELAY;
+  uint32_t pulse;
+  if (lastTimepulse(pulse) && fix.received - pulse < NAV_PERIOD) {
+    epoch = pulse; // exact start of the epoch
+  }
+
+  // keep the slot grid on GPS time, even if the receiver's epochs are not aligned to the period
+  uint32_t phase = fix.iTOW % NAV_PERIOD;
+  slotStart = epoch - phase + TDMA_OFFSET + (SERIAL_NUMBER % TDMA_SLOTS) * SLOT_LENGTH;
+  while ((int32_t)(slotStart - millis()) < 0) {
+    slotStart += NAV_PERIOD; // slot already over, use the one of the next period
+  }
+  requestWakeup(slotStart);
+}
+
+bool slotReached() {
+  if (!slotPlanned || (int32_t)(millis() - slotStart) < 0) {
+    return false;
+  }
+  slotPlanned = false;
+  return true;
+}
+
+uint32_t slotTimeLeft() {
+  int32_t left = (int32_t)(slotStart + slotLength() - millis());
+  return left > 0 && (int32_t)(millis() - slotStart) >= 0 ? left : 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <Arduino.h>
+#include "gnss.h"
+
+// Time division between sondes sharing a channel. GNSS epochs are GPS aligned on every tracker, so each one
+// transmits in its own sub-second slot after the epoch, picked from its serial number.
+
+uint32_t slotLength();                  // ms
+void scheduleSlot(const GnssFix &fix);  // call for each NAV-PVT, plans the transmission of its packet
+bool slotReached();                     // true once when the planned slot started
+uint32_t slotTimeLeft();                // ms until the current slot ends, 0 outside of it
@@ -2,31 +2,26 @@
 #include "debug.h"
 #include "settings.h"
 #include "Radio.h"
-#include <SparkFun_u-blox_GNSS_v3.h>
-#include <SoftwareSerial.h>
+#include "gnss.h"
 #include "sensors.h"
+#include "packet.h"
+#include "power.h"
+#include "tdma.h"
+#include "flashlog.h"
+#include "filter.h"
+#include "phase.h"
+#include "trace.h"
 
-SoftwareSerial SerialGNSS(PA3, PA2); // Serial for Max M10S
-SFE_UBLOX_GNSS_SERIAL GNSS;
+#define SENSOR_LEAD_TIME 120 // ms before the next NAV-PVT to start sampling, covers the 75 ms RTD conversion
+#define LATENCY_REPORT_FRAMES 30
 
 bool fullPacket = false;
+uint8_t epochsSinceTX = 0;
+FlightPhase phase = PHASE_ASCENT;
+uint32_t latencySum = 0, latencyMax = 0; // ms from NAV-PVT reception to the start of the transmission, includes the TDMA slot wait
+uint16_t latencyFrames = 0;
 
-struct __attribute__((packed)) Packet
-{
-  uint16_t SN;
-  uint16_t counter;
-  uint32_t time;
-  int32_t lat;
-  int32_t lon;
-  int32_t alt;
-  int16_t vSpeed;
-  int16_t eSpeed;
-  int16_t nSpeed;
-  uint8_t sats;
-  int16_t temp;
-  uint8_t rh;
-  uint8_t battery;
-} packet; // Main packet to be transmitted
+Packet packet; // Main packet to be transmitted
 
 void panic()
 {
@@ -43,25 +38,68 @@ void initPacket()
   packet.SN = SERIAL_NUMBER;
 }
 
-void fillPacket()
+void fillPacket(const FilteredState &state)
 {
   packet.counter++;
   DEBUG_PRINTLN("Filling GPS stuff... ");
-  packet.time = GNSS.getUnixEpoch();
-  packet.lat = GNSS.getLatitude();
-  packet.lon = GNSS.getLongitude();
-  packet.alt = GNSS.getAltitudeMSL();
-  packet.vSpeed = round(GNSS.getNedDownVel() / -10);
-  packet.eSpeed = round(GNSS.getNedEastVel() / 10); // Getting speed in cm/s
-  packet.nSpeed = round(GNSS.getNedNorthVel() / 10);
-  packet.sats = GNSS.getSIV();
-  DEBUG_PRINTLN("Filling temperature");
-  packet.temp = getFormattedTemperature(); // Get temperature from sensors library
-  DEBUG_PRINTLN("Filling humidity");
-  packet.rh = getHumidityFormatted(packet.temp); // Get humidity from sensors library and using previously determined temperature for compensation
-  DEBUG_PRINTLN("Filling battery voltage");
-  packet.battery = getFormattedBattVoltage(); // Get battery voltage from sensors library
+  packet.time = gnssFix.unixEpoch;
+  packet.lat = state.lat;
+  packet.lon = state.lon;
+  packet.alt = state.alt;
+  packet.vSpeed = state.velD / -10;
+  packet.eSpeed = state.velE / 10; // Getting speed in cm/s
+  packet.nSpeed = state.velN / 10;
+  packet.sats = gnssFix.numSV;
+  DEBUG_PRINTLN("Filling sensor data");
+  const SensorSample &sample = latestSample(); // Sampled ahead of this epoch by the acquisition pipeline
+  packet.temp = sample.temp;
+  packet.rh = state.rh;
+  packet.battery = sample.battery;
+  logPacket(packet); // Kept in flash so receivers can ask for it again
   fullPacket = true;
+  TRACE_EVENT(TRACE_FILL, packet.counter);
+}
+
+void measureLatency()
+{
+  uint32_t latency = millis() - gnssFix.received;
+  latencySum += latency;
+  if (latency > latencyMax)
+    latencyMax = latency;
+  if (++latencyFrames == LATENCY_REPORT_FRAMES)
+  {
+    DEBUG_PRINT("Fix to TX latency avg/max ms: ");
+    DEBUG_PRINT(latencySum / latencyFrames);
+    DEBUG_PRINT("/");
+    DEBUG_PRINTLN(latencyMax);
+    if (FEC_GROUP)
+    {
+      DEBUG_PRINT("Parity frames dropped: ");
+      DEBUG_PRINTLN(parityDropped);
+    }
+    latencySum = latencyMax = 0;
+    latencyFrames = 0;
+#if defined(TRACE) && defined(DEBUG)
+    dumpTrace(SerialDebug); // printed between frames, after the spans it shows
+#endif
+  }
+}
+
+uint8_t txDivider()
+{ // the receivers expect the same intervals, see schedule.h
+  return phaseTxDivider(phase);
+}
+
+void updateFlightPhase(const FilteredState &state)
+{
+  FlightPhase next = updatePhase(state);
+  if (next != phase)
+  {
+    DEBUG_PRINTLN(next == PHASE_DESCENT ? "Burst detected, descent mode" : "Landed, beacon mode");
+    printPowerStats(); // Duty cycle of the phase that just ended
+    resetPowerStats();
+    phase = next;
+  }
 }
 
 void setup()
@@ -76,76 +114,66 @@ void setup()
   pinMode(PB12, OUTPUT); // Pin to switch between reference capacitor and humidity sensor
 
   DEBUG_BEGIN(115200);
+  TRACE_BEGIN();
 
   // Setting up the Max M10S GNSS module
-  DEBUG_PRINTLN("Attempting to start GNSS...");
-  SerialGNSS.begin(9600);
-
-  if (GNSS.begin(SerialGNSS))
-  {
-    DEBUG_PRINTLN("GNSS started successfully!");
-  }
-  else
+  if (!SetupGNSS())
   {
-    DEBUG_PRINTLN("GNSS failed to start. ReSonde cannot work without GNSS. Going into panic loop.");
+    DEBUG_PRINTLN("ReSonde cannot work without GNSS. Going into panic loop.");
     panic();
   }
 
-  GNSS.setVal32(UBLOX_CFG_UART1_BAUDRATE, 38400, VAL_LAYER_RAM_BBR);
-  GNSS.saveConfiguration();
-  GNSS.end();
-
-  SerialGNSS.flush();
-  SerialGNSS.end();
-  SerialGNSS.begin(38400);
-
-  if (GNSS.begin(SerialGNSS))
-  {
-    DEBUG_PRINTLN("GNSS started with higher baud rate successfully!");
-  }
-  else
-  {
-    DEBUG_PRINTLN("GNSS failed to start. ReSonde cannot work without GNSS. Going into panic loop.");
-    panic();
-  }
-
-  GNSS.setUART1Output(COM_TYPE_UBX);
-  GNSS.setNavigationFrequency(TX_RATE);
-  GNSS.setAutoPVT(true);
-  GNSS.setDynamicModel(DYN_MODEL_AIRBORNE1g);
-  GNSS.setLNAMode(SFE_UBLOX_LNA_MODE_BYPASS);
-  GNSS.saveConfiguration();
-
   SetupTemperature();
   SetupFrequencyMeasurement();
   // Setting up the STM32WL Radio
   SetupRadio();
 
   initPacket();
+  SetupLog();
+
+  SetupPower();
 }
 
 void loop()
 {
-  if (transmittedFlag)
-  {
-    transmittedFlag = false;
-    finishTransmission();
-    DEBUG_PRINTLN("Transmission finished");
-  }
+  pollRadio();
 
-  if (GNSS.getPVT())
+  if (pollGNSS())
   {
+    TRACE_EVENT(TRACE_PVT, 0);
     DEBUG_PRINTLN("Got a GNSS packet!");
-    if (GNSS.getSIV() > 8)
+    noteGnssMessage();
+    if (phase == PHASE_ASCENT)
+    {
+      scheduleAcquisition(nextGnssMessage() - SENSOR_LEAD_TIME); // Fresh sensor data for the next epoch, descent frames carry no PTU
+    }
+    if (gnssFix.numSV > 8)
     {
-      fillPacket();
+      const FilteredState &state = updateFilter(gnssFix, latestSample()); // Every epoch feeds the filter
+      if (FLIGHT_PHASES)
+      {
+        updateFlightPhase(state);
+      }
+      if (++epochsSinceTX >= txDivider())
+      {
+        epochsSinceTX = 0;
+        fillPacket(state);
+        scheduleSlot(gnssFix); // Transmit in this sonde's TDMA slot
+      }
     }
   }
 
-  if (fullPacket)
+  pollSensors();
+
+  if (fullPacket && !radioBusy() && slotReached())
   {
     fullPacket = false;
     DEBUG_PRINTLN("Attempting to send packet...");
-    startTX();
+    startTX(packet, phase, txDivider() * NAV_PERIOD);
+    measureLatency();
   }
+
+  pollLog();
+
+  idleUntilNextEvent(sensorsBusy()); // sleep until the radio, the RTC or the GNSS wakes us
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+#include <Arduino.h>
+
+// The driver calls of the tracker, the conversion itself runs over Adafruit_SPIDevice. calculateTemperature()
+// is the driver's float code, the fallback of rtdTemperature() far outside the table.
+
+#define MAX31865_FAULT_HIGHTHRESH 0x80
+#define MAX31865_FAULT_LOWTHRESH 0x40
+#define MAX31865_FAULT_REFINLOW 0x20
+#define MAX31865_FAULT_REFINHIGH 0x10
+#define MAX31865_FAULT_RTDINLOW 0x08
+#define MAX31865_FAULT_OVUV 0x04
+
+typedef enum { MAX31865_2WIRE = 0, MAX31865_3WIRE = 1, MAX31865_4WIRE = 0 } max31865_numwires_t;
+
+class Adafruit_MAX31865 {
+public:
+  Adafruit_MAX31865(int8_t cs, int8_t mosi, int8_t miso, int8_t clk) {}
+  bool begin(max31865_numwires_t wires = MAX31865_2WIRE) { return true; }
+  uint8_t readFault(); // fault status register of the simulated converter, 0 unless the test set one
+  float calculateTemperature(uint16_t RTDraw, float RTDnominal, float refResistor);
+};
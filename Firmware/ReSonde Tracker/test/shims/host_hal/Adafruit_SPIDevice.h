@@ -0,0 +1,19 @@
+#pragma once
+#include <Arduino.h>
+
+// SPI link to the MAX31865, the only SPI device of the tracker. Register accesses go straight to the
+// simulated converter in host_hal.cpp.
+
+#define SPI_MODE1 0x04
+
+typedef enum { SPI_BITORDER_MSBFIRST = 1, SPI_BITORDER_LSBFIRST = 0 } BusIOBitOrder;
+
+class Adafruit_SPIDevice {
+public:
+  Adafruit_SPIDevice(int8_t cs, int8_t sck, int8_t miso, int8_t mosi, uint32_t freq = 1000000,
+                     BusIOBitOrder dataOrder = SPI_BITORDER_MSBFIRST, uint8_t dataMode = SPI_MODE1) {}
+  bool begin() { return true; }
+  bool write(const uint8_t *buffer, size_t len, const uint8_t *prefix = nullptr, size_t prefixLen = 0);
+  bool write_then_read(const uint8_t *writeBuffer, size_t writeLen, uint8_t *readBuffer, size_t readLen,
+                       uint8_t sendValue = 0xFF);
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include "stm32wlxx_hal.h"
+
+// Host stand-in for the STM32duino core, just what the tracker uses. Time only moves when the firmware waits,
+// in delay(), __WFI() or LowPower.deepSleep(), so a run is deterministic. See host_hal.h for the simulation.
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define CHANGE 2
+#define FALLING 3
+#define RISING 4
+#define DEC 10
+#define HEX 16
+#define F(text) text // no separate flash address space on the host
+
+enum { PA0, PA1, PA2, PA3, PA4, PA5, PA6, PA7, PA8, PA9, PA10, PA11, PA12, PA13, PA14, PA15,
+       PB0, PB1, PB2, PB3, PB4, PB5, PB6, PB7, PB8, PB9, PB10, PB11, PB12, PB13, PB14, PB15, PIN_COUNT };
+
+class String {
+public:
+  String(const char *text = "") : text(text) {}
+  String(int value) : text(std::to_string(value)) {}
+  String(unsigned value) : text(std::to_string(value)) {}
+  String(long value) : text(std::to_string(value)) {}
+  String(unsigned long value) : text(std::to_string(value)) {}
+  String(double value, unsigned char decimals = 2);
+  String operator+(const String &other) const { return String((text + other.text).c_str()); }
+  friend String operator+(const char *left, const String &right) { return String(left) + right; }
+  const char *c_str() const { return text.c_str(); }
+  size_t length() const { return text.size(); }
+
+private:
+  std::string text;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t byte) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t print(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+  size_t print(const String &text) { return print(text.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value, int base = DEC) { return print((long)value, base); }
+  size_t print(unsigned value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+  template <typename T> size_t println(T value) { return print(value) + println(); }
+  template <typename T> size_t println(T value, int format) { return print(value, format) + println(); }
+  size_t println() { return print("\r\n"); }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual void flush() {}
+};
+
+class HardwareSerial : public Stream { // output goes to stdout, so DEBUG builds also run on the host
+public:
+  HardwareSerial(uint32_t rx, uint32_t tx) {}
+  void begin(unsigned long baud) {}
+  void end() {}
+  size_t write(uint8_t byte) override { return fwrite(&byte, 1, 1, stdout); }
+  using Print::write;
+};
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+int digitalRead(uint32_t pin);
+int analogRead(uint32_t pin); // 10 bit, see simSetBattery()
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+void noInterrupts();
+void interrupts();
+
+#include "HardwareTimer.h"
@@ -0,0 +1,22 @@
+#pragma once
+#include "stm32wlxx_hal.h"
+
+// Timer wrapper of the STM32duino core. The tracker only sets up the input capture with it and then runs the
+// capture through the HAL, see HAL_TIM_IC_Start_DMA() in host_hal.cpp.
+
+#define TIMER_INPUT_CAPTURE_RISING 9
+#define TICK_FORMAT 0
+
+class HardwareTimer {
+public:
+  HardwareTimer(TIM_TypeDef *instance) : handle{instance, {}} {}
+  void setMode(uint32_t channel, uint32_t mode, uint32_t pin) {}
+  void setPrescaleFactor(uint32_t prescaler) { handle.Instance->PSC = prescaler - 1; }
+  uint32_t getPrescaleFactor() { return handle.Instance->PSC + 1; }
+  void setOverflow(uint32_t overflow, uint32_t format = TICK_FORMAT) { handle.Instance->ARR = overflow - 1; }
+  uint32_t getTimerClkFreq() { return SystemCoreClock; }
+  TIM_HandleTypeDef *getHandle() { return &handle; }
+
+private:
+  TIM_HandleTypeDef handle;
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <Arduino.h>
+
+// The STM32WLx part of RadioLib the tracker uses. Transmissions take their real LoRa time on air, and the
+// test sees every frame through simOnTransmit(). Frames sent with simRadioReceive() are only received while
+// a reception was started, like on the air.
+
+#define RADIOLIB_ERR_NONE 0
+#define RADIOLIB_ERR_UNKNOWN -1
+#define RADIOLIB_ERR_PACKET_TOO_LONG -4
+#define RADIOLIB_ERR_INVALID_BANDWIDTH -8
+#define RADIOLIB_ERR_INVALID_SPREADING_FACTOR -9
+#define RADIOLIB_ERR_INVALID_CODING_RATE -10
+#define RADIOLIB_NC 0xFFFFFFFF
+#define RADIOLIB_SX126X_SYNC_WORD_PRIVATE 0x12
+#define RADIOLIB_SX126X_MAX_PACKET_LENGTH 255
+
+typedef unsigned long RadioLibTime_t; // us
+
+class Module {
+public:
+  enum OpMode_t { MODE_END_OF_TABLE = 0 };
+  struct RfSwitchMode_t {
+    uint8_t mode;
+    uint32_t values[5];
+  };
+};
+
+#define END_OF_MODE_TABLE {Module::MODE_END_OF_TABLE, {}}
+
+class STM32WLx_Module : public Module {};
+
+class STM32WLx {
+public:
+  enum OpMode_t { MODE_IDLE = 1, MODE_RX, MODE_TX_LP, MODE_TX_HP };
+
+  STM32WLx(STM32WLx_Module *module) {}
+  void setRfSwitchTable(const uint32_t (&pins)[5], const Module::RfSwitchMode_t table[]) {}
+  int16_t begin(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t syncWord, int8_t power, uint16_t preambleLength,
+                float tcxoVoltage, bool useRegulatorLDO);
+  int16_t setFrequency(float freq);
+  int16_t setBandwidth(float bw);
+  int16_t setSpreadingFactor(uint8_t sf);
+  int16_t setOutputPower(int8_t power);
+  int16_t setCRC(uint8_t len);
+  void setDio1Action(void (*func)(void));
+  int16_t startTransmit(const uint8_t *data, size_t len);
+  int16_t finishTransmit();
+  int16_t startReceive();
+  int16_t readData(uint8_t *data, size_t len);
+  size_t getPacketLength(bool update = true);
+  int16_t standby();
+  RadioLibTime_t getTimeOnAir(size_t len);
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include <Arduino.h>
+
+// Stop2 of the STM32WL. deepSleep() moves the simulated time on without SysTick, the RTC keeps counting.
+// The UART and the timers stop, GNSS bytes arriving meanwhile are lost, see SimStats.
+
+enum LP_Mode : uint8_t { IDLE_MODE, SLEEP_MODE, DEEP_SLEEP_MODE, SHUTDOWN_MODE };
+
+class STM32LowPower {
+public:
+  void begin() {}
+  void deepSleep(uint32_t ms); // ends early on the radio's DIO1 or an attached pin interrupt
+  void attachInterruptWakeup(uint32_t pin, void (*callback)(void), uint32_t mode, LP_Mode lowPowerMode = SLEEP_MODE);
+};
+
+extern STM32LowPower LowPower;
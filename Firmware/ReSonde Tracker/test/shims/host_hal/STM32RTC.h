@@ -0,0 +1,13 @@
+#pragma once
+#include <Arduino.h>
+
+// The RTC counts simulated time from the start of the run, also in Stop2.
+
+class STM32RTC {
+public:
+  static STM32RTC &getInstance();
+  uint32_t getEpoch(uint32_t *subSeconds = nullptr); // subSeconds in ms
+
+private:
+  STM32RTC() {}
+};
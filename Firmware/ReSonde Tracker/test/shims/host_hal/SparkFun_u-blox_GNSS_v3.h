@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+
+// Configuration calls of the SparkFun library. The simulated MAX-M10S answers all of them, it sends UBX
+// NAV-PVT at whatever rate the test feeds it with simGnssSend().
+
+#define UBLOX_CFG_UART1_BAUDRATE 0x40520001
+#define VAL_LAYER_RAM_BBR 0x03
+#define COM_TYPE_UBX 0x01
+#define DYN_MODEL_AIRBORNE1g 6
+#define SFE_UBLOX_LNA_MODE_BYPASS 1
+
+class SFE_UBLOX_GNSS_SERIAL {
+public:
+  bool begin(Stream &serialPort, uint16_t maxWait = 1100, bool assumeSuccess = false) { return true; }
+  void end() {}
+  bool setVal32(uint32_t key, uint32_t value, uint8_t layer = VAL_LAYER_RAM_BBR); // the module switches its UART baud rate right away
+  bool saveConfiguration() { return true; }
+  bool setUART1Output(uint8_t comSettings) { return true; }
+  bool setNavigationFrequency(uint8_t navFreq) { return true; }
+  bool setAutoPVT(bool enabled) { return true; }
+  bool setDynamicModel(uint8_t model) { return true; }
+  bool setLNAMode(uint8_t mode) { return true; }
+};
@@ -0,0 +1,702 @@
+#include "host_hal.h"
+#include <RadioLib.h>
+#include <Adafruit_MAX31865.h>
+#include <Adafruit_SPIDevice.h>
+#include <SparkFun_u-blox_GNSS_v3.h>
+#include <STM32LowPower.h>
+#include <STM32RTC.h>
+#include <deque>
+
+// ---- registers and memories ----- //
+
+volatile uint32_t uwTick = 0;
+uint32_t SystemCoreClock = 48000000;
+
+static CoreDebug_Type coreDebug;
+static DWT_Type dwt;
+static GPIO_TypeDef gpioA;
+static DMA_Channel_TypeDef dmaChannels[3];
+static USART_TypeDef usart2;
+static TIM_TypeDef tim2;
+
+CoreDebug_Type *CoreDebug = &coreDebug;
+DWT_Type *DWT = &dwt;
+GPIO_TypeDef *GPIOA = &gpioA;
+DMA_Channel_TypeDef *DMA1_Channel1 = &dmaChannels[0];
+DMA_Channel_TypeDef *DMA1_Channel2 = &dmaChannels[1];
+DMA_Channel_TypeDef *DMA1_Channel3 = &dmaChannels[2];
+USART_TypeDef *USART2 = &usart2;
+TIM_TypeDef *TIM2 = &tim2;
+
+const PinMap PinMap_PWM[] = {
+  {PA0, &tim2, 1}, // TIM2_CH1, the humidity oscillator input
+  {PIN_COUNT, nullptr, 0},
+};
+
+extern "C" {
+alignas(8) uint8_t hostFlash[FLASH_SIZE];
+}
+
+// End of the firmware image for SetupLog(), where the linker script would put it: 64 kB of code and 1 kB of
+// initialised data, well clear of the log pages at the end of the flash
+__asm__(".globl _sidata\n\t.set _sidata, hostFlash + 0x10000\n\t"
+        ".globl _sdata\n\t.set _sdata, hostFlash\n\t"
+        ".globl _edata\n\t.set _edata, hostFlash + 0x400\n");
+
+extern "C" void DMA1_Channel2_IRQHandler(void) __attribute__((weak)); // the firmware's capture completion
+
+STM32LowPower LowPower;
+
+// ---- simulation state ----- //
+
+#define UART_BITS_PER_BYTE 10 // start, 8 data, stop
+#define GNSS_DEFAULT_BAUD 9600
+#define ADC_FULL_SCALE 3300   // mV
+#define RTD_REFERENCE 4020.0  // ohm, the board's reference resistor
+#define RTD_NOMINAL 1000.0    // ohm, PT1000
+#define RTD_CONVERSION_TIME 52 // ms, one-shot with the 60 Hz filter, MAX31865 datasheet
+#define OSCILLATOR_R 220e3     // ohm, the resistor of the humidity oscillator
+
+static uint32_t now = 0; // ms of simulated time
+static bool stopped = false; // in Stop2
+static bool woken = false;   // an interrupt ended the Stop2 period
+static SimTickHandler tickHandler = nullptr;
+static SimTransmitHandler transmitHandler = nullptr;
+static SimStats stats;
+static uint8_t pins[PIN_COUNT];
+static bool irqEnabled[32];
+
+static float temperature = 20.0f;
+static float humidity = 50.0f;
+static uint16_t battery = 3000;
+
+struct DmaTransfer {
+  DMA_HandleTypeDef *handle;
+  uint8_t *memory;
+  uint32_t length;
+  bool running;
+  bool complete; // transfer complete flag, cleared by HAL_DMA_IRQHandler()
+};
+
+static DmaTransfer dmaTransfers[3];
+
+static DmaTransfer &transferOf(const DMA_HandleTypeDef *dma) {
+  return dmaTransfers[dma->Instance - dmaChannels];
+}
+
+// UART line from the GNSS module
+static std::deque<uint8_t> uartLine;
+static uint32_t uartCredit = 0; // bit times the line has had for the byte in flight
+static uint32_t gnssBaud = GNSS_DEFAULT_BAUD;
+static uint32_t uartBaud = 0;   // 0 until HAL_UART_Init()
+
+// TIM2 capture
+static DMA_HandleTypeDef *captureDma = nullptr;
+static uint32_t captureEndsAt = 0;
+
+// MAX31865
+static uint8_t rtdConfig = 0;
+static uint32_t rtdConversionEndsAt = 0;
+
+// radio
+enum RadioMode : uint8_t { RADIO_STANDBY, RADIO_TX, RADIO_RX };
+
+static struct {
+  float frequency = 434.0f, bw = 125.0f;
+  uint8_t sf = 9, cr = 7;
+  uint16_t preamble = 8;
+  bool crc = false;
+  int8_t power = 10;
+  RadioMode mode = RADIO_STANDBY;
+  bool receiving = false; // a frame is on the air towards us
+  uint32_t doneAt = 0;
+  void (*dio1)(void) = nullptr;
+  uint8_t incoming[RADIOLIB_SX126X_MAX_PACKET_LENGTH];
+  size_t incomingLength = 0;
+  uint8_t received[RADIOLIB_SX126X_MAX_PACKET_LENGTH];
+  size_t receivedLength = 0;
+} radio;
+
+static struct FlashEraser { FlashEraser() { memset(hostFlash, 0xFF, sizeof(hostFlash)); } } flashEraser;
+static bool flashLocked = true;
+
+// ---- peripheral models ----- //
+
+static RadioLibTime_t timeOnAir(size_t len) { // us, with the current settings
+  // Semtech's formula for explicit header LoRa packets, SX126x datasheet 6.1.4
+  uint32_t symbolUs = (uint32_t)((1UL << radio.sf) * 1000 / radio.bw);
+  uint8_t lowDataRate = symbolUs >= 16380 ? 1 : 0;
+  int32_t bits = 8 * (int32_t)len + (radio.crc ? 16 : 0) - 4 * radio.sf + 28 - (radio.sf >= 7 ? 0 : 8);
+  int32_t perBlock = 4 * (radio.sf - 2 * lowDataRate);
+  int32_t payloadSymbols = 8 + (bits > 0 ? (bits + perBlock - 1) / perBlock * radio.cr : 0);
+  double preambleSymbols = radio.preamble + (radio.sf >= 7 ? 4.25 : 6.25);
+  return (RadioLibTime_t)((preambleSymbols + payloadSymbols) * symbolUs);
+}
+
+static void stepUart() {
+  if (uartLine.empty()) {
+    uartCredit = 0; // idle line, the next byte starts with its start bit
+    return;
+  }
+  uartCredit += gnssBaud;
+  while (uartCredit >= UART_BITS_PER_BYTE * 1000 && !uartLine.empty()) {
+    uartCredit -= UART_BITS_PER_BYTE * 1000;
+    uint8_t byte = uartLine.front();
+    uartLine.pop_front();
+
+    DmaTransfer &dma = dmaTransfers[0];
+    if (stopped || !dma.running || !READ_BIT(USART2->CR3, USART_CR3_DMAR) || uartBaud != gnssBaud) {
+      stats.gnssBytesLost++;
+      continue;
+    }
+    dma.memory[dma.length - DMA1_Channel1->CNDTR] = byte;
+    if (--DMA1_Channel1->CNDTR == 0) {
+      DMA1_Channel1->CNDTR = dma.length; // circular
+    }
+  }
+}
+
+static void stepCapture() {
+  if (captureDma == nullptr) {
+    return;
+  }
+  if (stopped) {
+    stats.captureStalls++; // the timer clock is off in Stop2
+    captureEndsAt++;
+    return;
+  }
+  if ((int32_t)(now - captureEndsAt) < 0) {
+    return;
+  }
+  DmaTransfer &dma = transferOf(captureDma);
+  dma.running = false;
+  dma.complete = true;
+  captureDma->Instance->CNDTR = 0;
+  captureDma = nullptr;
+  if (irqEnabled[DMA1_Channel2_IRQn] && &dma == &dmaTransfers[1] && DMA1_Channel2_IRQHandler != nullptr) {
+    DMA1_Channel2_IRQHandler();
+  }
+}
+
+static void stepRadio() {
+  if ((radio.mode != RADIO_TX && !radio.receiving) || (int32_t)(now - radio.doneAt) < 0) {
+    return;
+  }
+  if (radio.mode == RADIO_TX) {
+    radio.mode = RADIO_STANDBY;
+  } else {
+    memcpy(radio.received, radio.incoming, radio.incomingLength);
+    radio.receivedLength = radio.incomingLength;
+    radio.receiving = false;
+  }
+  woken = true; // DIO1 is a Stop2 wake up source
+  if (radio.dio1 != nullptr) {
+    radio.dio1();
+  }
+}
+
+static void step() {
+  now++;
+  if (!stopped) {
+    uwTick++;
+    DWT->CYCCNT += SystemCoreClock / 1000;
+  }
+  if (tickHandler != nullptr) {
+    tickHandler(now);
+  }
+  stepUart();
+  stepCapture();
+  stepRadio();
+}
+
+static double oscillatorCapacitance() { // F, what the oscillator on PA0 sees, PB12 selects the capacitor
+  if (pins[PB12] == LOW) {
+    return 107e-12; // reference capacitor including the stray capacitance
+  }
+  double drift = -0.0014e-12 * humidity * (temperature - 30); // per %RH and degree from 30 C
+  double sensor = 120e-12 * (1 + 3420e-6 * humidity) + drift;
+  return sensor + 10e-12; // stray capacitance
+}
+
+static uint16_t rtdCode(double celsius) { // Callendar-Van Dusen, what the converter measures on a PT1000
+  const double A = 3.9083e-3, B = -5.775e-7, C = -4.183e-12;
+  double r = 1 + A * celsius + B * celsius * celsius;
+  if (celsius < 0) {
+    r += C * (celsius - 100) * celsius * celsius * celsius;
+  }
+  return (uint16_t)lround(RTD_NOMINAL * r / RTD_REFERENCE * 32768);
+}
+
+// ---- test interface ----- //
+
+uint32_t simNow() {
+  return now;
+}
+
+void simOnTick(SimTickHandler handler) {
+  tickHandler = handler;
+}
+
+void simOnTransmit(SimTransmitHandler handler) {
+  transmitHandler = handler;
+}
+
+void simGnssSend(const uint8_t *bytes, size_t length) {
+  uartLine.insert(uartLine.end(), bytes, bytes + length);
+}
+
+void simRadioReceive(const uint8_t *bytes, size_t length) {
+  if (radio.mode != RADIO_RX || radio.receiving || length > sizeof(radio.incoming)) {
+    return; // nobody listening, or the frames collide
+  }
+  memcpy(radio.incoming, bytes, length);
+  radio.incomingLength = length;
+  radio.receiving = true;
+  radio.doneAt = now + (timeOnAir(length) + 999) / 1000;
+}
+
+void simSetTemperature(float celsius) {
+  temperature = celsius;
+}
+
+void simSetHumidity(float percent) {
+  humidity = percent;
+}
+
+void simSetBattery(uint16_t millivolts) {
+  battery = millivolts;
+}
+
+const SimStats &simStats() {
+  return stats;
+}
+
+// ---- Arduino core ----- //
+
+String::String(double value, unsigned char decimals) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+  text = buffer;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(long value, int base) {
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), base == HEX ? "%lX" : "%ld", value);
+  return print(buffer);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), base == HEX ? "%lX" : "%lu", value);
+  return print(buffer);
+}
+
+unsigned long millis() {
+  return uwTick;
+}
+
+unsigned long micros() {
+  return uwTick * 1000;
+}
+
+void delay(unsigned long ms) {
+  while (ms--) {
+    step();
+  }
+}
+
+void __WFI() {
+  step(); // SysTick ends it at the latest, any earlier interrupt runs within the step
+}
+
+void NVIC_SystemReset() {
+  fprintf(stderr, "NVIC_SystemReset() at %u ms, the firmware gave up\n", (unsigned)now);
+  exit(EXIT_FAILURE);
+}
+
+void noInterrupts() {}
+void interrupts() {}
+
+void pinMode(uint32_t pin, uint32_t mode) {}
+
+void digitalWrite(uint32_t pin, uint32_t value) {
+  if (pin < PIN_COUNT) {
+    pins[pin] = value != LOW;
+  }
+}
+
+int digitalRead(uint32_t pin) {
+  return pin < PIN_COUNT ? pins[pin] : LOW;
+}
+
+int analogRead(uint32_t pin) {
+  return pin == PB2 ? (uint32_t)battery * 1024 / ADC_FULL_SCALE : 0;
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+PinName digitalPinToPinName(uint32_t pin) {
+  return pin;
+}
+
+void *pinmap_peripheral(PinName pin, const PinMap *map) {
+  for (; map->peripheral != nullptr; map++) {
+    if (map->pin == pin) {
+      return map->peripheral;
+    }
+  }
+  return nullptr;
+}
+
+uint32_t pinmap_function(PinName pin, const PinMap *map) {
+  for (; map->peripheral != nullptr; map++) {
+    if (map->pin == pin) {
+      return map->function;
+    }
+  }
+  return 0;
+}
+
+// ---- HAL ----- //
+
+void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t preempt, uint32_t sub) {}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type irq) {
+  irqEnabled[irq] = true;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type irq) {
+  irqEnabled[irq] = false;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init) {}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *uart) {
+  if (uart->Instance != USART2 || uart->Init.BaudRate == 0) {
+    return HAL_ERROR;
+  }
+  uartBaud = uart->Init.BaudRate;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *dma) {
+  if (dma->Instance == nullptr) {
+    return HAL_ERROR;
+  }
+  dma->State = HAL_DMA_STATE_READY;
+  transferOf(dma) = {dma, nullptr, 0, false, false};
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *dma, uintptr_t source, uintptr_t destination, uint32_t length) {
+  if (dma->State != HAL_DMA_STATE_READY) {
+    return HAL_BUSY;
+  }
+  DmaTransfer &transfer = transferOf(dma);
+  transfer.memory = (uint8_t *)destination;
+  transfer.length = length;
+  transfer.running = true;
+  transfer.complete = false;
+  dma->Instance->CNDTR = length;
+  dma->State = HAL_DMA_STATE_BUSY;
+  return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *dma) {
+  DmaTransfer &transfer = transferOf(dma);
+  if (transfer.complete) {
+    transfer.complete = false;
+    dma->State = HAL_DMA_STATE_READY; // then the HAL calls the completion callback
+  }
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Start_DMA(TIM_HandleTypeDef *timer, uint32_t channel, uint32_t *data, uint16_t length) {
+  DMA_HandleTypeDef *dma = timer->hdma[TIM_DMA_ID_CC1];
+  if (channel != TIM_CHANNEL_1 || dma == nullptr || length == 0) {
+    return HAL_ERROR;
+  }
+  if (dma->State != HAL_DMA_STATE_READY) {
+    return HAL_BUSY;
+  }
+
+  // the DMA copies CCR1 at each rising edge, the counter wraps at ARR
+  double clock = (double)SystemCoreClock / (timer->Instance->PSC + 1);
+  double frequency = 1 / (OSCILLATOR_R * oscillatorCapacitance());
+  double period = clock / frequency;
+  uint32_t wrap = timer->Instance->ARR + 1;
+  double start = fmod((double)now * clock / 1000, wrap);
+  for (uint16_t i = 0; i < length; i++) {
+    data[i] = (uint32_t)fmod(start + i * period, wrap);
+  }
+  DmaTransfer &transfer = transferOf(dma);
+  transfer.running = true;
+  transfer.complete = false;
+  dma->Instance->CNDTR = length;
+  dma->State = HAL_DMA_STATE_BUSY;
+  captureDma = dma;
+  captureEndsAt = now + (uint32_t)ceil(length * 1000 / frequency);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Stop_DMA(TIM_HandleTypeDef *timer, uint32_t channel) {
+  DMA_HandleTypeDef *dma = timer->hdma[TIM_DMA_ID_CC1];
+  if (dma == nullptr) {
+    return HAL_ERROR;
+  }
+  transferOf(dma).running = false;
+  if (captureDma == dma) {
+    captureDma = nullptr;
+  }
+  dma->State = HAL_DMA_STATE_READY;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock() {
+  flashLocked = false;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock() {
+  flashLocked = true;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *erase, uint32_t *pageError) {
+  if (flashLocked || erase->Page + erase->NbPages > FLASH_SIZE / FLASH_PAGE_SIZE) {
+    stats.flashErrors++;
+    *pageError = erase->Page;
+    return HAL_ERROR;
+  }
+  memset(hostFlash + erase->Page * FLASH_PAGE_SIZE, 0xFF, erase->NbPages * FLASH_PAGE_SIZE);
+  *pageError = 0xFFFFFFFF;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t type, uintptr_t address, uint64_t data) {
+  uint8_t *target = (uint8_t *)address;
+  bool inside = target >= hostFlash && target + sizeof(data) <= hostFlash + FLASH_SIZE && address % sizeof(data) == 0;
+  bool erased = inside;
+  for (uint8_t i = 0; erased && i < sizeof(data); i++) {
+    erased = target[i] == 0xFF;
+  }
+  if (flashLocked || type != FLASH_TYPEPROGRAM_DOUBLEWORD || !erased) {
+    stats.flashErrors++;
+    return HAL_ERROR;
+  }
+  memcpy(target, &data, sizeof(data));
+  return HAL_OK;
+}
+
+// ---- low power and RTC ----- //
+
+void STM32LowPower::deepSleep(uint32_t ms) {
+  stopped = true;
+  woken = false;
+  uint32_t slept = 0;
+  while (slept < ms && !woken) {
+    step();
+    slept++;
+  }
+  stopped = false;
+  stats.stop2Ms += slept;
+}
+
+void STM32LowPower::attachInterruptWakeup(uint32_t pin, void (*callback)(void), uint32_t mode, LP_Mode lowPowerMode) {
+  // the GNSS timepulse is not simulated, the firmware then times the epochs from the NAV-PVT like without the pin
+}
+
+STM32RTC &STM32RTC::getInstance() {
+  static STM32RTC rtc;
+  return rtc;
+}
+
+uint32_t STM32RTC::getEpoch(uint32_t *subSeconds) {
+  if (subSeconds != nullptr) {
+    *subSeconds = now % 1000;
+  }
+  return now / 1000;
+}
+
+// ---- MAX31865 ----- //
+
+bool Adafruit_SPIDevice::write(const uint8_t *buffer, size_t len, const uint8_t *prefix, size_t prefixLen) {
+  if (len == 2 && buffer[0] == 0x80) { // configuration register
+    bool started = (buffer[1] & 0x20) && !(rtdConfig & 0x20);
+    rtdConfig = buffer[1] & ~0x22; // one-shot and fault clear bits clear themselves
+    if (started && (buffer[1] & 0x80)) {
+      rtdConversionEndsAt = now + RTD_CONVERSION_TIME;
+    }
+  }
+  return true;
+}
+
+bool Adafruit_SPIDevice::write_then_read(const uint8_t *writeBuffer, size_t writeLen, uint8_t *readBuffer, size_t readLen,
+                                         uint8_t sendValue) {
+  if (writeLen != 1 || writeBuffer[0] != 0x01 || readLen != 2) {
+    memset(readBuffer, 0, readLen);
+    return true;
+  }
+  if ((int32_t)(now - rtdConversionEndsAt) < 0) {
+    stats.rtdEarlyReads++;
+  }
+  uint16_t code = rtdCode(temperature);
+  readBuffer[0] = code >> 7; // RTD MSB and LSB, the lowest bit is the fault flag
+  readBuffer[1] = (code << 1) & 0xFF;
+  return true;
+}
+
+uint8_t Adafruit_MAX31865::readFault() {
+  return 0;
+}
+
+float Adafruit_MAX31865::calculateTemperature(uint16_t RTDraw, float RTDnominal, float refResistor) {
+  const float A = 3.9083e-3, B = -5.775e-7;
+  float Rt = RTDraw;
+  Rt /= 32768;
+  Rt *= refResistor;
+  float Z1 = -A, Z2 = A * A - (4 * B), Z3 = (4 * B) / RTDnominal, Z4 = 2 * B;
+  float temp = Z2 + (Z3 * Rt);
+  temp = (sqrt(temp) + Z1) / Z4;
+  if (temp >= 0)
+    return temp;
+
+  Rt /= RTDnominal;
+  Rt *= 100; // normalize to 100 ohm
+  float rpoly = Rt;
+  temp = -242.02;
+  temp += 2.2228 * rpoly;
+  rpoly *= Rt; // square
+  temp += 2.5859e-3 * rpoly;
+  rpoly *= Rt; // ^3
+  temp -= 4.8260e-6 * rpoly;
+  rpoly *= Rt; // ^4
+  temp -= 2.8183e-8 * rpoly;
+  rpoly *= Rt; // ^5
+  temp += 1.5243e-10 * rpoly;
+  return temp;
+}
+
+// ---- GNSS module ----- //
+
+bool SFE_UBLOX_GNSS_SERIAL::setVal32(uint32_t key, uint32_t value, uint8_t layer) {
+  if (key == UBLOX_CFG_UART1_BAUDRATE) {
+    gnssBaud = value;
+  }
+  return true;
+}
+
+// ---- radio ----- //
+
+static bool validBandwidth(float bw) {
+  const float allowed[] = {7.8, 10.4, 15.6, 20.8, 31.25, 41.7, 62.5, 125.0, 250.0, 500.0};
+  for (float a : allowed) {
+    if (fabsf(bw - a) < 0.01f) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int16_t STM32WLx::begin(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t syncWord, int8_t power,
+                        uint16_t preambleLength, float tcxoVoltage, bool useRegulatorLDO) {
+  if (cr < 5 || cr > 8) {
+    return RADIOLIB_ERR_INVALID_CODING_RATE;
+  }
+  int16_t state = setBandwidth(bw);
+  if (state == RADIOLIB_ERR_NONE) {
+    state = setSpreadingFactor(sf);
+  }
+  radio.cr = cr;
+  radio.preamble = preambleLength;
+  setFrequency(freq);
+  setOutputPower(power);
+  return state;
+}
+
+int16_t STM32WLx::setFrequency(float freq) {
+  radio.frequency = freq;
+  return RADIOLIB_ERR_NONE;
+}
+
+int16_t STM32WLx::setBandwidth(float bw) {
+  if (!validBandwidth(bw)) {
+    return RADIOLIB_ERR_INVALID_BANDWIDTH;
+  }
+  radio.bw = bw;
+  return RADIOLIB_ERR_NONE;
+}
+
+int16_t STM32WLx::setSpreadingFactor(uint8_t sf) {
+  if (sf < 5 || sf > 12) {
+    return RADIOLIB_ERR_INVALID_SPREADING_FACTOR;
+  }
+  radio.sf = sf;
+  return RADIOLIB_ERR_NONE;
+}
+
+int16_t STM32WLx::setOutputPower(int8_t power) {
+  radio.power = power;
+  return RADIOLIB_ERR_NONE;
+}
+
+int16_t STM32WLx::setCRC(uint8_t len) {
+  radio.crc = len > 0;
+  return RADIOLIB_ERR_NONE;
+}
+
+void STM32WLx::setDio1Action(void (*func)(void)) {
+  radio.dio1 = func;
+}
+
+int16_t STM32WLx::startTransmit(const uint8_t *data, size_t len) {
+  if (len > RADIOLIB_SX126X_MAX_PACKET_LENGTH) {
+    return RADIOLIB_ERR_PACKET_TOO_LONG;
+  }
+  uint32_t airtime = (getTimeOnAir(len) + 999) / 1000;
+  radio.mode = RADIO_TX;
+  radio.receiving = false;
+  radio.doneAt = now + airtime;
+  if (transmitHandler != nullptr) {
+    transmitHandler({data, len, now, airtime, radio.sf, radio.bw, radio.frequency, radio.power});
+  }
+  return RADIOLIB_ERR_NONE;
+}
+
+int16_t STM32WLx::finishTransmit() {
+  return standby();
+}
+
+int16_t STM32WLx::startReceive() {
+  radio.mode = RADIO_RX;
+  radio.receiving = false;
+  return RADIOLIB_ERR_NONE;
+}
+
+int16_t STM32WLx::readData(uint8_t *data, size_t len) {
+  memcpy(data, radio.received, len < radio.receivedLength ? len : radio.receivedLength);
+  return RADIOLIB_ERR_NONE;
+}
+
+size_t STM32WLx::getPacketLength(bool update) {
+  return radio.receivedLength;
+}
+
+int16_t STM32WLx::standby() {
+  radio.mode = RADIO_STANDBY;
+  radio.receiving = false;
+  return RADIOLIB_ERR_NONE;
+}
+
+RadioLibTime_t STM32WLx::getTimeOnAir(size_t len) {
+  return timeOnAir(len);
+}
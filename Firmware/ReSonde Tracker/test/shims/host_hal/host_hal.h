@@ -0,0 +1,45 @@
+#pragma once
+#include <Arduino.h>
+
+// Simulated hardware for running the whole tracker firmware on the host: pio test -e native.
+// The headers next to this one stand in for the STM32duino core, the HAL, RadioLib, the MAX31865 and the
+// SparkFun u-blox drivers. Behind them sit models of the peripherals the firmware drives directly:
+//   - the GNSS UART with its circular DMA, bytes arrive at the configured baud rate
+//   - the MAX31865, the RTD code follows the simulated temperature
+//   - the humidity oscillator and the TIM2 capture DMA, its frequency follows the simulated humidity
+//   - the LoRa radio, transmissions take their time on air and then raise DIO1
+//   - the flash, programmed double words have to be erased first
+// Simulated time advances 1 ms per step, only while the firmware waits. The test registers a tick handler to
+// feed the GNSS and a transmit handler to receive the frames, then calls setup() and loop().
+
+struct SimFrame {
+  const uint8_t *data;
+  size_t length;
+  uint32_t start;   // simNow() when the transmission started
+  uint32_t airtime; // ms
+  uint8_t sf;
+  float bw;         // kHz
+  float frequency;  // MHz
+  int8_t power;     // dBm
+};
+
+struct SimStats { // hardware misuse the firmware should never cause
+  uint32_t gnssBytesLost;   // arrived while the UART was stopped in Stop2 or the DMA was not running
+  uint32_t captureStalls;   // ms a humidity capture was held up in Stop2
+  uint32_t rtdEarlyReads;   // RTD register read before the one-shot conversion finished
+  uint32_t flashErrors;     // programming a double word that was not erased, or with the flash locked
+  uint32_t stop2Ms;         // ms spent in Stop2
+};
+
+typedef void (*SimTickHandler)(uint32_t now);
+typedef void (*SimTransmitHandler)(const SimFrame &frame);
+
+uint32_t simNow(); // ms since the start of the run, keeps counting in Stop2 unlike millis()
+void simOnTick(SimTickHandler handler); // called at every simulated ms, before the peripherals move on
+void simOnTransmit(SimTransmitHandler handler);
+void simGnssSend(const uint8_t *bytes, size_t length); // queued on the UART line, the DMA receives it byte by byte
+void simRadioReceive(const uint8_t *bytes, size_t length); // a frame towards the tracker, lost unless it is listening
+void simSetTemperature(float celsius);
+void simSetHumidity(float percent); // drift compensated with the simulated temperature, like the firmware does
+void simSetBattery(uint16_t millivolts);
+const SimStats &simStats();
@@ -0,0 +1,135 @@
+#pragma once
+#include <stdint.h>
+
+// The part of the STM32WL HAL and CMSIS the tracker uses, for host runs. Registers are plain structs the
+// simulation in host_hal.cpp reads and writes, see host_hal.h. Addresses are uintptr_t where the HAL has
+// uint32_t, so they also hold host pointers. On the target both are the same type.
+
+typedef enum { HAL_OK = 0x00, HAL_ERROR = 0x01, HAL_BUSY = 0x02, HAL_TIMEOUT = 0x03 } HAL_StatusTypeDef;
+
+// ---- core ----- //
+
+extern volatile uint32_t uwTick; // ms, what millis() returns, stops in Stop2 like SysTick
+extern uint32_t SystemCoreClock;
+
+struct CoreDebug_Type { volatile uint32_t DEMCR; };
+struct DWT_Type { volatile uint32_t CTRL, CYCCNT; };
+extern CoreDebug_Type *CoreDebug;
+extern DWT_Type *DWT; // CYCCNT counts SystemCoreClock cycles of simulated time
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+#define DWT_CTRL_CYCCNTENA_Msk 1u
+
+typedef enum { DMA1_Channel1_IRQn = 11, DMA1_Channel2_IRQn = 12, DMA1_Channel3_IRQn = 13 } IRQn_Type;
+void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t preempt, uint32_t sub);
+void HAL_NVIC_EnableIRQ(IRQn_Type irq);
+void HAL_NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SystemReset(); // ends the host run, a reset means the firmware gave up
+void __WFI();            // sleeps until the next SysTick, 1 ms of simulated time
+
+#define SET_BIT(reg, bit) ((reg) |= (bit))
+#define CLEAR_BIT(reg, bit) ((reg) &= ~(bit))
+#define READ_BIT(reg, bit) ((reg) & (bit))
+
+// ---- GPIO ----- //
+
+struct GPIO_TypeDef { volatile uint32_t MODER, IDR, ODR; };
+struct GPIO_InitTypeDef { uint32_t Pin, Mode, Pull, Speed, Alternate; };
+extern GPIO_TypeDef *GPIOA;
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init);
+#define GPIO_PIN_2 0x0004u
+#define GPIO_PIN_3 0x0008u
+#define GPIO_MODE_AF_PP 0x02u
+#define GPIO_PULLUP 0x01u
+#define GPIO_SPEED_FREQ_HIGH 0x02u
+#define GPIO_AF7_USART2 0x07u
+#define __HAL_RCC_GPIOA_CLK_ENABLE() do {} while (0)
+
+// ---- DMA ----- //
+
+struct DMA_Channel_TypeDef { volatile uint32_t CCR, CNDTR, CPAR, CMAR; };
+struct DMA_InitTypeDef { uint32_t Request, Direction, PeriphInc, MemInc, PeriphDataAlignment, MemDataAlignment, Mode, Priority; };
+typedef enum { HAL_DMA_STATE_RESET = 0x00, HAL_DMA_STATE_READY = 0x01, HAL_DMA_STATE_BUSY = 0x02 } HAL_DMA_StateTypeDef;
+struct DMA_HandleTypeDef {
+  DMA_Channel_TypeDef *Instance;
+  DMA_InitTypeDef Init;
+  volatile HAL_DMA_StateTypeDef State;
+  void *Parent;
+};
+extern DMA_Channel_TypeDef *DMA1_Channel1; // the GNSS UART reception, see simGnssSend()
+extern DMA_Channel_TypeDef *DMA1_Channel2; // the humidity capture, see simSetHumidity()
+extern DMA_Channel_TypeDef *DMA1_Channel3;
+#define DMA_REQUEST_USART2_RX 19u
+#define DMA_REQUEST_TIM2_CH1 29u
+#define DMA_PERIPH_TO_MEMORY 0x00u
+#define DMA_PINC_DISABLE 0x00u
+#define DMA_MINC_ENABLE 0x80u
+#define DMA_PDATAALIGN_BYTE 0x000u
+#define DMA_PDATAALIGN_WORD 0x200u
+#define DMA_MDATAALIGN_BYTE 0x000u
+#define DMA_MDATAALIGN_WORD 0x800u
+#define DMA_NORMAL 0x00u
+#define DMA_CIRCULAR 0x20u
+#define DMA_PRIORITY_LOW 0x0000u
+#define DMA_PRIORITY_HIGH 0x2000u
+#define __HAL_RCC_DMA1_CLK_ENABLE() do {} while (0)
+#define __HAL_RCC_DMAMUX1_CLK_ENABLE() do {} while (0)
+#define __HAL_LINKDMA(handle, field, dma) do { (handle)->field = &(dma); (dma).Parent = (handle); } while (0)
+#define __HAL_DMA_GET_COUNTER(handle) ((handle)->Instance->CNDTR)
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *dma);
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *dma, uintptr_t source, uintptr_t destination, uint32_t length);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *dma);
+
+// ---- UART ----- //
+
+struct USART_TypeDef { volatile uint32_t CR1, CR2, CR3, BRR, ISR, ICR, RDR, TDR; };
+struct UART_InitTypeDef { uint32_t BaudRate, WordLength, StopBits, Parity, Mode, HwFlowCtl, OverSampling, OneBitSampling, ClockPrescaler; };
+struct UART_AdvFeatureInitTypeDef { uint32_t AdvFeatureInit; };
+struct UART_HandleTypeDef { USART_TypeDef *Instance; UART_InitTypeDef Init; UART_AdvFeatureInitTypeDef AdvancedInit; };
+extern USART_TypeDef *USART2;
+#define USART_CR3_DMAR (1u << 6)
+#define UART_WORDLENGTH_8B 0x00u
+#define UART_STOPBITS_1 0x00u
+#define UART_PARITY_NONE 0x00u
+#define UART_MODE_TX_RX 0x0Cu
+#define UART_HWCONTROL_NONE 0x00u
+#define UART_OVERSAMPLING_16 0x00u
+#define UART_ONE_BIT_SAMPLE_DISABLE 0x00u
+#define UART_PRESCALER_DIV1 0x00u
+#define UART_ADVFEATURE_NO_INIT 0x00u
+#define __HAL_RCC_USART2_CLK_ENABLE() do {} while (0)
+#define __HAL_UART_CLEAR_OREFLAG(handle) do {} while (0)
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *uart);
+
+// ---- timers ----- //
+
+struct TIM_TypeDef { volatile uint32_t CR1, CNT, PSC, ARR, CCR1; };
+struct TIM_HandleTypeDef { TIM_TypeDef *Instance; DMA_HandleTypeDef *hdma[7]; };
+extern TIM_TypeDef *TIM2;
+#define TIM_CHANNEL_1 0x00u
+#define TIM_DMA_ID_CC1 0x01u
+HAL_StatusTypeDef HAL_TIM_IC_Start_DMA(TIM_HandleTypeDef *timer, uint32_t channel, uint32_t *data, uint16_t length);
+HAL_StatusTypeDef HAL_TIM_IC_Stop_DMA(TIM_HandleTypeDef *timer, uint32_t channel);
+
+// ---- flash ----- //
+
+#define FLASH_SIZE (256 * 1024)
+#define FLASH_PAGE_SIZE 2048
+extern "C" uint8_t hostFlash[FLASH_SIZE]; // erased when the run starts, like a fresh chip
+#define FLASH_BASE ((uintptr_t)hostFlash)
+#define FLASH_TYPEERASE_PAGES 0x00u
+#define FLASH_TYPEPROGRAM_DOUBLEWORD 0x01u
+struct FLASH_EraseInitTypeDef { uint32_t TypeErase, Page, NbPages; };
+HAL_StatusTypeDef HAL_FLASH_Unlock();
+HAL_StatusTypeDef HAL_FLASH_Lock();
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *erase, uint32_t *pageError);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t type, uintptr_t address, uint64_t data); // HAL_ERROR unless the double word is erased
+
+// ---- Arduino core pin map ----- //
+
+typedef uint32_t PinName;
+struct PinMap { PinName pin; void *peripheral; uint32_t function; };
+extern const PinMap PinMap_PWM[];
+PinName digitalPinToPinName(uint32_t pin);
+void *pinmap_peripheral(PinName pin, const PinMap *map);
+uint32_t pinmap_function(PinName pin, const PinMap *map);
+#define STM_PIN_CHANNEL(function) (function)
@@ -0,0 +1,225 @@
+// Host test of the integer sensor conversion against the float code it replaced: pio test -e native
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "packet.h"
+#include "sensor_math.h"
+#include "rtd_table.h"
+
+#define RTD_A 3.9083e-3 // Callendar-Van Dusen coefficients of the Adafruit driver
+#define RTD_B -5.775e-7
+
+float driverTemperature(uint16_t RTDraw, float RTDnominal, float refResistor)
+{ // Adafruit_MAX31865::calculateTemperature()
+  float Z1, Z2, Z3, Z4, Rt, temp;
+  Rt = RTDraw;
+  Rt /= 32768;
+  Rt *= refResistor;
+  Z1 = -RTD_A;
+  Z2 = RTD_A * RTD_A - (4 * RTD_B);
+  Z3 = (4 * RTD_B) / RTDnominal;
+  Z4 = 2 * RTD_B;
+  temp = Z2 + (Z3 * Rt);
+  temp = (sqrt(temp) + Z1) / Z4;
+  if (temp >= 0)
+    return temp;
+
+  Rt /= RTDnominal;
+  Rt *= 100; // normalize to 100 ohm
+  float rpoly = Rt;
+  temp = -242.02;
+  temp += 2.2228 * rpoly;
+  rpoly *= Rt; // square
+  temp += 2.5859e-3 * rpoly;
+  rpoly *= Rt; // ^3
+  temp -= 4.8260e-6 * rpoly;
+  rpoly *= Rt; // ^4
+  temp -= 2.8183e-8 * rpoly;
+  rpoly *= Rt; // ^5
+  temp += 1.5243e-10 * rpoly;
+  return temp;
+}
+
+float floatHumidity(uint32_t f_cal, uint32_t f_RH, int16_t temperature, float prev_RH)
+{ // getHumidityFormatted() before the integer conversion, in %RH
+  const float C_ref = 107e-12;
+  const float stray_c = 10e-12;
+  const float C0 = 120;
+  const float HC0 = 3420e-6;
+  float C_total_sensor = C_ref * ((float)f_cal / (float)f_RH);
+  float C_RH_pF = (C_total_sensor - stray_c) * 1.0e12f;
+  float dC = -0.0014f * (prev_RH) * (packetTempCelsius(temperature) - 30.0f);
+  return ((C_RH_pF - dC) - C0) / (C0 * HC0);
+}
+
+uint8_t floatHumidityFormatted(float RH)
+{
+  if (RH < 0.0f)
+    return (0);
+  else if (RH > 125.0f)
+    return (252);
+  return (packetRhRaw(RH));
+}
+
+uint32_t lcg = 12345;
+uint32_t nextRandom(uint32_t range)
+{ // deterministic, the same samples on every run
+  lcg = lcg * 1664525 + 1013904223;
+  return (lcg >> 8) % range;
+}
+
+int64_t exactHumidity(uint32_t f_cal, uint32_t f_RH, int16_t temperature, int32_t previous, int32_t scale, bool &exact)
+{ // floor(scale * RH) straight from the formula in 0.1 fF, wide enough to need no splitting
+  __int128 numerator = ((__int128)1070000 * f_cal - (__int128)1300000 * f_RH) * 1000 * PACKET_TEMP_SCALE +
+                       (__int128)14 * previous * (temperature - packetTempRaw(30)) * f_RH;
+  __int128 denominator = (__int128)f_RH * 1000 * PACKET_TEMP_SCALE * 4104;
+  __int128 scaled = numerator * scale;
+  __int128 quotient = scaled / denominator;
+  if (scaled % denominator < 0)
+    quotient--;
+  exact = scaled % denominator == 0;
+  return ((int64_t)quotient);
+}
+
+int32_t exactHumidityMilli(uint32_t f_cal, uint32_t f_RH, int16_t temperature, int32_t previous)
+{ // rounded half away from zero
+  bool exact;
+  int64_t twice = exactHumidity(f_cal, f_RH, temperature, previous, 2000, exact);
+  return ((int32_t)(twice >= 0 ? (twice + 1) / 2 : -((1 - twice - !exact) / 2)));
+}
+
+uint8_t exactHumidityFormatted(uint32_t f_cal, uint32_t f_RH, int16_t temperature, int32_t previous)
+{
+  bool exact;
+  int64_t quarters = exactHumidity(f_cal, f_RH, temperature, previous, 4, exact);
+  if (quarters < 0)
+    return (0);
+  if (quarters > 500 || (quarters == 500 && !exact))
+    return (252);
+  return ((uint8_t)((quarters + 1) / 2));
+}
+
+double roundingDistance(uint32_t f_cal, uint32_t f_RH, int16_t temperature, int32_t previous)
+{ // %RH from the humidity to the nearest point between two packet values
+  bool exact;
+  int64_t millionths = exactHumidity(f_cal, f_RH, temperature, previous, 1000000, exact); // the points are 0.25 %RH + n * 0.5 %RH
+  int64_t offset = ((millionths % 500000) + 500000) % 500000;
+  return (fabs(offset - 250000.0) / 1e6);
+}
+
+void test_rtd_table_matches_driver(void)
+{
+  for (uint16_t rtd = RTD_FIRST_CODE; rtd < RTD_LAST_CODE; rtd++)
+  {
+    int16_t fixed;
+    TEST_ASSERT_TRUE(rtdTableTemperature(rtd, fixed));
+    TEST_ASSERT_EQUAL_INT16(packetTempRaw(driverTemperature(rtd, RNOMINAL, RREF)), fixed);
+  }
+}
+
+void test_rtd_outside_table(void)
+{
+  int16_t fixed;
+  TEST_ASSERT_FALSE(rtdTableTemperature(RTD_FIRST_CODE - 1, fixed));
+  TEST_ASSERT_FALSE(rtdTableTemperature(RTD_LAST_CODE, fixed));
+}
+
+void test_rtd_around_zero(void)
+{ // the driver switches formulas at 0 C, the table interval holding it must follow
+  for (uint16_t rtd = RTD_STRADDLE_CODE; rtd < RTD_STRADDLE_CODE + (1 << RTD_STEP_BITS); rtd++)
+  {
+    int16_t fixed;
+    TEST_ASSERT_TRUE(rtdTableTemperature(rtd, fixed));
+    TEST_ASSERT_EQUAL_INT16(packetTempRaw(driverTemperature(rtd, RNOMINAL, RREF)), fixed);
+  }
+}
+
+// The integer humidity is the correctly rounded value of the formula. The float code it replaced is the same,
+// except within HUMIDITY_FLOAT_ERROR of the point between two packet values, where its own rounding can put it
+// one unit (0.5 %RH) off.
+#define HUMIDITY_FLOAT_ERROR 1e-5 // %RH
+
+void test_humidity_matches_float(void)
+{
+  uint32_t differing = 0;
+  for (uint32_t i = 0; i < 200000; i++)
+  {
+    uint32_t f_cal = 20000 + nextRandom(40000);
+    uint32_t f_RH = f_cal * (60 + nextRandom(60)) / 100; // sensor around the reference capacitance
+    int16_t temperature = packetTempRaw(-90.0f + nextRandom(12000) / 100.0f);
+    int32_t previous = nextRandom(125000);
+
+    uint8_t fixed = formatHumidity(f_cal, f_RH, temperature, previous);
+    TEST_ASSERT_EQUAL_UINT8(exactHumidityFormatted(f_cal, f_RH, temperature, previous), fixed);
+
+    uint8_t reference = floatHumidityFormatted(floatHumidity(f_cal, f_RH, temperature, previous / 1000.0f));
+    if (fixed != reference)
+    {
+      TEST_ASSERT_INT_WITHIN(1, reference, fixed);
+      TEST_ASSERT_TRUE(roundingDistance(f_cal, f_RH, temperature, previous) < HUMIDITY_FLOAT_ERROR);
+      differing++;
+    }
+  }
+  printf("humidity: %u of 200000 samples one unit off the float code\n", (unsigned)differing);
+}
+
+void test_humidity_milli(void)
+{
+  uint32_t samples = 0;
+  for (uint32_t i = 0; i < 200000; i++)
+  {
+    uint32_t f_cal = 20000 + nextRandom(40000);
+    uint32_t f_RH = f_cal * (60 + nextRandom(60)) / 100;
+    int16_t temperature = packetTempRaw(-90.0f + nextRandom(12000) / 100.0f);
+    int32_t previous = humidityMilli(f_cal, f_RH, temperature, nextRandom(125000)); // fed back like getHumidityFormatted() does
+
+    TEST_ASSERT_EQUAL_INT32(exactHumidityMilli(f_cal, f_RH, temperature, previous), humidityMilli(f_cal, f_RH, temperature, previous));
+    samples += previous < 0; // the feedback also takes negative values
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(0, samples);
+}
+
+void test_humidity_limits(void)
+{ // at 30 C there is no compensation, RH = (107 pF * f_cal / f_RH - 130 pF) / 0.4104 pF
+  int16_t t30 = packetTempRaw(30);
+  TEST_ASSERT_EQUAL_UINT8(0, formatHumidity(130, 107, t30, 0));        // 0 %
+  TEST_ASSERT_EQUAL_UINT8(0, formatHumidity(129999, 107000, t30, 0));  // just below
+  TEST_ASSERT_EQUAL_UINT8(0, formatHumidity(1301025, 1070000, t30, 0)); // just below 0.25 %
+  TEST_ASSERT_EQUAL_UINT8(1, formatHumidity(1301026, 1070000, t30, 0)); // 0.25 % rounds up, like packetRhRaw()
+  TEST_ASSERT_EQUAL_UINT8(250, formatHumidity(1813, 1070, t30, 0));    // 125 %
+  TEST_ASSERT_EQUAL_UINT8(252, formatHumidity(1813001, 1070000, t30, 0)); // just above
+  TEST_ASSERT_EQUAL_INT32(1, humidityMilli(1300002052, 1070000000, t30, 0));  // 0.0005 % rounds away from zero
+  TEST_ASSERT_EQUAL_INT32(-1, humidityMilli(1299997948, 1070000000, t30, 0)); // so does -0.0005 %
+  TEST_ASSERT_EQUAL_INT32(0, humidityMilli(1299997949, 1070000000, t30, 0));
+}
+
+void test_humidity_extreme_inputs(void)
+{ // no intermediate overflows for any frequency the capture can return
+  const uint32_t frequencies[][2] = {{UINT32_MAX, 1}, {1, UINT32_MAX}, {UINT32_MAX, UINT32_MAX}, {2000, 1000}};
+  const int16_t temperatures[] = {INT16_MIN, packetTempRaw(-90), INT16_MAX};
+  const int32_t previous[] = {-5000000, 0, 125000, 5000000};
+  for (const uint32_t *f : frequencies)
+    for (int16_t temperature : temperatures)
+      for (int32_t last : previous)
+      {
+        TEST_ASSERT_EQUAL_UINT8(exactHumidityFormatted(f[0], f[1], temperature, last), formatHumidity(f[0], f[1], temperature, last));
+        if (f[1] > 1) // the milli value itself only fits for a sensible capacity ratio
+          TEST_ASSERT_EQUAL_INT32(exactHumidityMilli(f[0], f[1], temperature, last), humidityMilli(f[0], f[1], temperature, last));
+      }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_rtd_table_matches_driver);
+  RUN_TEST(test_rtd_outside_table);
+  RUN_TEST(test_rtd_around_zero);
+  RUN_TEST(test_humidity_matches_float);
+  RUN_TEST(test_humidity_milli);
+  RUN_TEST(test_humidity_limits);
+  RUN_TEST(test_humidity_extreme_inputs);
+  return UNITY_END();
+}
@@ -0,0 +1,309 @@
+// Host run of the whole firmware on the simulated hardware in test/shims: pio test -e native -v prints the
+// timings. A flight CSV downloaded from the server is replayed as 1 Hz NAV-PVT messages and sensor readings,
+// and every frame the tracker sends is decoded like a receiver would and compared to the flight. Set
+// RESONDE_FLIGHT_CSV to replay another one than the short flight in Firmware/test_data.
+#include <unity.h>
+#include <chrono>
+#include "host_hal.h"
+#include "flight_csv.h"
+#include "frame.h"
+#include "gnss.h"
+#include "settings.h"
+
+#define MAX_FLIGHT_PACKETS 20000
+#define FLIGHT_START 1000     // simNow() of the first epoch, setup() is done by then
+#define PVT_OUTPUT_DELAY 14   // ms after the epoch the module starts sending NAV-PVT, parsed about 40 ms after it
+#define SENSOR_UPDATE 500     // ms after the epoch the sensors move on to the values of the next one
+#define GPS_UNIX_OFFSET 315964800UL // unix time of the start of GPS week 0
+#define GPS_LEAP_SECONDS 18
+#define MAX_FRAMES 4000
+
+void setup(); // src/main.cpp
+void loop();
+
+struct SentFrame {
+  FrameType type;
+  FlightPhase phase;
+  size_t length;
+  uint32_t airtime;  // ms
+  uint32_t latency;  // ms from the NAV-PVT to the start of the transmission
+  FrameResult result;
+  Packet packet;
+};
+
+struct FlightRun {
+  uint16_t rows;     // CSV rows
+  uint32_t epochs;   // NAV-PVT messages sent
+  uint16_t frames;
+  uint64_t loopNs, pvtNs, txNs; // host time in loop(), all calls and the ones that parsed a NAV-PVT or started a frame
+  uint32_t loops, pvtLoops, txLoops;
+  uint32_t pvtMaxNs, txMaxNs;
+};
+
+static Packet flight[MAX_FLIGHT_PACKETS];
+static SentFrame sent[MAX_FRAMES];
+static FlightRun run;
+static bool transmittedInLoop = false;
+
+// ---- the flight ----- //
+
+static int32_t interpolate(int32_t a, int32_t b, uint32_t at, uint32_t from, uint32_t to) {
+  return to == from ? a : a + (int32_t)((int64_t)(b - a) * (int32_t)(at - from) / (int32_t)(to - from));
+}
+
+static Packet flightAt(uint32_t time) { // the CSV rows are 1 to 30 s apart, the GNSS sees a straight line in between
+  uint16_t i = 1;
+  while (i + 1 < run.rows && flight[i].time < time) {
+    i++;
+  }
+  const Packet &a = flight[i - 1], &b = flight[i];
+  Packet p = a;
+  p.time = time;
+  p.lat = interpolate(a.lat, b.lat, time, a.time, b.time);
+  p.lon = interpolate(a.lon, b.lon, time, a.time, b.time);
+  p.alt = interpolate(a.alt, b.alt, time, a.time, b.time);
+  p.vSpeed = interpolate(a.vSpeed, b.vSpeed, time, a.time, b.time);
+  p.eSpeed = interpolate(a.eSpeed, b.eSpeed, time, a.time, b.time);
+  p.nSpeed = interpolate(a.nSpeed, b.nSpeed, time, a.time, b.time);
+  p.temp = interpolate(a.temp, b.temp, time, a.time, b.time);
+  p.rh = interpolate(a.rh, b.rh, time, a.time, b.time);
+  return p;
+}
+
+static void put32(uint8_t *p, uint32_t value) {
+  for (uint8_t i = 0; i < 4; i++) {
+    p[i] = value >> (8 * i);
+  }
+}
+
+static size_t navPvt(const Packet &fix, uint8_t *out) { // UBX-NAV-PVT as the MAX-M10S sends it
+  uint8_t *p = out + 6;
+  memset(out, 0, 8 + 92);
+  out[0] = 0xB5;
+  out[1] = 0x62;
+  out[2] = 0x01;
+  out[3] = 0x07;
+  out[4] = 92;
+  time_t seconds = fix.time;
+  struct tm utc;
+  gmtime_r(&seconds, &utc);
+  put32(p + 0, (uint32_t)((fix.time - GPS_UNIX_OFFSET + GPS_LEAP_SECONDS) % 604800) * 1000);
+  p[4] = (utc.tm_year + 1900) & 0xFF;
+  p[5] = (utc.tm_year + 1900) >> 8;
+  p[6] = utc.tm_mon + 1;
+  p[7] = utc.tm_mday;
+  p[8] = utc.tm_hour;
+  p[9] = utc.tm_min;
+  p[10] = utc.tm_sec;
+  p[11] = 0x07; // date, time and fully resolved
+  p[20] = 3;    // 3D fix
+  p[21] = 0x01; // gnssFixOK
+  p[23] = fix.sats;
+  put32(p + 24, fix.lon);
+  put32(p + 28, fix.lat);
+  put32(p + 32, fix.alt + 47000); // ellipsoid, about 47 m above the geoid in central Europe
+  put32(p + 36, fix.alt);
+  put32(p + 48, fix.nSpeed * 10);
+  put32(p + 52, fix.eSpeed * 10);
+  put32(p + 56, fix.vSpeed * -10);
+  uint8_t a = 0, b = 0;
+  for (uint8_t i = 2; i < 6 + 92; i++) {
+    a += out[i];
+    b += a;
+  }
+  out[6 + 92] = a;
+  out[7 + 92] = b;
+  return 8 + 92;
+}
+
+static void setSensors(const Packet &at) {
+  simSetTemperature(packetTempCelsius(at.temp));
+  simSetHumidity(packetRhPercent(at.rh));
+  simSetBattery(packetBatteryMillivolts(at.battery));
+}
+
+static void tick(uint32_t now) {
+  if (now < FLIGHT_START) {
+    return;
+  }
+  uint32_t epoch = (now - FLIGHT_START) / 1000, ms = (now - FLIGHT_START) % 1000;
+  if (epoch >= run.epochs) {
+    return;
+  }
+  if (ms == PVT_OUTPUT_DELAY) {
+    uint8_t message[100];
+    simGnssSend(message, navPvt(flightAt(flight[0].time + epoch), message));
+  } else if (ms == SENSOR_UPDATE) {
+    setSensors(flightAt(flight[0].time + epoch + 1)); // sampled ahead of the next epoch
+  }
+}
+
+// ---- a receiver ----- //
+
+static Packet key, last;
+static bool haveKey = false;
+
+static void transmitted(const SimFrame &frame) {
+  transmittedInLoop = true;
+  if (run.frames == MAX_FRAMES) {
+    return;
+  }
+  SentFrame &s = sent[run.frames++];
+  s.type = frameType(frame.data, frame.length);
+  s.phase = framePhase(frame.data, frame.length);
+  s.length = frame.length;
+  s.airtime = frame.airtime;
+  s.latency = millis() - gnssFix.received;
+  if (s.type == FRAME_PROFILE) {
+    s.result = decodeProfileFrame(frame.data, frame.length, &last, s.packet);
+  } else {
+    bool isKey;
+    s.result = decodeFrame(frame.data, frame.length, haveKey ? &key : nullptr, s.packet, isKey);
+    if (s.result == FRAME_OK && isKey) {
+      key = s.packet;
+      haveKey = true;
+    }
+  }
+  if (s.result == FRAME_OK) {
+    last = s.packet;
+  }
+}
+
+static uint32_t nanoseconds() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const FlightRun &flightRun() { // the firmware cannot start over, so all tests look at the same run
+  static bool done = false;
+  if (done) {
+    return run;
+  }
+  done = true;
+  const char *path = getenv("RESONDE_FLIGHT_CSV");
+  run.rows = readFlightCsv(path != nullptr ? path : FLIGHT_CSV, SERIAL_NUMBER, flight, MAX_FLIGHT_PACKETS);
+  if (run.rows < 2) {
+    return run;
+  }
+  run.epochs = flight[run.rows - 1].time - flight[0].time + 1;
+
+  simOnTick(tick);
+  simOnTransmit(transmitted);
+  setSensors(flight[0]);
+  setup();
+  while (simNow() < FLIGHT_START + run.epochs * 1000 + 2000) {
+    uint32_t fix = gnssFix.received;
+    transmittedInLoop = false;
+    uint32_t started = nanoseconds();
+    loop();
+    uint32_t ns = nanoseconds() - started;
+    run.loopNs += ns;
+    run.loops++;
+    if (gnssFix.received != fix) {
+      run.pvtNs += ns;
+      run.pvtLoops++;
+      run.pvtMaxNs = ns > run.pvtMaxNs ? ns : run.pvtMaxNs;
+    }
+    if (transmittedInLoop) {
+      run.txNs += ns;
+      run.txLoops++;
+      run.txMaxNs = ns > run.txMaxNs ? ns : run.txMaxNs;
+    }
+  }
+
+  uint32_t bytes = 0, airtime = 0, latency = 0, latencyMax = 0, perPhase[3] = {};
+  for (uint16_t i = 0; i < run.frames; i++) {
+    bytes += sent[i].length;
+    airtime += sent[i].airtime;
+    latency += sent[i].latency;
+    latencyMax = sent[i].latency > latencyMax ? sent[i].latency : latencyMax;
+    perPhase[sent[i].phase]++;
+  }
+  const SimStats &stats = simStats();
+  printf("[simulation] %u epochs, frames: %u (ascent %u, descent %u, landed %u), avg bytes: %.2f, airtime: %u ms\n",
+         (unsigned)run.epochs, (unsigned)run.frames, (unsigned)perPhase[PHASE_ASCENT], (unsigned)perPhase[PHASE_DESCENT],
+         (unsigned)perPhase[PHASE_LANDED], (float)bytes / run.frames, (unsigned)airtime);
+  printf("[simulation] NAV-PVT to TX latency avg/max ms: %u/%u, Stop2 share: %.1f%%\n", (unsigned)(latency / run.frames),
+         (unsigned)latencyMax, 100.0f * stats.stop2Ms / simNow());
+  printf("[simulation] host ns per loop(), NAV-PVT avg/max: %u/%u, TX start avg/max: %u/%u, all avg: %u\n",
+         (unsigned)(run.pvtNs / run.pvtLoops), (unsigned)run.pvtMaxNs, (unsigned)(run.txNs / run.txLoops),
+         (unsigned)run.txMaxNs, (unsigned)(run.loopNs / run.loops));
+  return run;
+}
+
+// ---- tests ----- //
+
+void test_frames_match_the_flight(void) {
+  const FlightRun &flightRun = ::flightRun();
+  if (flightRun.rows < 2) {
+    TEST_IGNORE_MESSAGE("no flight CSV, run from the project directory or set RESONDE_FLIGHT_CSV");
+  }
+  TEST_ASSERT_GREATER_THAN_UINT16(0, flightRun.frames);
+  for (uint16_t i = 0; i < flightRun.frames; i++) {
+    const SentFrame &s = sent[i];
+    TEST_ASSERT_EQUAL_INT8(FRAME_OK, s.result);
+    TEST_ASSERT_EQUAL_UINT16(i + 1, s.packet.counter); // every regular frame, nothing was resent
+    TEST_ASSERT_LESS_THAN_UINT32(NAV_PERIOD, s.latency);
+
+    Packet expected = flightAt(s.packet.time);
+    TEST_ASSERT_UINT32_WITHIN(1, expected.time, s.packet.time);
+    // the state filter lags the flight, most right after the burst, where the CSV goes from 5 m/s up to 15 m/s
+    // down from one row to the next
+    TEST_ASSERT_INT32_WITHIN(900, expected.lat, s.packet.lat); // 10 m
+    TEST_ASSERT_INT32_WITHIN(1450, expected.lon, s.packet.lon);
+    TEST_ASSERT_INT32_WITHIN(20 * PACKET_ALT_SCALE, expected.alt, s.packet.alt);
+    TEST_ASSERT_INT32_WITHIN(10 * PACKET_SPEED_SCALE, expected.vSpeed, s.packet.vSpeed);
+    TEST_ASSERT_INT32_WITHIN(1 * PACKET_SPEED_SCALE, expected.eSpeed, s.packet.eSpeed);
+    if (s.phase == PHASE_ASCENT) { // PTU is only sampled during the ascent
+      TEST_ASSERT_INT16_WITHIN(packetTempRaw(0.05), expected.temp, s.packet.temp); // the RTD resolution is 0.03 C
+      TEST_ASSERT_UINT8_WITHIN(packetRhRaw(5), expected.rh, s.packet.rh);
+      TEST_ASSERT_UINT8_WITHIN(1, expected.battery, s.packet.battery);
+    }
+  }
+}
+
+void test_flight_phases(void) {
+  const FlightRun &flightRun = ::flightRun();
+  if (flightRun.rows < 2) {
+    TEST_IGNORE_MESSAGE("no flight CSV, run from the project directory or set RESONDE_FLIGHT_CSV");
+  }
+  uint32_t previous = 0;
+  for (uint16_t i = 0; i < flightRun.frames; i++) {
+    const SentFrame &s = sent[i];
+    if (i > 0) {
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT8(sent[i - 1].phase, s.phase); // never goes back
+      if (s.phase == sent[i - 1].phase) { // the frame interval of the phase
+        uint32_t interval = s.phase == PHASE_ASCENT ? TX_DIVIDER : s.phase == PHASE_DESCENT ? 1 : LANDED_BEACON_EPOCHS;
+        TEST_ASSERT_EQUAL_UINT32(interval, s.packet.time - previous);
+      }
+    }
+    if (s.phase == PHASE_LANDED) {
+      TEST_ASSERT_EQUAL_UINT8(FRAME_PROFILE, s.type);
+    }
+    previous = s.packet.time;
+  }
+  TEST_ASSERT_EQUAL_UINT8(PHASE_LANDED, sent[flightRun.frames - 1].phase);
+}
+
+void test_hardware_used_correctly(void) {
+  if (::flightRun().rows < 2) {
+    TEST_IGNORE_MESSAGE("no flight CSV, run from the project directory or set RESONDE_FLIGHT_CSV");
+  }
+  const SimStats &stats = simStats();
+  TEST_ASSERT_EQUAL_UINT32(0, stats.gnssBytesLost); // Stop2 always ended before the NAV-PVT
+  TEST_ASSERT_EQUAL_UINT32(0, stats.captureStalls);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.rtdEarlyReads);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.flashErrors);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, stats.stop2Ms);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_frames_match_the_flight);
+  RUN_TEST(test_flight_phases);
+  RUN_TEST(test_hardware_used_correctly);
+  return UNITY_END();
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+// Channel plan shared by trackers and receivers, both need the same list. With more than one channel a
+// tracker hops with every regular frame, on a sequence derived from its serial number and packet counter,
+// so sondes spread over the band and a receiver that heard one frame knows where the next one will be.
+// The NACK exchange, parity and burst frames stay on the channel of the frame they follow.
+// A receiver that lost the sonde scans all channels with CAD on the fallback profile until it hears a
+// keyframe preamble, see rx_queue.h.
+static const float channels[] = {
+  434.6, // MHz, the original fixed frequency. Add more, e.g. 434.4 and 434.8, to hop
+};
+
+#define CHANNEL_COUNT ((uint8_t)(sizeof(channels) / sizeof(channels[0])))
+
+static_assert(CHANNEL_COUNT >= 1 && CHANNEL_COUNT <= 16, "1 to 16 channels");
+
+constexpr uint8_t frameChannel(uint16_t sn, uint16_t counter) {
+  // consecutive serial numbers start on different channels, so sondes launched together rarely collide
+  return (uint8_t)((uint16_t)(sn + counter) % CHANNEL_COUNT);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+
+// LoRa data rate profiles for the adaptive scheduler. Every frame header announces the profile of
+// the sonde's next frame (see FRAME_RATE_MASK), so a receiver retunes right after each frame.
+// Profile 0 is the fallback: keyframes always go out on it, and a receiver that lost track goes
+// back to it, so it can lock on again at the latest with the next keyframe.
+struct DataRate {
+  uint8_t sf;     // spreading factor
+  float bw;       // bandwidth in kHz
+  int8_t power;   // tracker output power in dBm
+  uint32_t range; // m, longest slant range from the launch site this profile is used for
+};
+
+static const DataRate dataRates[] = {
+  {9, 62.5, 10, UINT32_MAX}, // fallback, the original fixed setting
+  {8, 125.0, 10, 60000},
+  {7, 125.0, 10, 20000},
+  {7, 250.0, 4, 5000},       // close to the launch site, the link margin is huge
+};
+
+#define DATA_RATE_COUNT ((uint8_t)(sizeof(dataRates) / sizeof(dataRates[0])))
+#define DATA_RATE_FALLBACK 0
+#define DATA_RATE_TIMEOUT_FRAMES 3 // frame intervals without a frame before a receiver goes back to the fallback
+
+static_assert(DATA_RATE_COUNT <= 4, "the frame header only has two bits for the data rate");
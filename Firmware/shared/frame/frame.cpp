@@ -0,0 +1,371 @@
+#include "frame.h"
+#include <string.h>
+
+#define FRAME_MAX_DT 0xFFFF // 0.1 s, deltas further away from their keyframe are not worth predicting
+
+// ---- varint helpers ----- //
+
+static uint8_t *putVarint(uint8_t *out, uint32_t value) {
+  while (value >= 0x80) {
+    *out++ = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  *out++ = value;
+  return out;
+}
+
+static uint8_t *putSigned(uint8_t *out, int32_t value) {
+  return putVarint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31)); // zigzag, small magnitudes stay small
+}
+
+static bool getVarint(const uint8_t *&in, const uint8_t *end, uint32_t &value) {
+  value = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (in >= end) {
+      return false;
+    }
+    uint8_t byte = *in++;
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool getSigned(const uint8_t *&in, const uint8_t *end, int32_t &value) {
+  uint32_t raw;
+  if (!getVarint(in, end, raw)) {
+    return false;
+  }
+  value = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 1);
+  return true;
+}
+
+// ---- predictor ----- //
+
+// cos(latitude) in Q15 for every whole degree, keeps the longitude prediction in integer math
+static const uint16_t cosQ15[91] = {
+  32768, 32763, 32748, 32723, 32688, 32643, 32588, 32524, 32449, 32365, 32270, 32166, 32052, 31928, 31795,
+  31651, 31499, 31336, 31164, 30983, 30792, 30592, 30382, 30163, 29935, 29698, 29452, 29197, 28932, 28660,
+  28378, 28088, 27789, 27482, 27166, 26842, 26510, 26170, 25822, 25466, 25102, 24730, 24351, 23965, 23571,
+  23170, 22763, 22348, 21926, 21498, 21063, 20622, 20174, 19720, 19261, 18795, 18324, 17847, 17364, 16877,
+  16384, 15886, 15384, 14876, 14365, 13848, 13328, 12803, 12275, 11743, 11207, 10668, 10126, 9580, 9032,
+  8481, 7927, 7371, 6813, 6252, 5690, 5126, 4560, 3993, 3425, 2856, 2286, 1715, 1144, 572, 0,
+};
+
+struct Prediction {
+  int32_t lat;
+  int32_t lon;
+  int32_t alt;
+};
+
+static Prediction predict(const Packet &key, uint32_t dt) { // dt in 0.1 s
+  // speeds are cm/s, so speed * dt is in mm. 1 mm north is 0.08983 e-7 degrees of latitude.
+  int64_t north = (int64_t)key.nSpeed * dt;
+  int64_t east = (int64_t)key.eSpeed * dt;
+  uint8_t latDegrees = (key.lat < 0 ? -(int64_t)key.lat : key.lat) / 10000000;
+  uint16_t cosLat = cosQ15[latDegrees > 89 ? 89 : latDegrees];
+
+  Prediction p;
+  p.lat = (int32_t)(key.lat + north * 8983 / 100000);
+  p.lon = (int32_t)(key.lon + east * 8983 * 32768 / ((int64_t)cosLat * 100000));
+  p.alt = (int32_t)(key.alt + (int64_t)key.vSpeed * dt);
+  return p;
+}
+
+// ---- encoder ----- //
+
+static size_t encodeKey(const Packet &packet, uint8_t *out) {
+  out[0] = FRAME_KEY;
+  memcpy(out + 1, &packet, sizeof(Packet));
+  out[1 + sizeof(Packet)] = PACKET_SCHEMA_VERSION;
+  return 2 + sizeof(Packet);
+}
+
+static size_t encodeDelta(const Packet &key, const Packet &packet, uint8_t keyAge, uint32_t dt, uint8_t *out) {
+  Prediction p = predict(key, dt);
+  uint8_t *o = out;
+
+  *o++ = FRAME_DELTA;
+  memcpy(o, &packet.SN, sizeof(packet.SN)); o += sizeof(packet.SN);
+  memcpy(o, &packet.counter, sizeof(packet.counter)); o += sizeof(packet.counter);
+  *o++ = keyAge;
+  o = putVarint(o, dt);
+  o = putSigned(o, (int32_t)(packet.time - key.time));
+  o = putSigned(o, (int32_t)((uint32_t)packet.lat - (uint32_t)p.lat));
+  o = putSigned(o, (int32_t)((uint32_t)packet.lon - (uint32_t)p.lon));
+  o = putSigned(o, (int32_t)((uint32_t)packet.alt - (uint32_t)p.alt));
+  o = putSigned(o, packet.vSpeed - key.vSpeed);
+  o = putSigned(o, packet.eSpeed - key.eSpeed);
+  o = putSigned(o, packet.nSpeed - key.nSpeed);
+  *o++ = packet.sats;
+  o = putSigned(o, packet.temp - key.temp);
+  *o++ = packet.rh;
+  *o++ = packet.battery;
+  return o - out;
+}
+
+size_t encodeFrame(FrameEncoder &encoder, const Packet &packet, uint32_t now, uint8_t keyInterval, uint8_t *out) {
+  uint16_t keyAge = packet.counter - encoder.key.counter;
+  uint32_t dt = (now - encoder.keyMillis) / 100;
+
+  if (encoder.haveKey && encoder.sinceKey + 1 < keyInterval && keyAge > 0 && keyAge <= 0xFF && dt <= FRAME_MAX_DT && packet.SN == encoder.key.SN) {
+    uint8_t delta[FRAME_MAX_LENGTH + 16]; // worst case delta can be longer than a keyframe
+    size_t length = encodeDelta(encoder.key, packet, keyAge, dt, delta);
+    if (length < sizeof(Packet)) { // a bare Packet length would be taken for an old style keyframe
+      memcpy(out, delta, length);
+      encoder.sinceKey++;
+      return length;
+    }
+  }
+
+  encoder.key = packet;
+  encoder.keyMillis = now;
+  encoder.sinceKey = 0;
+  encoder.haveKey = true;
+  return encodeKey(packet, out);
+}
+
+bool nextFrameIsKey(const FrameEncoder &encoder, uint8_t keyInterval) {
+  return !encoder.haveKey || encoder.sinceKey + 1 >= keyInterval;
+}
+
+void forceKeyframe(FrameEncoder &encoder) {
+  encoder.haveKey = false;
+}
+
+// ---- decoder ----- //
+
+size_t encodeBurstFrame(const Packet &packet, uint8_t *out) {
+  out[0] = FRAME_BURST;
+  memcpy(out + 1, &packet, sizeof(Packet));
+  return 1 + sizeof(Packet);
+}
+
+size_t encodeNack(uint16_t sn, uint16_t first, uint8_t count, uint8_t *out) {
+  out[0] = FRAME_NACK;
+  memcpy(out + 1, &sn, sizeof(sn));
+  memcpy(out + 3, &first, sizeof(first));
+  out[5] = count;
+  return FRAME_NACK_LENGTH;
+}
+
+bool decodeNack(const uint8_t *frame, size_t length, uint16_t &sn, uint16_t &first, uint8_t &count) {
+  if (length != FRAME_NACK_LENGTH || (frame[0] & FRAME_TYPE_MASK) != FRAME_NACK) {
+    return false;
+  }
+  memcpy(&sn, frame + 1, sizeof(sn));
+  memcpy(&first, frame + 3, sizeof(first));
+  count = frame[5];
+  return true;
+}
+
+static_assert(offsetof(Packet, SN) == 0 && offsetof(Packet, counter) == 2, "parity skips SN and counter at the start of the packet");
+
+void parityAdd(uint8_t *parity, const Packet &packet) {
+  const uint8_t *bytes = (const uint8_t *)&packet + 4;
+  for (size_t i = 0; i < FRAME_PARITY_BYTES; i++) {
+    parity[i] ^= bytes[i];
+  }
+}
+
+size_t encodeParityFrame(uint16_t sn, uint16_t first, uint8_t count, const uint8_t *parity, uint8_t *out) {
+  out[0] = FRAME_PARITY | (count - 1) << FRAME_PARITY_SHIFT;
+  memcpy(out + 1, &sn, sizeof(sn));
+  memcpy(out + 3, &first, sizeof(first));
+  memcpy(out + 5, parity, FRAME_PARITY_BYTES);
+  return 5 + FRAME_PARITY_BYTES;
+}
+
+bool decodeParityFrame(const uint8_t *frame, size_t length, uint16_t &sn, uint16_t &first, uint8_t &count, const uint8_t *&parity) {
+  if (length != 5 + FRAME_PARITY_BYTES || (frame[0] & FRAME_TYPE_MASK) != FRAME_PARITY) {
+    return false;
+  }
+  count = (frame[0] >> FRAME_PARITY_SHIFT) + 1;
+  memcpy(&sn, frame + 1, sizeof(sn));
+  memcpy(&first, frame + 3, sizeof(first));
+  parity = frame + 5;
+  return true;
+}
+
+#define PROFILE_TO(name) p.name = packet.name;
+#define PROFILE_FROM(name) packet.name = p.name;
+
+size_t encodeProfileFrame(uint8_t profile, const Packet &packet, uint8_t *out) {
+  out[0] = FRAME_PROFILE;
+  memcpy(out + 1, &packet.SN, sizeof(packet.SN));
+  out[3] = profile;
+  switch (profile) {
+#define PROFILE_ENCODE(id, name, fields)                                      \
+    case id: {                                                                \
+      name##Profile p;                                                        \
+      fields(PROFILE_TO)                                                      \
+      memcpy(out + 4, (const uint8_t *)&p + sizeof(p.SN), sizeof(p) - sizeof(p.SN)); \
+      return 4 + sizeof(p) - sizeof(p.SN);                                    \
+    }
+    PACKET_PROFILES(PROFILE_ENCODE)
+#undef PROFILE_ENCODE
+    default:
+      return 0;
+  }
+}
+
+FrameResult decodeProfileFrame(const uint8_t *frame, size_t length, const Packet *base, Packet &out) {
+  if (length < 4 || (frame[0] & FRAME_TYPE_MASK) != FRAME_PROFILE) {
+    return FRAME_INVALID;
+  }
+  Packet packet;
+  if (base != nullptr) {
+    packet = *base;
+  } else {
+    memset(&packet, 0, sizeof(packet));
+  }
+
+  switch (frame[3]) {
+#define PROFILE_DECODE(id, name, fields)                                      \
+    case id: {                                                                \
+      name##Profile p;                                                        \
+      if (length != 4 + sizeof(p) - sizeof(p.SN)) {                           \
+        return FRAME_INVALID;                                                 \
+      }                                                                       \
+      memcpy(&p.SN, frame + 1, sizeof(p.SN));                                 \
+      memcpy((uint8_t *)&p + sizeof(p.SN), frame + 4, sizeof(p) - sizeof(p.SN)); \
+      fields(PROFILE_FROM)                                                    \
+      break;                                                                  \
+    }
+    PACKET_PROFILES(PROFILE_DECODE)
+#undef PROFILE_DECODE
+    default:
+      return FRAME_INVALID; // from a newer tracker
+  }
+
+  out = packet;
+  return FRAME_OK;
+}
+
+#undef PROFILE_FROM
+#undef PROFILE_TO
+
+FrameType frameType(const uint8_t *frame, size_t length) {
+  if (length == sizeof(Packet)) {
+    return FRAME_KEY; // bare packet from an old tracker
+  }
+  if (length == 0) {
+    return (FrameType)0;
+  }
+  return (FrameType)(frame[0] & FRAME_TYPE_MASK);
+}
+
+uint8_t frameNextRate(const uint8_t *frame, size_t length) {
+  if (length == sizeof(Packet) || length == 0) {
+    return 0; // old trackers have no header and never change the data rate
+  }
+  return (frame[0] & FRAME_RATE_MASK) >> FRAME_RATE_SHIFT;
+}
+
+FlightPhase framePhase(const uint8_t *frame, size_t length) {
+  switch (frameType(frame, length)) {
+    case FRAME_KEY:
+    case FRAME_DELTA:
+    case FRAME_BURST:
+    case FRAME_PROFILE:
+      if (length == sizeof(Packet)) {
+        return PHASE_ASCENT; // bare packet from an old tracker
+      }
+      return (frame[0] >> FRAME_PHASE_SHIFT) <= PHASE_LANDED ? (FlightPhase)(frame[0] >> FRAME_PHASE_SHIFT) : PHASE_ASCENT;
+    default:
+      return PHASE_ASCENT; // parity frames use the bits for the group size
+  }
+}
+
+bool frameSerialNumber(const uint8_t *frame, size_t length, uint16_t &sn) {
+  if (length == sizeof(Packet)) { // bare packet from an old tracker
+    memcpy(&sn, frame, sizeof(sn));
+    return true;
+  }
+  if (length < 1 + sizeof(sn)) {
+    return false;
+  }
+  memcpy(&sn, frame + 1, sizeof(sn)); // SN directly follows the header in every frame type
+  return true;
+}
+
+static FrameResult decodeDelta(const uint8_t *frame, size_t length, const Packet *key, Packet &out) {
+  const uint8_t *in = frame + 1;
+  const uint8_t *end = frame + length;
+  if (length < 6) {
+    return FRAME_INVALID;
+  }
+
+  Packet packet;
+  memcpy(&packet.SN, in, sizeof(packet.SN)); in += sizeof(packet.SN);
+  memcpy(&packet.counter, in, sizeof(packet.counter)); in += sizeof(packet.counter);
+  uint8_t keyAge = *in++;
+
+  if (key == nullptr || key->SN != packet.SN || (uint16_t)(packet.counter - key->counter) != keyAge) {
+    return FRAME_NEED_KEY;
+  }
+
+  uint32_t dt;
+  int32_t time, lat, lon, alt, vSpeed, eSpeed, nSpeed, temp;
+  if (!getVarint(in, end, dt) || dt > FRAME_MAX_DT || !getSigned(in, end, time) || !getSigned(in, end, lat) || !getSigned(in, end, lon) ||
+      !getSigned(in, end, alt) || !getSigned(in, end, vSpeed) || !getSigned(in, end, eSpeed) || !getSigned(in, end, nSpeed) ||
+      in >= end) {
+    return FRAME_INVALID;
+  }
+  packet.sats = *in++;
+  if (!getSigned(in, end, temp) || end - in != 2) {
+    return FRAME_INVALID;
+  }
+  packet.rh = *in++;
+  packet.battery = *in++;
+
+  Prediction p = predict(*key, dt);
+  packet.time = key->time + time;
+  packet.lat = (int32_t)((uint32_t)p.lat + (uint32_t)lat);
+  packet.lon = (int32_t)((uint32_t)p.lon + (uint32_t)lon);
+  packet.alt = (int32_t)((uint32_t)p.alt + (uint32_t)alt);
+  packet.vSpeed = key->vSpeed + vSpeed;
+  packet.eSpeed = key->eSpeed + eSpeed;
+  packet.nSpeed = key->nSpeed + nSpeed;
+  packet.temp = key->temp + temp;
+
+  out = packet;
+  return FRAME_OK;
+}
+
+FrameResult decodeFrame(const uint8_t *frame, size_t length, const Packet *key, Packet &out, bool &isKey) {
+  isKey = false;
+  if (length == sizeof(Packet)) { // bare packet from an old tracker
+    memcpy(&out, frame, sizeof(Packet));
+    isKey = true;
+    return FRAME_OK;
+  }
+  if (length == 0) {
+    return FRAME_INVALID;
+  }
+
+  switch (frame[0] & FRAME_TYPE_MASK) {
+    case FRAME_KEY:
+      if (length != 1 + sizeof(Packet) && length != 2 + sizeof(Packet)) {
+        return FRAME_INVALID;
+      }
+      if (length == 2 + sizeof(Packet) && frame[1 + sizeof(Packet)] != PACKET_SCHEMA_VERSION) {
+        return FRAME_OTHER_SCHEMA; // the fields would be misread, and so would the deltas against it
+      }
+      memcpy(&out, frame + 1, sizeof(Packet));
+      isKey = true;
+      return FRAME_OK;
+    case FRAME_BURST: // complete packet, but older than the sonde's current keyframe
+      if (length != 1 + sizeof(Packet)) {
+        return FRAME_INVALID;
+      }
+      memcpy(&out, frame + 1, sizeof(Packet));
+      return FRAME_OK;
+    case FRAME_DELTA:
+      return decodeDelta(frame, length, key, out);
+    default:
+      return FRAME_INVALID;
+  }
+}
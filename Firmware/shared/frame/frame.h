@@ -0,0 +1,86 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "packet.h"
+
+// Over the air frame format shared by the Tracker and the Receiver.
+// Every frame starts with a header byte whose low nibble is the FrameType. Bits 4-5 announce the
+// data rate profile (see datarate.h) of the sonde's next frame. Bits 6-7 carry the sonde's FlightPhase
+// in key, delta, burst and profile frames.
+//
+// FRAME_KEY:   header, Packet, PACKET_SCHEMA_VERSION (u8)               (33 bytes)
+// FRAME_DELTA: header, SN (u16), counter (u16), key age (u8), dt (varint, 0.1 s since the keyframe),
+//              then zigzag varint residuals for time, lat, lon, alt, vSpeed, eSpeed, nSpeed,
+//              sats (u8), temp (zigzag varint), rh (u8), battery (u8)
+// FRAME_BURST: header, Packet, an older packet resent from the Tracker's flash log    (32 bytes)
+// FRAME_NACK:  header, SN (u16), first counter (u16), count (u8), Receiver to Tracker (6 bytes)
+// FRAME_PARITY: header, SN (u16), first counter (u16), XOR of the group's packets without SN and counter
+//              (32 bytes). Bits 6-7 of the header hold the group size - 1. A receiver that got all packets
+//              of the group but one rebuilds that one from the others.
+// FRAME_PROFILE: header, SN (u16), profile id (u8), then the profile's other fields raw (see PACKET_PROFILES).
+//              Self contained, the receiver takes the fields it leaves out from the sonde's last packet.
+//
+// Deltas are relative to the last keyframe of the same sonde. Position and altitude are predicted
+// from the keyframe's velocity, so only the prediction error is sent. The predictor uses integer
+// math only, so the Tracker and the Receiver always compute the same prediction.
+// A bare Packet (sizeof(Packet) bytes, no header) is still accepted as a keyframe from old trackers, and so is
+// a keyframe without the version byte. Deltas can only be decoded against a keyframe of the same schema.
+// Every frame is covered by the LoRa payload CRC, both radios enable it and frames failing it are dropped.
+
+enum FrameType : uint8_t {
+  FRAME_KEY = 0x1,
+  FRAME_DELTA = 0x2,
+  FRAME_BURST = 0x3,
+  FRAME_NACK = 0x4,
+  FRAME_PARITY = 0x5,
+  FRAME_PROFILE = 0x6,
+};
+
+enum FlightPhase : uint8_t {
+  PHASE_ASCENT = 0,  // also before launch, and all that old trackers send
+  PHASE_DESCENT = 1, // after burst, frames at a higher rate, their PTU fields are stale
+  PHASE_LANDED = 2,  // low duty position beacon for recovery
+};
+
+#define FRAME_TYPE_MASK 0x0F
+#define FRAME_RATE_MASK 0x30
+#define FRAME_RATE_SHIFT 4
+#define FRAME_MAX_LENGTH (2 + sizeof(Packet)) // keyframe, a delta is only sent when it is shorter
+#define FRAME_NACK_LENGTH 6
+#define FRAME_NACK_TURNAROUND 30 // ms for a receiver to handle a frame and start sending its NACK
+#define FRAME_NACK_BACKOFF 40 // ms, receivers start their NACK up to this much later at random, the tracker listens that much longer
+#define FRAME_PARITY_BYTES (sizeof(Packet) - 4) // everything after SN and counter
+#define FRAME_PARITY_SHIFT 6
+#define FRAME_PHASE_SHIFT 6
+#define FRAME_PARITY_MAX_GROUP 4
+
+enum FrameResult : int8_t {
+  FRAME_OK = 0,
+  FRAME_INVALID = -1,  // malformed or unknown frame type
+  FRAME_NEED_KEY = -2, // delta whose keyframe was not received
+  FRAME_OTHER_SCHEMA = -3, // keyframe of another PACKET_SCHEMA_VERSION
+};
+
+struct FrameEncoder { // per sonde state on the Tracker
+  Packet key;               // last keyframe sent
+  uint32_t keyMillis;       // millis() when it was sent
+  uint8_t sinceKey;         // frames sent since then
+  bool haveKey;
+};
+
+size_t encodeFrame(FrameEncoder &encoder, const Packet &packet, uint32_t now, uint8_t keyInterval, uint8_t *out); // out must hold FRAME_MAX_LENGTH bytes
+bool nextFrameIsKey(const FrameEncoder &encoder, uint8_t keyInterval);
+void forceKeyframe(FrameEncoder &encoder); // the next frame will be a keyframe
+size_t encodeBurstFrame(const Packet &packet, uint8_t *out);                                                  // out must hold FRAME_MAX_LENGTH bytes
+size_t encodeNack(uint16_t sn, uint16_t first, uint8_t count, uint8_t *out);                                    // out must hold FRAME_NACK_LENGTH bytes
+bool decodeNack(const uint8_t *frame, size_t length, uint16_t &sn, uint16_t &first, uint8_t &count);
+void parityAdd(uint8_t *parity, const Packet &packet); // XORs the packet into FRAME_PARITY_BYTES of parity
+size_t encodeParityFrame(uint16_t sn, uint16_t first, uint8_t count, const uint8_t *parity, uint8_t *out); // count packets from first
+bool decodeParityFrame(const uint8_t *frame, size_t length, uint16_t &sn, uint16_t &first, uint8_t &count, const uint8_t *&parity);
+size_t encodeProfileFrame(uint8_t profile, const Packet &packet, uint8_t *out); // out must hold FRAME_MAX_LENGTH bytes, 0 if the profile is unknown
+FrameResult decodeProfileFrame(const uint8_t *frame, size_t length, const Packet *base, Packet &out); // base may be nullptr, the left out fields are 0 then
+FrameType frameType(const uint8_t *frame, size_t length); // 0 if the frame is empty
+uint8_t frameNextRate(const uint8_t *frame, size_t length); // data rate profile announced for the next frame
+FlightPhase framePhase(const uint8_t *frame, size_t length); // PHASE_ASCENT for frames that do not carry one
+bool frameSerialNumber(const uint8_t *frame, size_t length, uint16_t &sn);
+FrameResult decodeFrame(const uint8_t *frame, size_t length, const Packet *key, Packet &out, bool &isKey); // key may be nullptr if none was received yet, burst frames decode like keyframes but set isKey false
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Generate the server's binary Packet decoder from packet.h.
+
+Run after changing PACKET_FIELDS, PACKET_PROFILES, a scale or PACKET_SCHEMA_VERSION:
+    python3 generate_python.py
+"""
+import os
+import re
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HEADER = os.path.join(HERE, 'packet.h')
+FRAME_HEADER = os.path.join(HERE, '..', 'frame', 'frame.h')
+OUTPUT = os.path.join(HERE, '..', '..', '..', 'Software', 'Server UI', 'packet_schema.py')
+
+NUMPY_TYPES = {'uint8_t': 'u1', 'uint16_t': '<u2', 'uint32_t': '<u4', 'int8_t': 'i1', 'int16_t': '<i2', 'int32_t': '<i4'}
+STRUCT_CODES = {'uint8_t': 'B', 'uint16_t': 'H', 'uint32_t': 'I', 'int8_t': 'b', 'int16_t': 'h', 'int32_t': 'i'}
+
+
+def parse(source):
+    fields = re.findall(r'X\((\w+),\s*(\w+),\s*"(\w+)"\)', source)
+    version = int(re.search(r'#define PACKET_SCHEMA_VERSION (\d+)', source).group(1))
+    scales = {name: value.rstrip('L') for name, value in re.findall(r'#define PACKET_(\w+_(?:SCALE|MILLIVOLTS)) (\d+L?)', source)}
+    lists = {name: re.findall(r'F\((\w+)\)', members) for name, members in re.findall(r'#define (PROFILE_\w+_FIELDS)\(F\) (.*)', source)}
+    profiles = [(int(id), name, lists[fields]) for id, name, fields in re.findall(r'X\((\d+),\s*(\w+),\s*(PROFILE_\w+_FIELDS)\)', source)]
+    return fields, version, scales, profiles
+
+
+def render_profiles(fields, profiles):
+    # FRAME_PROFILE: header, SN, profile id, then the profile's other fields
+    types = {name: (t, key) for t, name, key in fields}
+    lines = ['PROFILES = {  # id: (name, struct format of the fields after the profile id, their keys)']
+    for id, name, members in profiles:
+        rest = members[1:]  # SN comes first in every profile
+        fmt = '<' + ''.join(STRUCT_CODES[types[m][0]] for m in rest)
+        keys = ', '.join(repr(types[m][1]) for m in rest)
+        lines.append(f'    {id}: ({name!r}, {fmt!r}, ({keys}{"," if len(rest) == 1 else ""})),')
+    lines.append('}')
+    return lines
+
+
+def render(fields, version, scales, profiles, frame_profile, phases):
+    fmt = '<' + ''.join(STRUCT_CODES[t] for t, _, _ in fields)
+    keys = ', '.join(repr(key) for _, _, key in fields)
+    dtype = ', '.join(f'({key!r}, {NUMPY_TYPES[t]!r})' for t, _, key in fields)
+    lines = [
+        '"""Binary decoder for the firmware\'s Packet struct.',
+        '',
+        'Generated by Firmware/shared/packet/generate_python.py from packet.h, do not edit.',
+        '"""',
+        'import struct',
+        '',
+        f'SCHEMA_VERSION = {version}',
+        f'PACKET_FORMAT = {fmt!r}',
+        'PACKET_SIZE = struct.calcsize(PACKET_FORMAT)',
+        f'FIELDS = ({keys})',
+        f'NUMPY_DTYPE = [{dtype}]  # for numpy.frombuffer, packed like the C struct',
+        '',
+    ]
+    lines += [f'{name} = {value}' for name, value in scales.items()]
+    lines += ['', f'FRAME_PROFILE = {frame_profile}', 'PROFILE_FULL = 0']
+    lines += render_profiles(fields, profiles)
+    lines += [f'PHASES = {phases!r}  # FlightPhase in the frame header, uploaded by receivers']
+    lines += [
+        '',
+        '_packet = struct.Struct(PACKET_FORMAT)',
+        "_profile_head = struct.Struct('<HB')",
+        '',
+        '',
+        'def decode(data, offset=0):',
+        '    """Raw field values of one packet, keyed like the JSON upload."""',
+        '    return dict(zip(FIELDS, _packet.unpack_from(data, offset)))',
+        '',
+        '',
+        'def decode_many(data):',
+        '    """Raw field values of back to back packets."""',
+        '    return [dict(zip(FIELDS, values)) for values in _packet.iter_unpack(data)]',
+        '',
+        '',
+        'def decode_profile_frame(frame):',
+        '    """Raw field values of a FRAME_PROFILE frame and its profile id, None if the profile is unknown."""',
+        '    sn, profile = _profile_head.unpack_from(frame, 1)',
+        '    if profile not in PROFILES:',
+        '        return None',
+        '    _, fmt, keys = PROFILES[profile]',
+        "    values = {'sn': sn, 'profile': profile}",
+        '    values.update(zip(keys, struct.unpack_from(fmt, frame, 1 + _profile_head.size)))',
+        '    return values',
+        '',
+        '',
+        'def degrees(raw):',
+        '    return raw / DEGREE_SCALE',
+        '',
+        '',
+        'def alt_m(raw):',
+        '    return raw / ALT_SCALE',
+        '',
+        '',
+        'def speed_ms(raw):',
+        '    return raw / SPEED_SCALE',
+        '',
+        '',
+        'def temp_c(raw):',
+        '    return raw / TEMP_SCALE',
+        '',
+        '',
+        'def rh_percent(raw):',
+        '    return raw / RH_SCALE',
+        '',
+        '',
+        'def battery_v(raw):',
+        '    return raw * BATTERY_MILLIVOLTS / BATTERY_SCALE / 1000.0',
+        '',
+    ]
+    return '\n'.join(lines)
+
+
+if __name__ == '__main__':
+    with open(HEADER) as f:
+        schema = parse(f.read())
+    with open(FRAME_HEADER) as f:
+        frame_source = f.read()
+    frame_profile = re.search(r'FRAME_PROFILE = (0x[0-9A-Fa-f]+)', frame_source).group(1)
+    phases = {int(value): name.lower() for name, value in re.findall(r'PHASE_(\w+) = (\d+)', frame_source)}
+    with open(OUTPUT, 'w') as f:
+        f.write(render(*schema, frame_profile, phases))
+    print(f'wrote {os.path.normpath(OUTPUT)}')
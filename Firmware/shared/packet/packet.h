@@ -0,0 +1,143 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Telemetry packet shared by the Tracker and the Receiver.
+// One line per field in transmission order: X(type, member, json key)
+#define PACKET_FIELDS(X)                                                      \
+  X(uint16_t, SN, "sn")            /* Serial Number */                        \
+  X(uint16_t, counter, "counter")  /* Packet counter */                       \
+  X(uint32_t, time, "time")        /* Time in unix code */                    \
+  X(int32_t, lat, "lat")           /* Latitude, e-7 to get standard format */ \
+  X(int32_t, lon, "lon")           /* Longitude, e-7 to get standard format */\
+  X(int32_t, alt, "alt")           /* Altitude, in mm */                      \
+  X(int16_t, vSpeed, "vSpeed")     /* Vertical speed, in cm/s */              \
+  X(int16_t, eSpeed, "eSpeed")     /* East speed, in cm/s */                  \
+  X(int16_t, nSpeed, "nSpeed")     /* North speed, in cm/s */                 \
+  X(uint8_t, sats, "sats")         /* Number of satellites */                 \
+  X(int16_t, temp, "temp")         /* Temperature, in /320 to get C */        \
+  X(uint8_t, rh, "rh")             /* Relative humidity, /2 to get % */       \
+  X(uint8_t, battery, "battery")   /* battery voltage, (battery*3.3)/255 to get V */
+
+struct __attribute__((packed)) Packet {
+#define PACKET_MEMBER(type, name, key) type name;
+  PACKET_FIELDS(PACKET_MEMBER)
+#undef PACKET_MEMBER
+};
+
+// ---- field table, lets serializers walk the packet without naming every member ----- //
+
+enum PacketFieldType : uint8_t {
+  FIELD_U8,
+  FIELD_U16,
+  FIELD_U32,
+  FIELD_I16,
+  FIELD_I32,
+};
+
+template <typename T> struct PacketFieldTypeOf;
+template <> struct PacketFieldTypeOf<uint8_t>  { static constexpr PacketFieldType value = FIELD_U8; };
+template <> struct PacketFieldTypeOf<uint16_t> { static constexpr PacketFieldType value = FIELD_U16; };
+template <> struct PacketFieldTypeOf<uint32_t> { static constexpr PacketFieldType value = FIELD_U32; };
+template <> struct PacketFieldTypeOf<int16_t>  { static constexpr PacketFieldType value = FIELD_I16; };
+template <> struct PacketFieldTypeOf<int32_t>  { static constexpr PacketFieldType value = FIELD_I32; };
+
+struct PacketField {
+  const char *jsonKey;  // already quoted and followed by ':'
+  uint8_t jsonKeyLength;
+  uint8_t offset;       // byte offset inside Packet
+  PacketFieldType type;
+};
+
+static constexpr PacketField packetFields[] = {
+#define PACKET_FIELD_ENTRY(type, name, key) \
+  {"\"" key "\":", sizeof("\"" key "\":") - 1, offsetof(Packet, name), PacketFieldTypeOf<type>::value},
+  PACKET_FIELDS(PACKET_FIELD_ENTRY)
+#undef PACKET_FIELD_ENTRY
+};
+
+static constexpr size_t packetFieldCount = sizeof(packetFields) / sizeof(packetFields[0]);
+
+static_assert(sizeof(Packet) == 0
+#define PACKET_FIELD_SIZE(type, name, key) + sizeof(type)
+  PACKET_FIELDS(PACKET_FIELD_SIZE)
+#undef PACKET_FIELD_SIZE
+  , "Packet must not contain padding");
+
+
+// ---- profiles, subsets of the packet for missions that need less ----- //
+// A profile is a list of member names, in PACKET_FIELDS order and starting with SN. Each one gets a packed
+// struct with just those members, its ID and a bit mask of the fields it carries, all at compile time.
+// Profile 0 is the full packet, sent as key and delta frames. See FRAME_PROFILE in frame.h for the framing.
+
+#define PACKET_PROFILE_FULL 0
+
+#define PROFILE_PTU_FIELDS(F) F(SN) F(counter) F(time) F(alt) F(temp) F(rh) F(battery)
+#define PROFILE_POSITION_FIELDS(F) F(SN) F(counter) F(time) F(lat) F(lon) F(alt) F(vSpeed) F(eSpeed) F(nSpeed) F(sats) F(battery)
+
+// One line per profile: X(id, name, field list)
+#define PACKET_PROFILES(X)                                                                   \
+  X(1, Ptu, PROFILE_PTU_FIELDS)           /* PTU at a high rate, pressure comes from alt */ \
+  X(2, Position, PROFILE_POSITION_FIELDS) /* position and velocity only, e.g. for recovery */
+
+enum PacketFieldIndex : uint8_t {
+#define PACKET_FIELD_INDEX(type, name, key) PACKET_FIELD_##name,
+  PACKET_FIELDS(PACKET_FIELD_INDEX)
+#undef PACKET_FIELD_INDEX
+};
+
+#define PROFILE_MEMBER(name) decltype(Packet::name) name;
+#define PROFILE_BIT(name) | (1UL << PACKET_FIELD_##name)
+#define PROFILE_STRUCT(id, name, fields)                                                         \
+  struct __attribute__((packed)) name##Profile {                                                 \
+    static constexpr uint8_t ID = id;                                                            \
+    static constexpr uint32_t FIELD_MASK = 0 fields(PROFILE_BIT);                                \
+    fields(PROFILE_MEMBER)                                                                       \
+  };                                                                                             \
+  static_assert(id != PACKET_PROFILE_FULL && offsetof(name##Profile, SN) == 0, "profiles start with SN"); \
+  static_assert(sizeof(name##Profile) + 2 < sizeof(Packet), "profile frames must stay shorter than a bare Packet");
+PACKET_PROFILES(PROFILE_STRUCT)
+#undef PROFILE_STRUCT
+#undef PROFILE_BIT
+#undef PROFILE_MEMBER
+
+// ---- wire contract ----- //
+// Trackers, receivers and the server all depend on this layout and the scales below. Changing either
+// needs a new PACKET_SCHEMA_VERSION and a rerun of generate_python.py for the server's decoder, adding or
+// changing a profile only the rerun.
+
+#define PACKET_SCHEMA_VERSION 1
+
+static_assert(sizeof(Packet) == 31, "Packet size is part of the wire format");
+static_assert(offsetof(Packet, SN) == 0 && offsetof(Packet, counter) == 2 && offsetof(Packet, time) == 4 &&
+              offsetof(Packet, lat) == 8 && offsetof(Packet, lon) == 12 && offsetof(Packet, alt) == 16 &&
+              offsetof(Packet, vSpeed) == 20 && offsetof(Packet, eSpeed) == 22 && offsetof(Packet, nSpeed) == 24 &&
+              offsetof(Packet, sats) == 26 && offsetof(Packet, temp) == 27 && offsetof(Packet, rh) == 29 &&
+              offsetof(Packet, battery) == 30,
+              "Packet field offsets are part of the wire format");
+
+// ---- units, raw value / scale gives the physical value ----- //
+
+#define PACKET_DEGREE_SCALE 10000000L // lat, lon in degrees
+#define PACKET_ALT_SCALE 1000         // alt in m
+#define PACKET_SPEED_SCALE 100        // vSpeed, eSpeed, nSpeed in m/s
+#define PACKET_TEMP_SCALE 320         // temp in degrees C
+#define PACKET_RH_SCALE 2             // rh in %
+#define PACKET_BATTERY_SCALE 255      // battery in units of PACKET_BATTERY_MILLIVOLTS
+#define PACKET_BATTERY_MILLIVOLTS 3300
+
+constexpr int32_t packetRound(double value) {
+  return (int32_t)(value < 0 ? value - 0.5 : value + 0.5);
+}
+
+constexpr double packetDegrees(int32_t raw) { return (double)raw / PACKET_DEGREE_SCALE; }
+constexpr int32_t packetDegreesRaw(double degrees) { return packetRound(degrees * PACKET_DEGREE_SCALE); }
+constexpr float packetTempCelsius(int16_t raw) { return (float)raw / PACKET_TEMP_SCALE; }
+constexpr int16_t packetTempRaw(float celsius) { return (int16_t)packetRound(celsius * PACKET_TEMP_SCALE); }
+constexpr float packetRhPercent(uint8_t raw) { return (float)raw / PACKET_RH_SCALE; }
+constexpr uint8_t packetRhRaw(float percent) { return (uint8_t)packetRound(percent * PACKET_RH_SCALE); }
+constexpr uint16_t packetBatteryMillivolts(uint8_t raw) { return (uint32_t)raw * PACKET_BATTERY_MILLIVOLTS / PACKET_BATTERY_SCALE; }
+
+static_assert(packetTempRaw(packetTempCelsius(-12345)) == -12345 && packetRhRaw(packetRhPercent(201)) == 201 &&
+              packetDegreesRaw(packetDegrees(-1234567891)) == -1234567891,
+              "scale helpers must round trip");
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+#include "frame.h"
+#include "datarate.h"
+
+// Frame schedule shared by trackers and receivers. A tracker sends every TX_DIVIDER-th GNSS epoch in the
+// ascent, every epoch after burst and a beacon every LANDED_BEACON_EPOCHS once landed. Every frame header
+// carries the phase (see FRAME_PHASE_SHIFT), so a receiver knows how long to wait for the next frame, and
+// the tracker knows how long the receivers keep listening on an announced data rate.
+#define NAV_RATE 1 // GNSS navigation solutions per second, the state filter runs on each of them
+#define NAV_PERIOD (1000 / NAV_RATE) // ms between GNSS epochs
+#define TX_DIVIDER 2 // Transmit a packet every n-th epoch, 2 sends at 0.5 Hz with NAV_RATE 1
+#define LANDED_BEACON_EPOCHS 30 // Epochs between position beacons once landed
+
+constexpr uint8_t phaseTxDivider(FlightPhase phase) {
+  // the last few hundred metres of the descent matter most for recovery, so it sends every epoch
+  return phase == PHASE_DESCENT ? 1 : phase == PHASE_LANDED ? LANDED_BEACON_EPOCHS : TX_DIVIDER;
+}
+
+constexpr uint32_t frameInterval(FlightPhase phase) { // ms between the frames of a sonde in this phase
+  return (uint32_t)phaseTxDivider(phase) * NAV_PERIOD;
+}
+
+constexpr uint32_t dataRateTimeout(FlightPhase phase) { // ms a receiver waits on an announced profile after a frame with this phase
+  return DATA_RATE_TIMEOUT_FRAMES * frameInterval(phase);
+}
@@ -0,0 +1,66 @@
+#include "trace.h"
+
+#ifdef TRACE
+#include <atomic>
+
+static_assert((TRACE_SIZE & (TRACE_SIZE - 1)) == 0, "TRACE_SIZE must be a power of two");
+
+static TraceRecord ring[TRACE_SIZE];
+static std::atomic<uint32_t> head(0); // events so far, the receiver traces from both cores
+
+static const char *const eventNames[] = {
+  "?", "pvt", "fill", "tx start", "tx done", "rx irq", "rx read", "upload queued", "upload sent",
+};
+
+#if defined(ARDUINO_ARCH_ESP32)
+#define TRACE_ISR_ATTR IRAM_ATTR // called from the DIO0 interrupt, has to be in IRAM
+static inline uint32_t cycleCount() { return ESP.getCycleCount(); }
+static uint32_t cyclesPerMicrosecond() { return ESP.getCpuFreqMHz(); }
+void SetupTrace() {} // the cycle counter always runs
+#else
+#define TRACE_ISR_ATTR
+static inline uint32_t cycleCount() { return DWT->CYCCNT; }
+static uint32_t cyclesPerMicrosecond() { return SystemCoreClock / 1000000; }
+void SetupTrace() {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // the DWT is off until the trace unit is enabled
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+#endif
+
+TRACE_ISR_ATTR void traceEvent(uint8_t event, uint8_t arg) {
+  TraceRecord &record = ring[head.fetch_add(1, std::memory_order_relaxed) & (TRACE_SIZE - 1)];
+  record.cycles = cycleCount();
+  record.ms = (uint16_t)millis();
+  record.event = event;
+  record.arg = arg;
+}
+
+void dumpTrace(Print &out) {
+  uint32_t end = head.load();
+  uint32_t start = end > TRACE_SIZE ? end - TRACE_SIZE : 0;
+  uint32_t perMicro = cyclesPerMicrosecond();
+  const TraceRecord *previous = nullptr;
+
+  out.println(F("[trace] event, arg, ms, us since previous"));
+  for (uint32_t i = start; i < end; i++) {
+    const TraceRecord &record = ring[i & (TRACE_SIZE - 1)];
+    out.print(F("[trace] "));
+    out.print(record.event < sizeof(eventNames) / sizeof(eventNames[0]) ? eventNames[record.event] : eventNames[0]);
+    out.print(F(", "));
+    out.print(record.arg);
+    out.print(F(", "));
+    out.print(record.ms);
+    if (previous != nullptr) {
+      uint32_t us = (uint32_t)(uint16_t)(record.ms - previous->ms) * 1000;
+      uint32_t cycleUs = (record.cycles - previous->cycles) / perMicro;
+      out.print(F(", "));
+      // the cycle counter is exact but stops in sleep and wraps, millis() covers those spans
+      out.println(cycleUs + 1000 >= us && cycleUs <= us + 1000 ? cycleUs : us);
+    } else {
+      out.println();
+    }
+    previous = &record;
+  }
+}
+#endif
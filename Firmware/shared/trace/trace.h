@@ -0,0 +1,41 @@
+#pragma once
+#include <Arduino.h>
+
+// Timing trace for the hot paths of both firmwares. TRACE_EVENT() stores the event id, the CPU cycle
+// counter and millis() in a RAM ring and does nothing else, so it is cheap enough for interrupts and does
+// not shift the timing it observes like a serial print would. dumpTrace() formats the ring later.
+// Build with -D TRACE to enable it, otherwise the macros compile to nothing.
+
+enum TraceEventId : uint8_t {
+  // Tracker
+  TRACE_PVT = 1,      // NAV-PVT parsed
+  TRACE_FILL,         // packet filled, arg: low byte of the counter
+  TRACE_TX_START,     // frame handed to the radio, arg: frame type
+  TRACE_TX_DONE,      // DIO1, transmission or reception done
+  // Receiver
+  TRACE_RX_IRQ,       // DIO0, frame received
+  TRACE_RX_READ,      // frame read from the radio, arg: length
+  TRACE_UPLOAD_QUEUED, // record handed to the upload task, arg: low byte of the counter
+  TRACE_UPLOAD_SENT,  // batch posted, arg: records
+};
+
+struct TraceRecord {
+  uint32_t cycles; // CPU cycle counter, wraps after a few seconds to minutes
+  uint16_t ms;     // low bits of millis(), for spans that include sleep, where the cycle counter stops
+  uint8_t event;   // TraceEventId
+  uint8_t arg;
+};
+
+#ifdef TRACE
+#define TRACE_SIZE 64 // records kept, power of two
+
+void SetupTrace();                        // starts the cycle counter
+void traceEvent(uint8_t event, uint8_t arg); // interrupt safe
+void dumpTrace(Print &out);                // oldest first, with the time since the previous record
+
+#define TRACE_BEGIN() SetupTrace()
+#define TRACE_EVENT(event, arg) traceEvent(event, arg)
+#else
+#define TRACE_BEGIN()
+#define TRACE_EVENT(event, arg)
+#endif
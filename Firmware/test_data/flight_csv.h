@@ -0,0 +1,94 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "packet.h"
+
+// Reader for the flight CSVs the server exports (/api/sonde/<sn>/download/csv), for the host tests of both
+// firmwares. The rows are turned back into the raw Packet units the tracker sent. flight.csv next to this file
+// is a short flight with an ascent, a descent and a few landed beacons.
+// Host only, the firmwares never include it.
+
+#define FLIGHT_CSV "../test_data/flight.csv" // relative to the project directory, where pio test runs
+#define FLIGHT_CSV_LINE_MAX 512
+#define FLIGHT_CSV_FIELDS_MAX 32
+
+enum FlightCsvColumn { CSV_COUNTER, CSV_TIME, CSV_LAT, CSV_LON, CSV_ALT, CSV_VSPEED, CSV_ESPEED, CSV_NSPEED, CSV_SATS,
+                       CSV_TEMP, CSV_RH, CSV_BATTERY, CSV_COLUMN_COUNT }; // columns as in CSV_COLUMNS of app.py
+
+static const char *const flightCsvNames[CSV_COLUMN_COUNT] = {"packet_counter", "unix_time", "lat", "lon", "alt_m",
+  "vspeed_ms", "espeed_ms", "nspeed_ms", "satellites", "temp_c", "rh_percent", "battery_v"};
+
+static uint8_t splitFlightCsv(char *line, char **fields, uint8_t max) { // plain values, the server writes no quoted ones
+  uint8_t count = 0;
+  line[strcspn(line, "\r\n")] = '\0';
+  for (char *field = line; count < max; count++) {
+    fields[count] = field;
+    char *comma = strchr(field, ',');
+    if (comma == nullptr) {
+      return count + 1;
+    }
+    *comma = '\0';
+    field = comma + 1;
+  }
+  return count;
+}
+
+// Returns the number of packets read, 0 if the file is missing or not a flight export. The server leaves the PTU
+// columns of descent and landed rows empty, those packets keep the last values like the tracker's frames do.
+static uint16_t readFlightCsv(const char *path, uint16_t sn, Packet *packets, uint16_t max) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  char line[FLIGHT_CSV_LINE_MAX];
+  char *fields[FLIGHT_CSV_FIELDS_MAX];
+  int8_t index[CSV_COLUMN_COUNT];
+  memset(index, -1, sizeof(index));
+  if (fgets(line, sizeof(line), file) != nullptr) {
+    uint8_t count = splitFlightCsv(line, fields, FLIGHT_CSV_FIELDS_MAX);
+    for (uint8_t i = 0; i < count; i++) {
+      for (uint8_t c = 0; c < CSV_COLUMN_COUNT; c++) {
+        if (strcmp(fields[i], flightCsvNames[c]) == 0) {
+          index[c] = i;
+        }
+      }
+    }
+  }
+  for (uint8_t c = 0; c < CSV_COLUMN_COUNT; c++) {
+    if (index[c] < 0) {
+      fclose(file);
+      return 0;
+    }
+  }
+
+  uint16_t n = 0;
+  double v[CSV_COLUMN_COUNT] = {};
+  while (n < max && fgets(line, sizeof(line), file) != nullptr) {
+    if (splitFlightCsv(line, fields, FLIGHT_CSV_FIELDS_MAX) < CSV_COLUMN_COUNT) {
+      continue;
+    }
+    for (uint8_t c = 0; c < CSV_COLUMN_COUNT; c++) {
+      const char *field = fields[index[c]];
+      if (*field != '\0') {
+        v[c] = atof(field);
+      }
+    }
+    Packet &packet = packets[n++];
+    packet.SN = sn;
+    packet.counter = (uint16_t)v[CSV_COUNTER];
+    packet.time = (uint32_t)v[CSV_TIME];
+    packet.lat = packetDegreesRaw(v[CSV_LAT]);
+    packet.lon = packetDegreesRaw(v[CSV_LON]);
+    packet.alt = packetRound(v[CSV_ALT] * PACKET_ALT_SCALE);
+    packet.vSpeed = packetRound(v[CSV_VSPEED] * PACKET_SPEED_SCALE);
+    packet.eSpeed = packetRound(v[CSV_ESPEED] * PACKET_SPEED_SCALE);
+    packet.nSpeed = packetRound(v[CSV_NSPEED] * PACKET_SPEED_SCALE);
+    packet.sats = (uint8_t)v[CSV_SATS];
+    packet.temp = packetTempRaw(v[CSV_TEMP]);
+    packet.rh = packetRhRaw(v[CSV_RH]);
+    packet.battery = packetRound(v[CSV_BATTERY] * 1000 * PACKET_BATTERY_SCALE / PACKET_BATTERY_MILLIVOLTS);
+  }
+  fclose(file);
+  return n;
+}
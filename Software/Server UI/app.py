@@ -7,28 +7,35 @@ https://dashboard.resonde.de
 # IMPORTANT: gevent monkey patching must happen BEFORE other imports
 from gevent import monkey
 monkey.patch_all()
+from gevent.threadpool import ThreadPool
 
 import os
+import csv
 import time
 import json
+import struct
 from pathlib import Path
 from datetime import datetime
-from collections import deque
+from collections import OrderedDict
 
 import numpy as np
 import pandas as pd
 
 from flask import Flask, render_template, jsonify, request, send_file, send_from_directory
-from flask_socketio import SocketIO, emit
+from flask_socketio import SocketIO, emit, join_room, leave_room
 
 import logging
 
+import packet_schema  # generated from the firmware's packet.h
+
 # === CONFIGURATION ===
 BASE_DIR = Path(__file__).resolve().parent
 GROUND_PRESSURE = 1013.25  # hPa - default sea level pressure
 GROUND_PRESSURE_FILE = BASE_DIR / "ground_pressure.json"
 DATA_DIR = BASE_DIR / "data"
 LOG_FILE = BASE_DIR / "server.log"
+SKEWT_MIN_INTERVAL = 30  # s - a sonde's Skew-T is redrawn at most this often
+DEDUP_WINDOW = 300  # frames per sonde remembered for deduplication and receiver diagnostics
 
 # Setup logging
 logging.basicConfig(
@@ -43,8 +50,15 @@ app = Flask(__name__)
 app.config['SECRET_KEY'] = 'radiosonde_server_secret'
 socketio = SocketIO(app, cors_allowed_origins="*", async_mode='gevent')
 
-# In-memory state per sonde (keyed by serial number)
-sonde_state = {}  # {sn: {'last_pressure': float, 'last_altitude': float, 'last_packet_time': float}}
+# In-memory state per sonde (keyed by serial number), loaded from the CSV once and then kept current
+sonde_state = {}  # {sn: {'last_pressure': float, 'last_altitude': float, 'frames': OrderedDict, 'rows': list, ...}}
+
+CSV_COLUMNS = [
+    'timestamp', 'packet_counter', 'unix_time',
+    'lat', 'lon', 'alt_m', 'vspeed_ms', 'espeed_ms', 'nspeed_ms',
+    'satellites', 'temp_c', 'rh_percent', 'battery_v', 'rssi_dbm',
+    'pressure_hpa', 'dewpoint_c', 'mixing_ratio', 'theta', 'theta_e', 'phase'
+]
 
 
 # === PHYSICS CALCULATIONS ===
@@ -126,48 +140,63 @@ def get_skewt_path(sn):
 
 
 def save_processed_data(sn, data):
-    """Append processed data to sonde's CSV file."""
+    """Append one processed row to the sonde's CSV file and its in-memory rows."""
     csv_path = get_csv_path(sn)
-    columns = [
-        'timestamp', 'packet_counter', 'unix_time',
-        'lat', 'lon', 'alt_m', 'vspeed_ms', 'espeed_ms', 'nspeed_ms',
-        'satellites', 'temp_c', 'rh_percent', 'battery_v', 'rssi_dbm',
-        'pressure_hpa', 'dewpoint_c', 'mixing_ratio', 'theta', 'theta_e'
-    ]
-    
-    row = [
-        data['timestamp'],
-        data['packet_counter'],
-        data['unix_time'],
-        data['lat'],
-        data['lon'],
-        data['alt_m'],
-        data['vspeed_ms'],
-        data['espeed_ms'],
-        data['nspeed_ms'],
-        data['satellites'],
-        data['temp_c'],
-        data['rh_percent'],
-        data['battery_v'],
-        data['rssi_dbm'],
-        data['pressure_hpa'],
-        data['dewpoint_c'],
-        data['mixing_ratio'],
-        data['theta'],
-        data['theta_e']
-    ]
-    
-    df = pd.DataFrame([row], columns=columns)
+    state = get_sonde_state(sn)
+    
     file_exists = csv_path.exists()
-    df.to_csv(csv_path, mode='a', index=False, header=not file_exists)
+    with open(csv_path, 'a', newline='') as f:
+        writer = csv.writer(f)
+        if not file_exists:
+            writer.writerow(CSV_COLUMNS)
+            state['csv_columns'] = CSV_COLUMNS
+        writer.writerow([data.get(column) for column in state['csv_columns']])  # files from older versions keep their header
+    
+    state['rows'].append({column: data[column] for column in CSV_COLUMNS})
+
+
+def get_sonde_state(sn):
+    """Get the in-memory state of a sonde, restoring it from its CSV after a restart."""
+    if sn in sonde_state:
+        return sonde_state[sn]
+    
+    state = {
+        'last_pressure': get_configured_ground_pressure(sn),
+        'last_altitude': 0,
+        'frames': OrderedDict(),  # {(counter, time): {receiver: {'rssi': float, 'snr': float}}}, oldest first
+        'rows': [],
+        'csv_columns': CSV_COLUMNS,  # header of the CSV file, older files have fewer columns
+        'frame': None,  # DataFrame of 'rows', rebuilt lazily when rows were added
+        'frame_rows': 0
+    }
+    
+    csv_path = DATA_DIR / str(sn) / "processed_data.csv"
+    if csv_path.exists():
+        df = pd.read_csv(csv_path)
+        state['csv_columns'] = list(df.columns)
+        rows = df.reindex(columns=CSV_COLUMNS).fillna({'phase': 'ascent'})
+        state['rows'] = rows.astype(object).where(rows.notna(), None).to_dict(orient='records')  # NaN is no valid JSON
+        ascent = df.dropna(subset=['pressure_hpa'])  # rows after burst have no PTU
+        if len(ascent) > 0:
+            # continue the pressure integration where it stopped instead of restarting at the ground
+            state['last_pressure'] = float(ascent['pressure_hpa'].iloc[-1])
+            state['last_altitude'] = float(ascent['alt_m'].iloc[-1])
+        for counter, unix_time in df[['packet_counter', 'unix_time']].tail(DEDUP_WINDOW).itertuples(index=False):
+            state['frames'][(int(counter), int(unix_time))] = {}
+    
+    sonde_state[sn] = state
+    return state
 
 
 def load_sonde_data(sn):
-    """Load all data for a sonde from CSV."""
-    csv_path = get_csv_path(sn)
-    if not csv_path.exists():
+    """Load all data for a sonde as a DataFrame."""
+    state = get_sonde_state(sn)
+    if not state['rows']:
         return None
-    return pd.read_csv(csv_path)
+    if state['frame'] is None or state['frame_rows'] != len(state['rows']):
+        state['frame'] = pd.DataFrame(state['rows'], columns=CSV_COLUMNS)
+        state['frame_rows'] = len(state['rows'])
+    return state['frame']
 
 
 def get_all_sondes():
@@ -179,11 +208,11 @@ def get_all_sondes():
         if folder.is_dir() and folder.name.isdigit():
             csv_path = folder / "processed_data.csv"
             if csv_path.exists():
-                df = pd.read_csv(csv_path)
+                rows = get_sonde_state(int(folder.name))['rows']
                 sondes.append({
                     'sn': int(folder.name),
-                    'packet_count': len(df),
-                    'last_update': df['timestamp'].iloc[-1] if len(df) > 0 else None
+                    'packet_count': len(rows),
+                    'last_update': rows[-1]['timestamp'] if rows else None
                 })
     return sorted(sondes, key=lambda x: x['sn'])
 
@@ -193,61 +222,67 @@ def get_all_sondes():
 def process_upload(raw_data):
     """Process incoming telemetry from ESP32."""
     sn = int(raw_data['sn'])
-    
-    # Initialize sonde state if new
-    if sn not in sonde_state:
-        start_pressure = get_configured_ground_pressure(sn)
-        sonde_state[sn] = {
-            'last_pressure': start_pressure,
-            'last_altitude': 0,
-            'recent_packets': deque(maxlen=50)  # Track last 50 packets for deduplication
-        }
-    
-    state = sonde_state[sn]
+    state = get_sonde_state(sn)
     
     # Parse raw values (same conversions as local version)
     packet_counter = int(raw_data['counter'])
+    unix_time = int(raw_data['time'])
     
-    # Deduplication: Check if we've already processed this packet
-    if packet_counter in state['recent_packets']:
-        logging.info(f"[SN {sn}] Duplicate packet #{packet_counter} ignored")
+    # Deduplication: several receivers upload the same frame, the counter alone repeats after a tracker reset
+    key = (packet_counter, unix_time)
+    frames = state['frames']
+    reception = {'rssi': float(raw_data['rssi']), 'snr': raw_data.get('snr')}
+    receiver = raw_data.get('receiver', 'unknown')
+    if key in frames:
+        frames[key][receiver] = reception
+        logging.info(f"[SN {sn}] Duplicate packet #{packet_counter} from {receiver} ignored")
         return None
-        
-    state['recent_packets'].append(packet_counter)
     
-    unix_time = int(raw_data['time'])
-    lat = float(raw_data['lat']) * 1e-7
-    lon = float(raw_data['lon']) * 1e-7
-    alt_m = float(raw_data['alt']) / 1000.0
+    frames[key] = {receiver: reception}
+    if len(frames) > DEDUP_WINDOW:
+        frames.popitem(last=False)
     
-    vspeed_ms = float(raw_data['vSpeed']) / 100.0
-    espeed_ms = float(raw_data['eSpeed']) / 100.0
-    nspeed_ms = float(raw_data['nSpeed']) / 100.0
+    lat = packet_schema.degrees(float(raw_data['lat']))
+    lon = packet_schema.degrees(float(raw_data['lon']))
+    alt_m = packet_schema.alt_m(float(raw_data['alt']))
+    
+    vspeed_ms = packet_schema.speed_ms(float(raw_data['vSpeed']))
+    espeed_ms = packet_schema.speed_ms(float(raw_data['eSpeed']))
+    nspeed_ms = packet_schema.speed_ms(float(raw_data['nSpeed']))
     
     satellites = int(raw_data['sats'])
-    temp_c = float(raw_data['temp']) / 320.0
-    rh_percent = float(raw_data['rh']) / 2.0
-    battery_v = (float(raw_data['battery']) / 255.0) * 3.3
+    temp_c = packet_schema.temp_c(float(raw_data['temp']))
+    rh_percent = packet_schema.rh_percent(float(raw_data['rh']))
+    battery_v = packet_schema.battery_v(float(raw_data['battery']))
     rssi_dbm = float(raw_data['rssi'])
+    phase = packet_schema.PHASES.get(int(raw_data.get('phase', 0)), 'ascent')  # older receivers do not send it
     
-    # Calculate pressure
-    if state['last_altitude'] == 0:
-        pressure_hpa = get_configured_ground_pressure(sn)
+    if phase != 'ascent':
+        # PTU is not sampled after burst, the frames still carry the last ascent values. Stored as
+        # NaN (None until the CSV is read back) together with everything derived from them
+        temp_c = rh_percent = pressure_hpa = dewpoint_c = mixing_ratio = theta = theta_e = None
     else:
-        pressure_hpa = calculate_exact_pressure(
-            alt_m, state['last_altitude'], state['last_pressure'], temp_c, rh_percent
-        )
-    
-    state['last_pressure'] = pressure_hpa
-    state['last_altitude'] = alt_m
-    
-    # Calculate derived values
-    dewpoint_c = calculate_dewpoint(temp_c, rh_percent)
-    mixing_ratio = calculate_mixing_ratio(temp_c, pressure_hpa, rh_percent)
-    theta = calculate_theta(temp_c, pressure_hpa)
-    theta_e = calculate_theta_e(temp_c, pressure_hpa, rh_percent)
+        # Calculate pressure
+        if state['last_altitude'] == 0:
+            pressure_hpa = get_configured_ground_pressure(sn)
+        else:
+            pressure_hpa = calculate_exact_pressure(
+                alt_m, state['last_altitude'], state['last_pressure'], temp_c, rh_percent
+            )
+        
+        state['last_pressure'] = pressure_hpa
+        state['last_altitude'] = alt_m
+        
+        # Calculate derived values
+        dewpoint_c = calculate_dewpoint(temp_c, rh_percent)
+        mixing_ratio = calculate_mixing_ratio(temp_c, pressure_hpa, rh_percent)
+        theta = calculate_theta(temp_c, pressure_hpa)
+        theta_e = calculate_theta_e(temp_c, pressure_hpa, rh_percent)
     
-    timestamp = datetime.now().isoformat()
+    if 'received_at' in raw_data:  # reception time reported by the receiver, batches arrive late
+        timestamp = datetime.fromtimestamp(raw_data['received_at']).isoformat()
+    else:
+        timestamp = datetime.now().isoformat()
     
     processed = {
         'serial_number': sn,
@@ -269,7 +304,8 @@ def process_upload(raw_data):
         'dewpoint_c': dewpoint_c,
         'mixing_ratio': mixing_ratio,
         'theta': theta,
-        'theta_e': theta_e
+        'theta_e': theta_e,
+        'phase': phase
     }
     
     # Save to CSV
@@ -280,7 +316,39 @@ def process_upload(raw_data):
 
 # === SKEW-T GENERATION ===
 
-def generate_skewt(sn):
+# matplotlib is not thread safe and blocks the gevent loop, so all rendering goes through one native thread
+skewt_pool = ThreadPool(1)
+
+
+def request_skewt(sn):
+    """Return the last rendered Skew-T of a sonde right away and queue a redraw if it is out of date."""
+    state = get_sonde_state(sn)
+    skewt_path = get_skewt_path(sn)
+    has_image = skewt_path.exists()
+    
+    if state['rows'] and not state.get('skewt_pending'):
+        counter = state['rows'][-1]['packet_counter']
+        rendered = state.get('skewt_rendered', 0)
+        # a sonde without an image is drawn right away, otherwise only on new data and after the interval
+        if counter != state.get('skewt_counter') and (not has_image or time.time() - rendered >= SKEWT_MIN_INTERVAL):
+            state['skewt_pending'] = True
+            # the DataFrame snapshot is taken here, the worker never touches the live rows
+            skewt_pool.spawn(render_skewt_job, sn, counter, load_sonde_data(sn).copy())
+    
+    return str(skewt_path) if has_image else None
+
+
+def render_skewt_job(sn, counter, df):
+    state = sonde_state[sn]
+    try:
+        generate_skewt(sn, df)
+    finally:
+        state['skewt_counter'] = counter  # too little data counts as rendered too, until new rows arrive
+        state['skewt_rendered'] = time.time()
+        state['skewt_pending'] = False
+
+
+def generate_skewt(sn, df):
     """Generate Skew-T diagram for a sonde."""
     import matplotlib
     matplotlib.use('Agg')
@@ -288,15 +356,6 @@ def generate_skewt(sn):
     from metpy.plots import SkewT
     from metpy.units import units
     
-    csv_path = get_csv_path(sn)
-    skewt_path = get_skewt_path(sn)
-    
-    # Optimization: Check if Skew-T is already up to date
-    if csv_path.exists() and skewt_path.exists():
-        if skewt_path.stat().st_mtime >= csv_path.stat().st_mtime:
-            return str(skewt_path)
-
-    df = load_sonde_data(sn)
     if df is None or len(df) < 5:
         return None
     
@@ -314,7 +373,7 @@ def generate_skewt(sn):
     # Reset index to be safe for finding the max position
     df_reset = df.reset_index(drop=True)
     max_pos = df_reset['alt_m'].idxmax()
-    df = df_reset.iloc[:max_pos+1]
+    df = df_reset.iloc[:max_pos+1].dropna(subset=['pressure_hpa', 'temp_c', 'dewpoint_c'])
 
     if len(df) < 2:
         return None
@@ -350,13 +409,16 @@ def generate_skewt(sn):
         skew.ax.legend(loc='upper left')
         
         filepath = get_skewt_path(sn)
-        fig.savefig(filepath, dpi=100, bbox_inches='tight', facecolor='white')
+        temp_path = filepath.with_suffix('.tmp.png')
+        fig.savefig(temp_path, dpi=100, bbox_inches='tight', facecolor='white')
         plt.close(fig)
+        os.replace(temp_path, filepath)  # requests keep serving the old image until the new one is complete
         
         return str(filepath)
 
     except Exception as e:
         logging.error(f"Error generating Skew-T: {e}")
+        plt.close('all')  # the worker lives as long as the server, don't let failed figures pile up
         return None
 
 
@@ -374,29 +436,96 @@ def serve_static(filename):
 
 # === API ROUTES ===
 
+REQUIRED_UPLOAD_FIELDS = list(packet_schema.FIELDS) + ['rssi']
+
+
+def ingest_record(data):
+    """Validate and process one uploaded record. Returns (status, processed)."""
+    if not isinstance(data, dict):
+        return 'invalid', None
+    for field in REQUIRED_UPLOAD_FIELDS:
+        if field not in data:
+            return 'invalid', None
+    
+    data.setdefault('receiver', request.remote_addr)  # JSON uploads don't carry the receiver's MAC
+    processed = process_upload(data)
+    if processed is None:
+        return 'duplicate', None
+    
+    # Full rows only go to the viewers of this sonde, everyone else just gets the list entry
+    sn = processed['serial_number']
+    socketio.emit('telemetry', processed, to=sonde_room(sn))
+    socketio.emit('sonde_update', {
+        'sn': sn,
+        'packet_count': len(sonde_state[sn]['rows']),
+        'last_update': processed['timestamp']
+    })
+    
+    logging.info(f"[SN {processed['serial_number']}] Pkt #{processed['packet_counter']} | Alt: {processed['alt_m']:.1f}m")
+    return 'processed', processed
+
+
+# Binary batch upload, see UploadHeader/UploadRecord in the receiver's upload_format.h
+UPLOAD_MAGIC = 0x5352
+UPLOAD_HEADER = struct.Struct('<HB6sI')  # magic, schema version, receiver MAC, receiver millis() when sent
+UPLOAD_RECORD_DTYPE = np.dtype(packet_schema.NUMPY_DTYPE + [('rssi', '<i2'), ('received', '<u4'), ('phase', 'u1'), ('snr', '<i2')])
+
+
+def decode_binary_upload(body):
+    """Decode a binary batch into upload dicts. Returns None if the body is malformed."""
+    if len(body) < UPLOAD_HEADER.size:
+        return None
+    magic, version, receiver_id, sent = UPLOAD_HEADER.unpack_from(body)
+    if magic != UPLOAD_MAGIC or version != packet_schema.SCHEMA_VERSION:
+        return None
+    if (len(body) - UPLOAD_HEADER.size) % UPLOAD_RECORD_DTYPE.itemsize:
+        return None
+    
+    records = np.frombuffer(body, dtype=UPLOAD_RECORD_DTYPE, offset=UPLOAD_HEADER.size)
+    
+    # convert whole columns at once, only the final dicts are built per record
+    now = time.time()
+    columns = {name: records[name].tolist() for name in packet_schema.FIELDS}
+    columns['rssi'] = (records['rssi'] / 10.0).tolist()
+    columns['snr'] = (records['snr'] / 10.0).tolist()
+    columns['phase'] = records['phase'].tolist()
+    columns['received_at'] = (now - ((sent - records['received'].astype(np.int64)) & 0xFFFFFFFF) / 1000.0).tolist()
+    receiver = receiver_id.hex()
+    
+    keys = list(columns)
+    return [dict(zip(keys, values), receiver=receiver) for values in zip(*columns.values())]
+
+
+def api_upload_binary(body):
+    records = decode_binary_upload(body)
+    if records is None:
+        return jsonify({'error': 'Malformed binary upload'}), 400
+    return api_upload_batch(records)
+
+
 @app.route('/api/upload', methods=['POST'])
 def api_upload():
-    """Receive telemetry from ESP32 receivers."""
+    """Receive telemetry from ESP32 receivers: one record, a JSON array, or a binary batch (octet-stream)."""
     try:
+        if request.mimetype == 'application/octet-stream':
+            return api_upload_binary(request.get_data())
+        
         data = request.get_json()
         if not data:
             return jsonify({'error': 'No JSON data'}), 400
         
-        required = ['sn', 'counter', 'time', 'lat', 'lon', 'alt', 'vSpeed', 'eSpeed', 'nSpeed', 'sats', 'temp', 'rh', 'battery', 'rssi']
-        for field in required:
+        if isinstance(data, list):
+            return api_upload_batch(data)
+        
+        for field in REQUIRED_UPLOAD_FIELDS:
             if field not in data:
                 return jsonify({'error': f'Missing field: {field}'}), 400
         
-        processed = process_upload(data)
+        status, processed = ingest_record(data)
         
         if processed is None:
             return jsonify({'success': True, 'status': 'duplicate'}), 200
         
-        # Broadcast to all connected WebSocket clients
-        socketio.emit('telemetry', processed)
-        
-        logging.info(f"[SN {processed['serial_number']}] Pkt #{processed['packet_counter']} | Alt: {processed['alt_m']:.1f}m")
-        
         return jsonify({'success': True, 'processed': processed}), 200
         
     except Exception as e:
@@ -404,6 +533,23 @@ def api_upload():
         return jsonify({'error': str(e)}), 500
 
 
+def api_upload_batch(records):
+    """Process a batch of records sent by a receiver in a single POST."""
+    counts = {'processed': 0, 'duplicate': 0, 'invalid': 0}
+    for record in records:
+        try:
+            status, _ = ingest_record(record)
+        except Exception as e:
+            logging.error(f"Upload error in batch: {e}")
+            status = 'invalid'
+        counts[status] += 1
+    
+    if counts['invalid']:
+        logging.warning(f"Batch upload: {counts['invalid']} of {len(records)} records rejected")
+    
+    return jsonify({'success': True, **counts}), 200
+
+
 @app.route('/api/sondes')
 def api_sondes():
     """Get list of all known sondes."""
@@ -413,10 +559,10 @@ def api_sondes():
 @app.route('/api/sonde/<int:sn>/data')
 def api_sonde_data(sn):
     """Get all processed data for a sonde."""
-    df = load_sonde_data(sn)
-    if df is None:
+    rows = get_sonde_state(sn)['rows']
+    if not rows:
         return jsonify({'error': 'Sonde not found'}), 404
-    return jsonify(df.to_dict(orient='records'))
+    return jsonify(rows)
 
 
 @app.route('/api/sonde/<int:sn>/track')
@@ -435,16 +581,28 @@ def api_sonde_track(sn):
 @app.route('/api/sonde/<int:sn>/latest')
 def api_sonde_latest(sn):
     """Get latest telemetry for a sonde."""
-    df = load_sonde_data(sn)
-    if df is None or len(df) == 0:
+    rows = get_sonde_state(sn)['rows']
+    if not rows:
         return jsonify({'error': 'Sonde not found'}), 404
-    return jsonify(df.iloc[-1].to_dict())
+    return jsonify(rows[-1])
+
+
+@app.route('/api/sonde/<int:sn>/receivers')
+def api_sonde_receivers(sn):
+    """Get which receivers heard the recent frames of a sonde, with their RSSI/SNR."""
+    if sn not in sonde_state:
+        return jsonify({'error': 'Sonde not found'}), 404
+    frames = sonde_state[sn]['frames']
+    return jsonify([
+        {'packet_counter': counter, 'unix_time': unix_time, 'receivers': receivers}
+        for (counter, unix_time), receivers in frames.items()
+    ])
 
 
 @app.route('/api/sonde/<int:sn>/skewt')
 def api_sonde_skewt(sn):
     """Generate and return Skew-T image."""
-    result = generate_skewt(sn)
+    result = request_skewt(sn)
     if result is None:
         return jsonify({'error': 'Not enough data for Skew-T'}), 404
     return send_file(result, mimetype='image/png')
@@ -462,7 +620,7 @@ def api_download_csv(sn):
 @app.route('/api/sonde/<int:sn>/download/skewt')
 def api_download_skewt(sn):
     """Download Skew-T image for a sonde."""
-    result = generate_skewt(sn)
+    result = request_skewt(sn)
     if result is None:
         return jsonify({'error': 'Not enough data for Skew-T'}), 404
     return send_file(result, mimetype='image/png', as_attachment=True, download_name=f'sonde_{sn}_skewt.png')
@@ -476,16 +634,48 @@ def handle_connect():
     emit('status', {'connected': True, 'sondes': get_all_sondes()})
 
 
+subscriptions = {}  # {sid: sn} - the sonde room each client is in
+
+
+def sonde_room(sn):
+    return f'sonde_{sn}'
+
+
+def rows_since(rows, counter):
+    """Rows received after the one with the given packet counter. Returns (rows, full), full if the counter is unknown."""
+    if counter is not None:
+        # walk back from the newest row, a client that is up to date costs nothing
+        for i in range(len(rows) - 1, -1, -1):
+            if rows[i]['packet_counter'] == counter:
+                return rows[i + 1:], False
+    return rows, True
+
+
 @socketio.on('disconnect')
 def handle_disconnect():
+    subscriptions.pop(request.sid, None)
     logging.info('Client disconnected')
 
 
 @socketio.on('subscribe_sonde')
 def handle_subscribe(data):
-    """Client wants updates for a specific sonde."""
+    """Client wants updates for a specific sonde, starting after the last packet counter it has."""
     sn = data.get('sn')
-    logging.info(f'Client subscribed to sonde {sn}')
+    counter = data.get('counter')
+    
+    previous = subscriptions.pop(request.sid, None)
+    if previous is not None:
+        leave_room(sonde_room(previous))
+    if sn is None:
+        return
+    
+    sn = int(sn)
+    subscriptions[request.sid] = sn
+    join_room(sonde_room(sn))
+    
+    rows, full = rows_since(get_sonde_state(sn)['rows'], counter)
+    emit('history', {'sn': sn, 'full': full, 'rows': rows})
+    logging.info(f'Client subscribed to sonde {sn}, sent {len(rows)} rows')
 
 
 # === MAIN ===
@@ -0,0 +1,75 @@
+"""Binary decoder for the firmware's Packet struct.
+
+Generated by Firmware/shared/packet/generate_python.py from packet.h, do not edit.
+"""
+import struct
+
+SCHEMA_VERSION = 1
+PACKET_FORMAT = '<HHIiiihhhBhBB'
+PACKET_SIZE = struct.calcsize(PACKET_FORMAT)
+FIELDS = ('sn', 'counter', 'time', 'lat', 'lon', 'alt', 'vSpeed', 'eSpeed', 'nSpeed', 'sats', 'temp', 'rh', 'battery')
+NUMPY_DTYPE = [('sn', '<u2'), ('counter', '<u2'), ('time', '<u4'), ('lat', '<i4'), ('lon', '<i4'), ('alt', '<i4'), ('vSpeed', '<i2'), ('eSpeed', '<i2'), ('nSpeed', '<i2'), ('sats', 'u1'), ('temp', '<i2'), ('rh', 'u1'), ('battery', 'u1')]  # for numpy.frombuffer, packed like the C struct
+
+DEGREE_SCALE = 10000000
+ALT_SCALE = 1000
+SPEED_SCALE = 100
+TEMP_SCALE = 320
+RH_SCALE = 2
+BATTERY_SCALE = 255
+BATTERY_MILLIVOLTS = 3300
+
+FRAME_PROFILE = 0x6
+PROFILE_FULL = 0
+PROFILES = {  # id: (name, struct format of the fields after the profile id, their keys)
+    1: ('Ptu', '<HIihBB', ('counter', 'time', 'alt', 'temp', 'rh', 'battery')),
+    2: ('Position', '<HIiiihhhBB', ('counter', 'time', 'lat', 'lon', 'alt', 'vSpeed', 'eSpeed', 'nSpeed', 'sats', 'battery')),
+}
+PHASES = {0: 'ascent', 1: 'descent', 2: 'landed'}  # FlightPhase in the frame header, uploaded by receivers
+
+_packet = struct.Struct(PACKET_FORMAT)
+_profile_head = struct.Struct('<HB')
+
+
+def decode(data, offset=0):
+    """Raw field values of one packet, keyed like the JSON upload."""
+    return dict(zip(FIELDS, _packet.unpack_from(data, offset)))
+
+
+def decode_many(data):
+    """Raw field values of back to back packets."""
+    return [dict(zip(FIELDS, values)) for values in _packet.iter_unpack(data)]
+
+
+def decode_profile_frame(frame):
+    """Raw field values of a FRAME_PROFILE frame and its profile id, None if the profile is unknown."""
+    sn, profile = _profile_head.unpack_from(frame, 1)
+    if profile not in PROFILES:
+        return None
+    _, fmt, keys = PROFILES[profile]
+    values = {'sn': sn, 'profile': profile}
+    values.update(zip(keys, struct.unpack_from(fmt, frame, 1 + _profile_head.size)))
+    return values
+
+
+def degrees(raw):
+    return raw / DEGREE_SCALE
+
+
+def alt_m(raw):
+    return raw / ALT_SCALE
+
+
+def speed_ms(raw):
+    return raw / SPEED_SCALE
+
+
+def temp_c(raw):
+    return raw / TEMP_SCALE
+
+
+def rh_percent(raw):
+    return raw / RH_SCALE
+
+
+def battery_v(raw):
+    return raw * BATTERY_MILLIVOLTS / BATTERY_SCALE / 1000.0
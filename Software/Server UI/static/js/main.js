@@ -22,6 +22,7 @@ let flightTrack = null;
 let currentMarker = null;
 let lastPacketTimestamp = null;
 let selectedSonde = null;
+let lastCounter = null; // packet counter of the newest row we have, the server only sends what came after it
 
 // ===========================
 // Initialization
@@ -67,6 +68,11 @@ function initSocket() {
     socket.on('connect', () => {
         console.log('Connected to server');
         updateConnectionStatus('connected');
+
+        // After a reconnect only the rows we missed are sent
+        if (selectedSonde) {
+            socket.emit('subscribe_sonde', { sn: selectedSonde, counter: lastCounter });
+        }
     });
 
     socket.on('disconnect', () => {
@@ -81,18 +87,31 @@ function initSocket() {
         }
     });
 
-    socket.on('telemetry', (data) => {
-        console.log('Telemetry received:', data);
+    socket.on('history', (data) => {
+        if (data.sn !== selectedSonde) return;
+
+        if (data.full) clearMap();
+        if (data.rows.length === 0) return;
 
-        // Only update if this is for our selected sonde
+        const last = data.rows[data.rows.length - 1];
+        lastCounter = last.packet_counter;
+        lastPacketTimestamp = Date.now();
+        updateTelemetry({ ...last, serial_number: data.sn });
+        addTrackPoints(data.rows);
+    });
+
+    // Only sent for the sonde we subscribed to
+    socket.on('telemetry', (data) => {
         if (selectedSonde && data.serial_number === selectedSonde) {
+            lastCounter = data.packet_counter;
             lastPacketTimestamp = Date.now();
             updateTelemetry(data);
             addTrackPoint(data.lat, data.lon);
         }
+    });
 
-        // Refresh sonde list
-        refreshSondeList();
+    socket.on('sonde_update', (sonde) => {
+        updateSondeOption(sonde);
     });
 }
 
@@ -153,8 +172,21 @@ function populateSondeSelector(sondes) {
     }
 }
 
+function updateSondeOption(sonde) {
+    const select = document.getElementById('sondeSelect');
+    let option = Array.from(select.options).find(o => o.value === String(sonde.sn));
+
+    if (!option) {
+        option = document.createElement('option');
+        option.value = sonde.sn;
+        select.appendChild(option);
+    }
+    option.textContent = `SN ${sonde.sn} (${sonde.packet_count} packets)`;
+}
+
 function selectSonde(sn) {
     selectedSonde = sn;
+    lastCounter = null;
 
     const downloadCsv = document.getElementById('downloadCsv');
     const downloadSkewt = document.getElementById('downloadSkewt');
@@ -168,6 +200,7 @@ function selectSonde(sn) {
         clearMap();
         clearTelemetry();
         clearSkewT();
+        socket.emit('subscribe_sonde', { sn: null });
         return;
     }
 
@@ -175,61 +208,17 @@ function selectSonde(sn) {
     downloadSkewt.disabled = false;
     mapNoSonde.style.display = 'none';
 
-    // Load sonde data
-    loadSondeData(sn);
-    loadSondeTrack(sn);
+    clearMap();
+    clearTelemetry();
     loadSkewT(sn);
 
-    // Subscribe to updates for this sonde
-    socket.emit('subscribe_sonde', { sn: sn });
+    // Subscribe to updates for this sonde, the server answers with its history
+    socket.emit('subscribe_sonde', { sn: sn, counter: null });
 }
 
 // ===========================
 // Data Loading
 // ===========================
-function loadSondeData(sn) {
-    fetch(`/api/sonde/${sn}/latest`)
-        .then(res => res.json())
-        .then(data => {
-            if (!data.error) {
-                updateTelemetry(data);
-                lastPacketTimestamp = Date.now();
-            }
-        })
-        .catch(err => console.error('Failed to load sonde data:', err));
-}
-
-function loadSondeTrack(sn) {
-    fetch(`/api/sonde/${sn}/track`)
-        .then(res => res.json())
-        .then(track => {
-            clearMap();
-
-            if (track.length > 0) {
-                track.forEach(([lat, lon]) => {
-                    if (Math.abs(lat) > 0.1 || Math.abs(lon) > 0.1) {
-                        flightTrack.addLatLng([lat, lon]);
-                    }
-                });
-
-                document.getElementById('trackPoints').textContent = `${track.length} points`;
-
-                // Update current position marker
-                const lastValid = track.filter(([lat, lon]) => Math.abs(lat) > 0.1 || Math.abs(lon) > 0.1);
-                if (lastValid.length > 0) {
-                    const [lat, lon] = lastValid[lastValid.length - 1];
-                    updateMarker(lat, lon);
-
-                    // Fit map to track
-                    if (flightTrack.getLatLngs().length > 0) {
-                        map.fitBounds(flightTrack.getBounds(), { padding: [50, 50] });
-                    }
-                }
-            }
-        })
-        .catch(err => console.error('Failed to load track:', err));
-}
-
 function loadSkewT(sn) {
     const img = document.getElementById('skewt-image');
     const placeholder = document.getElementById('skewt-placeholder');
@@ -284,6 +273,24 @@ function addTrackPoint(lat, lon) {
     }
 }
 
+function addTrackPoints(rows) {
+    const valid = rows.filter(row => Math.abs(row.lat) > 0.1 || Math.abs(row.lon) > 0.1);
+    if (valid.length === 0) return;
+
+    valid.forEach(row => flightTrack.addLatLng([row.lat, row.lon]));
+    const last = valid[valid.length - 1];
+    updateMarker(last.lat, last.lon);
+
+    const points = flightTrack.getLatLngs().length;
+    document.getElementById('trackPoints').textContent = `${points} points`;
+
+    if (points <= 5) {
+        map.setView([last.lat, last.lon], 12);
+    } else {
+        map.fitBounds(flightTrack.getBounds(), { padding: [50, 50] });
+    }
+}
+
 function updateMarker(lat, lon) {
     if (currentMarker) {
         currentMarker.setLatLng([lat, lon]);
@@ -323,15 +330,21 @@ function updateTelemetry(data) {
             updateBox('ascent', rate.toFixed(2), ' m/s', status);
         }
 
+        if (data.phase !== undefined) {
+            const status = data.phase === 'ascent' ? 'ascending' : (data.phase === 'descent' ? 'descending' : 'good');
+            updateBox('phase', data.phase.toUpperCase(), '', status);
+        }
+
         if (data.satellites !== undefined) {
             const sats = Number(data.satellites);
             let status = sats > 8 ? 'good' : (sats >= 6 ? 'warning' : 'danger');
             updateBox('sats', sats, '', status);
         }
 
-        if (data.temp_c !== undefined) updateBox('temp', Number(data.temp_c).toFixed(1), ' °C', null);
-        if (data.rh_percent !== undefined) updateBox('rh', Number(data.rh_percent).toFixed(1), ' %', null);
-        if (data.pressure_hpa !== undefined) updateBox('pressure', Number(data.pressure_hpa).toFixed(1), ' hPa', null);
+        // null after burst, the PTU is no longer sampled
+        if (data.temp_c !== undefined) updateBox('temp', data.temp_c === null ? '--' : Number(data.temp_c).toFixed(1), ' °C', null);
+        if (data.rh_percent !== undefined) updateBox('rh', data.rh_percent === null ? '--' : Number(data.rh_percent).toFixed(1), ' %', null);
+        if (data.pressure_hpa !== undefined) updateBox('pressure', data.pressure_hpa === null ? '--' : Number(data.pressure_hpa).toFixed(1), ' hPa', null);
 
         // Battery voltage with color coding
         if (data.battery_v !== undefined) {
@@ -372,7 +385,7 @@ function updateBox(id, value, unit, status) {
 }
 
 function clearTelemetry() {
-    const boxes = ['sn', 'pkt', 'time', 'lat', 'lon', 'alt', 'ascent', 'sats', 'temp', 'rh', 'pressure', 'battery', 'lastpkt', 'rssi'];
+    const boxes = ['sn', 'pkt', 'time', 'lat', 'lon', 'alt', 'ascent', 'phase', 'sats', 'temp', 'rh', 'pressure', 'battery', 'lastpkt', 'rssi'];
     boxes.forEach(id => {
         const valueEl = document.getElementById(`val-${id}`);
         if (valueEl) valueEl.textContent = '--';